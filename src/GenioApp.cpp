@@ -414,6 +414,9 @@ GenioApp::_PrepareConfig(ConfigManager& cfg)
 	cfg.AddConfig(build.String(), "wrap_console", B_TRANSLATE("Wrap lines in console"), false);
 	cfg.AddConfig(build.String(), "console_banner", B_TRANSLATE_COMMENT("Console banner",
 		"A separating line inserted at the start and end of a command output in the console. Short as possible."), true);
+	GMessage consoleLimits = { {"min", 1000}, {"max", 1000000} };
+	cfg.AddConfig(build.String(), "console_max_lines", B_TRANSLATE("Console line limit:"),
+		50000, &consoleLimits);
 	cfg.AddConfig(build.String(), "build_on_save", B_TRANSLATE("Auto-Build on resource save"), false);
 	cfg.AddConfig(build.String(), "save_on_build", B_TRANSLATE("Auto-Save changed files when building"), false);
 
@@ -449,6 +452,7 @@ GenioApp::_PrepareConfig(ConfigManager& cfg)
 	cfg.AddConfig("Hidden", "ui_bounds", "ui_bounds", BRect(40, 40, 839, 639));
 	cfg.AddConfig("Hidden", "config_version", "config_version", "2.0");
 	cfg.AddConfig("Hidden", "run_without_buffering", "run_without_buffering", true);
+	cfg.AddConfig("Hidden", "git_status_verify", "git_status_verify", false);
 	GMessage log_limits = { {"min", 1024}, {"max", 4096} };
 	cfg.AddConfig("Hidden", "log_size", B_TRANSLATE("Log size:"), 1024, &log_limits);
 }
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "CommitLog.h"
+
+#include <Autolock.h>
+
+#include "GitRepository.h"
+#include "Log.h"
+
+using Genio::Git::GitException;
+using Genio::Git::GitRepository;
+
+
+// how long a send may block before checking if the log was stopped
+static const bigtime_t kSendTimeout = 100000; // 100 ms
+static const size_t kPageSize = 100;
+
+// tells the messages of a log from those of the one it replaced
+static std::atomic<int32> sNextID(1);
+
+
+CommitLog::CommitLog(const BString& repositoryPath, const BMessenger& target)
+	:
+	fID(sNextID++),
+	fRepositoryPath(repositoryPath),
+	fTarget(target),
+	fLocker("CommitLog"),
+	fPendingPages(0),
+	fRequestSem(create_sem(0, "commit log request")),
+	fThread(-1),
+	fQuit(false)
+{
+}
+
+
+CommitLog::~CommitLog()
+{
+	delete_sem(fRequestSem);
+}
+
+
+status_t
+CommitLog::Start()
+{
+	fThread = spawn_thread(&CommitLog::_LogThread, "commit log", B_LOW_PRIORITY, this);
+	if (fThread < 0)
+		return fThread;
+	status_t status = resume_thread(fThread);
+	if (status != B_OK) {
+		kill_thread(fThread);
+		fThread = -1;
+	}
+	return status;
+}
+
+
+// The diff stat of a large commit can take long: the thread is not waited
+// for, it deletes the log when it is over
+void
+CommitLog::Release()
+{
+	if (fThread < 0) {
+		delete this;
+		return;
+	}
+	fQuit = true;
+	release_sem(fRequestSem);
+}
+
+
+void
+CommitLog::LoadMore()
+{
+	BAutolock lock(fLocker);
+	fPendingPages++;
+	release_sem(fRequestSem);
+}
+
+
+void
+CommitLog::RequestDiffStats(const std::vector<BString>& ids)
+{
+	BAutolock lock(fLocker);
+	fPendingDiffStats = ids;
+	release_sem(fRequestSem);
+}
+
+
+/* static */
+status_t
+CommitLog::_LogThread(void* self)
+{
+	CommitLog* log = static_cast<CommitLog*>(self);
+	log->_LogLoop();
+	delete log;
+	return B_OK;
+}
+
+
+void
+CommitLog::_LogLoop()
+{
+	// libgit2 objects can't be shared between threads: this one is ours
+	GitRepository* repository = nullptr;
+	git_revwalk* walk = nullptr;
+	try {
+		repository = new GitRepository(fRepositoryPath);
+		if (repository->IsInitialized())
+			walk = repository->NewHistoryWalk();
+	} catch (const GitException& ex) {
+	}
+	if (walk == nullptr) {
+		LogError("CommitLog: can't read the history of [%s]", fRepositoryPath.String());
+		delete repository;
+		BMessage message(MSG_COMMIT_LOG_PAGE);
+		message.AddBool("end", true);
+		message.AddBool("failed", true);
+		_Send(message);
+		return;
+	}
+
+	bool end = false;
+	while (!fQuit) {
+		status_t status;
+		do {
+			status = acquire_sem(fRequestSem);
+		} while (status == B_INTERRUPTED);
+		if (status != B_OK || fQuit)
+			break;
+
+		bool page = false;
+		{
+			BAutolock lock(fLocker);
+			if (fPendingPages > 0) {
+				fPendingPages--;
+				page = true;
+			}
+		}
+
+		if (page) {
+			std::vector<GitRepository::CommitInfo> commits;
+			if (!end)
+				end = !repository->GetNextCommits(walk, kPageSize, commits);
+			BMessage message(MSG_COMMIT_LOG_PAGE);
+			for (const GitRepository::CommitInfo& commit : commits) {
+				message.AddString("id", commit.id);
+				message.AddString("summary", commit.summary);
+				message.AddString("author", commit.author);
+				message.AddInt64("time", commit.time);
+			}
+			message.AddBool("end", end);
+			if (!_Send(message))
+				break;
+		}
+
+		// one at a time, so that a newer request is soon taken; a page
+		// comes first (its request is still counted by the semaphore)
+		for (;;) {
+			BString id;
+			{
+				BAutolock lock(fLocker);
+				if (fPendingDiffStats.empty() || fPendingPages > 0)
+					break;
+				id = fPendingDiffStats.front();
+				fPendingDiffStats.erase(fPendingDiffStats.begin());
+			}
+			GitRepository::DiffStat diffStat;
+			try {
+				diffStat = repository->GetDiffStat(id);
+			} catch (const GitException& ex) {
+				continue;
+			}
+			BMessage message(MSG_COMMIT_LOG_DIFFSTAT);
+			message.AddString("id", id);
+			message.AddUInt64("files", diffStat.files);
+			message.AddUInt64("insertions", diffStat.insertions);
+			message.AddUInt64("deletions", diffStat.deletions);
+			if (!_Send(message))
+				break;
+		}
+	}
+
+	git_revwalk_free(walk);
+	delete repository;
+}
+
+
+bool
+CommitLog::_Send(BMessage& message)
+{
+	message.AddInt32("log", fID);
+	while (!fQuit) {
+		if (fTarget.SendMessage(&message, (BHandler*)nullptr, kSendTimeout) != B_TIMED_OUT)
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef CommitLog_H
+#define CommitLog_H
+
+
+#include <Locker.h>
+#include <Messenger.h>
+#include <String.h>
+
+#include <atomic>
+#include <vector>
+
+const uint32 MSG_COMMIT_LOG_PAGE = 'clpg';
+const uint32 MSG_COMMIT_LOG_DIFFSTAT = 'clds';
+
+/*
+ * CommitLog reads the history of a repository on a thread of its own, one
+ * page at a time: the revision walk stays open between pages, so a huge
+ * history costs no more than what is shown. Each LoadMore() sends a
+ * MSG_COMMIT_LOG_PAGE with the "id", "summary", "author" and "time" of the
+ * next commits, and "end" once the history is over. The diff stats are
+ * computed only for the commits passed to RequestDiffStats(), the rows in
+ * view: a newer request replaces the one not done yet. Each comes in a
+ * MSG_COMMIT_LOG_DIFFSTAT with "id", "files", "insertions" and "deletions".
+ * Both have the ID() of the log as "log". When the history can't be read,
+ * a single page comes with "end" and "failed".
+ * A started log is not deleted but released: Release() does not wait for
+ * a diff stat in progress, the thread deletes the log once done.
+ */
+class CommitLog {
+public:
+								CommitLog(const BString& repositoryPath,
+									const BMessenger& target);
+
+			status_t			Start();
+			void				Release();
+
+			int32				ID() const { return fID; }
+
+			void				LoadMore();
+			void				RequestDiffStats(const std::vector<BString>& ids);
+
+private:
+								~CommitLog();
+
+	static	status_t			_LogThread(void* self);
+			void				_LogLoop();
+			bool				_Send(BMessage& message);
+
+			int32				fID;
+			BString				fRepositoryPath;
+			BMessenger			fTarget;
+
+			BLocker				fLocker;
+			int32				fPendingPages;
+			std::vector<BString>	fPendingDiffStats;
+
+			sem_id				fRequestSem;
+			thread_id			fThread;
+			std::atomic<bool>	fQuit;
+};
+
+
+#endif // CommitLog_H
@@ -0,0 +1,300 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "CommitLogView.h"
+
+#include <Catalog.h>
+#include <ControlLook.h>
+#include <Window.h>
+
+#include <vector>
+
+#include "CommitLog.h"
+#include "Log.h"
+
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "CommitLogView"
+
+
+// rows left below the view when the next page is asked for
+static const int32 kPrefetchRows = 50;
+static const int32 kShortIdLength = 8;
+
+
+CommitItem::CommitItem(const BString& id, const BString& summary, const BString& author,
+	const BString& date)
+	:
+	BListItem(),
+	fId(id),
+	fSummary(summary),
+	fAuthor(author),
+	fDate(date),
+	fFiles(-1),
+	fInsertions(0),
+	fDeletions(0),
+	fLineHeight(0),
+	fBaselineOffset(0)
+{
+}
+
+
+// Two lines: the summary, then the id, author, date and diff stat, dimmed
+void
+CommitItem::DrawItem(BView* owner, BRect bounds, bool complete)
+{
+	const rgb_color background = IsSelected()
+		? ui_color(B_LIST_SELECTED_BACKGROUND_COLOR) : owner->ViewColor();
+	if (IsSelected() || complete) {
+		owner->SetLowColor(background);
+		owner->FillRect(bounds, B_SOLID_LOW);
+	}
+	owner->SetLowColor(background);
+
+	const rgb_color textColor = ui_color(IsSelected()
+		? B_LIST_SELECTED_ITEM_TEXT_COLOR : B_LIST_ITEM_TEXT_COLOR);
+	const float spacing = be_control_look->DefaultLabelSpacing();
+	const float width = bounds.Width() - spacing * 2;
+
+	BString summary(fSummary);
+	owner->TruncateString(&summary, B_TRUNCATE_END, width);
+	owner->SetHighColor(textColor);
+	owner->DrawString(summary, BPoint(bounds.left + spacing, bounds.top + fBaselineOffset));
+
+	float statsWidth = 0;
+	BString stats;
+	if (HasDiffStat()) {
+		stats << "+" << fInsertions << " -" << fDeletions << "  " << fFiles << " "
+			<< (fFiles == 1 ? B_TRANSLATE("file") : B_TRANSLATE("files"));
+		statsWidth = owner->StringWidth(stats) + spacing;
+	}
+
+	BString details(fId.String(), kShortIdLength);
+	details << "  " << fAuthor << ", " << fDate;
+	owner->TruncateString(&details, B_TRUNCATE_END, width - statsWidth);
+	owner->SetHighColor(mix_color(textColor, background, 96));
+	const float baseline = bounds.top + fLineHeight + fBaselineOffset;
+	owner->DrawString(details, BPoint(bounds.left + spacing, baseline));
+	if (HasDiffStat())
+		owner->DrawString(stats, BPoint(bounds.right - spacing - owner->StringWidth(stats), baseline));
+}
+
+
+void
+CommitItem::Update(BView* owner, const BFont* font)
+{
+	BListItem::Update(owner, font);
+
+	font_height height;
+	font->GetHeight(&height);
+	fLineHeight = ceilf(height.ascent + height.descent + height.leading);
+	fBaselineOffset = 2 + ceilf(height.ascent);
+	SetHeight(fLineHeight * 2 + 4);
+}
+
+
+void
+CommitItem::SetDiffStat(int32 files, int32 insertions, int32 deletions)
+{
+	fFiles = files;
+	fInsertions = insertions;
+	fDeletions = deletions;
+}
+
+
+CommitLogView::CommitLogView()
+	:
+	BListView("CommitLogView", B_SINGLE_SELECTION_LIST,
+		B_WILL_DRAW | B_FRAME_EVENTS | B_NAVIGABLE),
+	fLog(nullptr),
+	fLoading(false),
+	fEnd(false),
+	fFailed(false)
+{
+}
+
+
+CommitLogView::~CommitLogView()
+{
+	Clear();
+}
+
+
+// An empty list says why, when the history could not be read
+void
+CommitLogView::Draw(BRect updateRect)
+{
+	BListView::Draw(updateRect);
+	if (!fFailed || !IsEmpty())
+		return;
+
+	const char* text = B_TRANSLATE("The history of the repository can't be read.");
+	font_height height;
+	GetFontHeight(&height);
+	SetHighColor(mix_color(ui_color(B_LIST_ITEM_TEXT_COLOR), ViewColor(), 96));
+	DrawString(text, BPoint(be_control_look->DefaultLabelSpacing(),
+		be_control_look->DefaultLabelSpacing() + ceilf(height.ascent)));
+}
+
+
+void
+CommitLogView::MessageReceived(BMessage* message)
+{
+	switch (message->what) {
+		case MSG_COMMIT_LOG_PAGE:
+			_AddPage(message);
+			break;
+		case MSG_COMMIT_LOG_DIFFSTAT:
+			_SetDiffStat(message);
+			break;
+		default:
+			BListView::MessageReceived(message);
+			break;
+	}
+}
+
+
+void
+CommitLogView::FrameResized(float width, float height)
+{
+	BListView::FrameResized(width, height);
+	_CheckVisible();
+}
+
+
+void
+CommitLogView::ScrollTo(BPoint where)
+{
+	BListView::ScrollTo(where);
+	_CheckVisible();
+}
+
+
+void
+CommitLogView::SetRepository(const BString& path, const BString& headId)
+{
+	if (fLog != nullptr && path == fRepositoryPath && headId == fHeadId)
+		return;
+
+	Clear();
+	fRepositoryPath = path;
+	fHeadId = headId;
+	fLog = new CommitLog(path, BMessenger(this));
+	status_t status = fLog->Start();
+	if (status != B_OK) {
+		LogError("CommitLogView: can't read the history of [%s]: %s", path.String(),
+			strerror(status));
+		fLog->Release();
+		fLog = nullptr;
+		fFailed = true;
+		Invalidate();
+		return;
+	}
+	fLoading = true;
+	fLog->LoadMore();
+}
+
+
+void
+CommitLogView::Clear()
+{
+	// the log thread may still be busy: it deletes the log when done
+	if (fLog != nullptr)
+		fLog->Release();
+	fLog = nullptr;
+	fRepositoryPath = "";
+	fHeadId = "";
+	fLoading = false;
+	fEnd = false;
+	fFailed = false;
+	fRequestedIds.clear();
+	fItems.clear();
+
+	BList items(*Items());
+	MakeEmpty();
+	for (int32 i = 0; i < items.CountItems(); i++)
+		delete static_cast<CommitItem*>(items.ItemAt(i));
+}
+
+
+void
+CommitLogView::_AddPage(BMessage* message)
+{
+	if (fLog == nullptr || message->GetInt32("log", 0) != fLog->ID())
+		return;
+	fLoading = false;
+	fEnd = message->GetBool("end", true);
+	if (message->GetBool("failed", false)) {
+		fFailed = true;
+		Invalidate();
+		return;
+	}
+
+	BList items;
+	BString id;
+	for (int32 i = 0; message->FindString("id", i, &id) == B_OK; i++) {
+		BString date;
+		fDateFormat.Format(date, (time_t)message->GetInt64("time", i, 0),
+			B_SHORT_DATE_FORMAT, B_SHORT_TIME_FORMAT);
+		CommitItem* item = new CommitItem(id, message->GetString("summary", i, ""),
+			message->GetString("author", i, ""), date);
+		fItems[id] = item;
+		items.AddItem(item);
+	}
+	AddList(&items);
+	_CheckVisible();
+}
+
+
+void
+CommitLogView::_SetDiffStat(BMessage* message)
+{
+	if (fLog == nullptr || message->GetInt32("log", 0) != fLog->ID())
+		return;
+
+	auto it = fItems.find(message->GetString("id", ""));
+	if (it == fItems.end())
+		return;
+	CommitItem* item = it->second;
+	item->SetDiffStat(message->GetUInt64("files", 0), message->GetUInt64("insertions", 0),
+		message->GetUInt64("deletions", 0));
+	InvalidateItem(IndexOf(item));
+}
+
+
+// Asks for the next page when the end of the list is near, and for the
+// diff stats of the rows in view
+void
+CommitLogView::_CheckVisible()
+{
+	if (fLog == nullptr)
+		return;
+
+	const int32 count = CountItems();
+	const BRect bounds = Bounds();
+	int32 first = IndexOf(bounds.LeftTop());
+	if (first < 0)
+		first = 0;
+	int32 last = IndexOf(bounds.LeftBottom());
+	if (last < 0)
+		last = count - 1;
+
+	if (!fLoading && !fEnd && last >= count - kPrefetchRows) {
+		fLoading = true;
+		fLog->LoadMore();
+	}
+
+	std::vector<BString> ids;
+	for (int32 i = first; i <= last; i++) {
+		CommitItem* item = static_cast<CommitItem*>(ItemAt(i));
+		if (!item->HasDiffStat())
+			ids.push_back(item->Id());
+	}
+	// the rows went out of view before their turn: forget them
+	if (ids != fRequestedIds) {
+		fRequestedIds = ids;
+		fLog->RequestDiffStats(ids);
+	}
+}
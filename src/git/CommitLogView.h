@@ -0,0 +1,81 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef CommitLogView_H
+#define CommitLogView_H
+
+
+#include <DateTimeFormat.h>
+#include <ListView.h>
+#include <String.h>
+
+#include <map>
+#include <vector>
+
+
+class CommitLog;
+
+
+class CommitItem : public BListItem {
+public:
+								CommitItem(const BString& id, const BString& summary,
+									const BString& author, const BString& date);
+
+	virtual	void				DrawItem(BView* owner, BRect bounds, bool complete);
+	virtual	void				Update(BView* owner, const BFont* font);
+
+			const BString&		Id() const { return fId; }
+			bool				HasDiffStat() const { return fFiles >= 0; }
+			void				SetDiffStat(int32 files, int32 insertions, int32 deletions);
+
+private:
+			BString				fId;
+			BString				fSummary;
+			BString				fAuthor;
+			BString				fDate;
+			int32				fFiles;			// -1 until known
+			int32				fInsertions;
+			int32				fDeletions;
+			float				fLineHeight;
+			float				fBaselineOffset;
+};
+
+
+/*
+ * CommitLogView shows the history of a repository, read by a CommitLog:
+ * more commits are asked for as the end of the list comes into view, and
+ * the diff stats of the rows in view only.
+ */
+class CommitLogView : public BListView {
+public:
+								CommitLogView();
+	virtual						~CommitLogView();
+
+	virtual	void				Draw(BRect updateRect);
+	virtual	void				MessageReceived(BMessage* message);
+	virtual	void				FrameResized(float width, float height);
+	virtual	void				ScrollTo(BPoint where);
+
+			// reads the history again if the repository or its HEAD changed
+			void				SetRepository(const BString& path, const BString& headId);
+			void				Clear();
+
+private:
+			void				_AddPage(BMessage* message);
+			void				_SetDiffStat(BMessage* message);
+			void				_CheckVisible();
+
+			CommitLog*			fLog;
+			BString				fRepositoryPath;
+			BString				fHeadId;
+			bool				fLoading;
+			bool				fEnd;
+			bool				fFailed;
+			std::map<BString, CommitItem*>	fItems;		// by id
+			std::vector<BString>	fRequestedIds;	// diff stats
+			BDateTimeFormat		fDateFormat;
+};
+
+
+#endif // CommitLogView_H
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "GitOperation.h"
+
+#include <Autolock.h>
+#include <Catalog.h>
+#include <Locker.h>
+
+#include <set>
+
+#include "Log.h"
+
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "GitOperation"
+
+using Genio::Git::GitConflictException;
+using Genio::Git::GitException;
+using Genio::Git::GitRepository;
+
+
+// no more progress messages than this
+static const bigtime_t kProgressInterval = 100000; // 100 ms
+
+// the repositories with a running operation
+static BLocker sRunningLocker("GitOperation");
+static std::set<BString> sRunning;
+
+
+/* static */
+status_t
+GitOperation::Run(const char* name, const BString& repositoryPath,
+	const BMessenger& target, Function function)
+{
+	BAutolock lock(sRunningLocker);
+	if (sRunning.find(repositoryPath) != sRunning.end())
+		return B_BUSY;
+
+	GitOperation* operation = new GitOperation(name, repositoryPath, target, function);
+	thread_id thread = spawn_thread(&GitOperation::_OperationThread, name,
+		B_NORMAL_PRIORITY, operation);
+	if (thread < 0) {
+		delete operation;
+		return thread;
+	}
+	sRunning.insert(repositoryPath);
+	return resume_thread(thread);
+}
+
+
+/* static */
+bool
+GitOperation::IsRunning(const BString& repositoryPath)
+{
+	BAutolock lock(sRunningLocker);
+	return sRunning.find(repositoryPath) != sRunning.end();
+}
+
+
+GitOperation::GitOperation(const char* name, const BString& repositoryPath,
+	const BMessenger& target, Function function)
+	:
+	fName(name),
+	fRepositoryPath(repositoryPath),
+	fTarget(target),
+	fFunction(function),
+	fLastProgress(0)
+{
+}
+
+
+/* static */
+status_t
+GitOperation::_OperationThread(void* self)
+{
+	GitOperation* operation = static_cast<GitOperation*>(self);
+	operation->_Run();
+	{
+		BAutolock lock(sRunningLocker);
+		sRunning.erase(operation->fRepositoryPath);
+	}
+	delete operation;
+	return B_OK;
+}
+
+
+void
+GitOperation::_Run()
+{
+	BMessage result(MSG_GIT_OPERATION_DONE);
+	result.AddString("name", fName);
+	result.AddString("path", fRepositoryPath);
+
+	const bigtime_t start = system_time();
+	try {
+		// libgit2 objects can't be shared between threads: this one is ours
+		GitRepository repository(fRepositoryPath);
+		if (!repository.IsInitialized()) {
+			throw GitException(GIT_ENOTFOUND,
+				B_TRANSLATE("The project does not have a git repository."));
+		}
+		repository.SetProgressCallback(
+			[this](const char* stage, size_t current, size_t total) {
+				_Progress(stage, current, total);
+			});
+		fFunction(repository, result);
+	} catch (const GitConflictException& ex) {
+		result.AddInt32("error", ex.Error());
+		result.AddString("message", ex.Message());
+		result.AddBool("conflict", true);
+		for (const BString& file : ex.GetFiles())
+			result.AddString("file", file);
+	} catch (const GitException& ex) {
+		result.AddInt32("error", ex.Error());
+		result.AddString("message", ex.Message());
+	} catch (const std::exception& ex) {
+		result.AddInt32("error", B_ERROR);
+		result.AddString("message", ex.what());
+	} catch (...) {
+		result.AddInt32("error", B_ERROR);
+		result.AddString("message", B_TRANSLATE("An unknown error occurred."));
+	}
+	LogInfo("GitOperation: %s on [%s] done in %" B_PRIdBIGTIME " ms", fName.String(),
+		fRepositoryPath.String(), (system_time() - start) / 1000);
+
+	fTarget.SendMessage(&result);
+}
+
+
+// Drops what comes sooner than kProgressInterval after the last message,
+// unless a stage is complete
+void
+GitOperation::_Progress(const char* stage, size_t current, size_t total)
+{
+	const bigtime_t now = system_time();
+	if (current < total && now - fLastProgress < kProgressInterval)
+		return;
+	fLastProgress = now;
+
+	BMessage message(MSG_GIT_OPERATION_PROGRESS);
+	message.AddString("name", fName);
+	message.AddString("path", fRepositoryPath);
+	message.AddString("stage", stage);
+	message.AddUInt64("current", current);
+	message.AddUInt64("total", total);
+	// never hold the operation up for a busy window
+	fTarget.SendMessage(&message, (BHandler*)nullptr, 0);
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef GitOperation_H
+#define GitOperation_H
+
+
+#include <Messenger.h>
+#include <String.h>
+
+#include <functional>
+
+#include "GitRepository.h"
+
+const uint32 MSG_GIT_OPERATION_PROGRESS = 'gopr';
+const uint32 MSG_GIT_OPERATION_DONE = 'godn';
+
+/*
+ * GitOperation runs a long GitRepository call (a fetch, a checkout, a stash)
+ * on a thread of its own, with its own repository handle, so that the window
+ * never waits for the network or the disk. Only one operation at a time runs
+ * on a repository: Run() returns B_BUSY otherwise.
+ *
+ * The target gets MSG_GIT_OPERATION_PROGRESS messages, a few per second, with
+ * "name", "path", "stage", "current" and "total", then one
+ * MSG_GIT_OPERATION_DONE with "name", "path" and the fields the function
+ * added. On failure it also has "error", the libgit2 error code, "message"
+ * and, for conflicts, "conflict" and the conflicting files as "file" fields.
+ */
+class GitOperation {
+public:
+	typedef std::function<void(Genio::Git::GitRepository& repository,
+		BMessage& result)> Function;
+
+	static	status_t			Run(const char* name, const BString& repositoryPath,
+									const BMessenger& target, Function function);
+	static	bool				IsRunning(const BString& repositoryPath);
+
+private:
+								GitOperation(const char* name,
+									const BString& repositoryPath,
+									const BMessenger& target, Function function);
+
+	static	status_t			_OperationThread(void* self);
+			void				_Run();
+			void				_Progress(const char* stage, size_t current,
+									size_t total);
+
+			BString				fName;
+			BString				fRepositoryPath;
+			BMessenger			fTarget;
+			Function			fFunction;
+			bigtime_t			fLastProgress;
+};
+
+
+#endif // GitOperation_H
@@ -10,9 +10,16 @@
 #include "GitRepository.h"
 
 #include <Application.h>
+#include <Autolock.h>
 #include <Catalog.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <Locker.h>
 #include <Path.h>
 
+#include <algorithm>
+#include <sys/stat.h>
+
 #include "GitCredentialsWindow.h"
 
 #undef B_TRANSLATION_CONTEXT
@@ -20,11 +27,25 @@
 
 namespace Genio::Git {
 
+	// The refs of a repository, read once for all its GitRepository objects.
+	// A read started before ForgetRefs() is not stored: the generation changed.
+	struct refs_cache {
+		std::map<int, std::vector<BString>>	branches;	// by git_branch_t
+		std::vector<BString>				tags;
+		bool								tagsValid = false;
+		uint32								generation = 0;
+	};
+
+	static BLocker sRefsLocker("git refs cache");
+	static std::map<BString, refs_cache> sRefsCache;	// by repository path
+
 	GitRepository::GitRepository(const BString& path)
 		:
 		fRepository(nullptr),
 		fRepositoryPath(path),
-		fInitialized(false)
+		fInitialized(false),
+		fConfigSize(-1),
+		fSignatureValid(false)
 	{
 		git_libgit2_init();
 		_Open();
@@ -76,14 +97,38 @@ namespace Genio::Git {
 	void
 	GitRepository::Init(bool createInitalCommit)
 	{
+		ForgetRefs();
 		check(git_repository_init(&fRepository, fRepositoryPath.String(), 0));
 		if (createInitalCommit)
 			_CreateInitialCommit();
 		fInitialized = true;
 	}
 
+	// Read once, until ForgetRefs()
 	std::vector<BString>
 	GitRepository::GetBranches(git_branch_t branchType) const
+	{
+		uint32 generation;
+		{
+			BAutolock lock(sRefsLocker);
+			const refs_cache& cache = sRefsCache[fRepositoryPath];
+			auto cached = cache.branches.find(branchType);
+			if (cached != cache.branches.end())
+				return cached->second;
+			generation = cache.generation;
+		}
+
+		std::vector<BString> branches = _ReadBranches(branchType);
+
+		BAutolock lock(sRefsLocker);
+		refs_cache& cache = sRefsCache[fRepositoryPath];
+		if (cache.generation == generation)
+			cache.branches[branchType] = branches;
+		return branches;
+	}
+
+	std::vector<BString>
+	GitRepository::_ReadBranches(git_branch_t branchType) const
 	{
 		git_branch_iterator *it = nullptr;
 		git_reference *ref = nullptr;
@@ -149,6 +194,7 @@ namespace Genio::Git {
 	int
 	GitRepository::SwitchBranch(const BString& name)
 	{
+		ForgetRefs();
 		git_object* tree = nullptr;
 		git_reference* ref = nullptr;
 
@@ -164,6 +210,7 @@ namespace Genio::Git {
 			opts.checkout_strategy = GIT_CHECKOUT_SAFE;
 			opts.notify_cb = checkout_notify;
 			opts.notify_payload = &files;
+			_SetCheckoutProgress(opts);
 
 			check(git_revparse_single(&tree, fRepository, branchName.String()));
 
@@ -217,9 +264,38 @@ namespace Genio::Git {
 		}
 	}
 
+	// The operation in progress (merge, rebase...), named like git's own
+	// prompt does. Empty when there is none.
+	BString
+	GitRepository::GetState() const
+	{
+		switch (git_repository_state(fRepository)) {
+			case GIT_REPOSITORY_STATE_MERGE:
+				return "MERGING";
+			case GIT_REPOSITORY_STATE_REVERT:
+			case GIT_REPOSITORY_STATE_REVERT_SEQUENCE:
+				return "REVERTING";
+			case GIT_REPOSITORY_STATE_CHERRYPICK:
+			case GIT_REPOSITORY_STATE_CHERRYPICK_SEQUENCE:
+				return "CHERRY-PICKING";
+			case GIT_REPOSITORY_STATE_BISECT:
+				return "BISECTING";
+			case GIT_REPOSITORY_STATE_REBASE:
+			case GIT_REPOSITORY_STATE_REBASE_INTERACTIVE:
+			case GIT_REPOSITORY_STATE_REBASE_MERGE:
+				return "REBASING";
+			case GIT_REPOSITORY_STATE_APPLY_MAILBOX:
+			case GIT_REPOSITORY_STATE_APPLY_MAILBOX_OR_REBASE:
+				return "AM";
+			default:
+				return "";
+		}
+	}
+
 	void
 	GitRepository::DeleteBranch(const BString& branch, git_branch_t type)
 	{
+		ForgetRefs();
 		git_reference* ref = nullptr;
 		try {
 			check(git_branch_lookup(&ref, fRepository, branch.String(), type));
@@ -235,6 +311,7 @@ namespace Genio::Git {
 	void
 	GitRepository::RenameBranch(const BString& old_name, const BString& new_name, git_branch_t type)
 	{
+		ForgetRefs();
 		git_reference* ref = nullptr;
 		git_reference* out = nullptr;
 		try {
@@ -258,6 +335,7 @@ namespace Genio::Git {
 	GitRepository::CreateBranch(const BString& existingBranchName, git_branch_t type,
 		const BString& newBranchName)
 	{
+		ForgetRefs();
 		git_reference *existing_branch_ref = nullptr;
 		git_reference *new_branch_ref = nullptr;
 		git_commit *commit = nullptr;
@@ -350,6 +428,256 @@ namespace Genio::Git {
 		return fileStatuses;
 	}
 
+	static const unsigned int kStatusFlags = GIT_STATUS_OPT_INCLUDE_UNTRACKED
+		| GIT_STATUS_OPT_INCLUDE_IGNORED | GIT_STATUS_OPT_RENAMES_HEAD_TO_INDEX
+		| GIT_STATUS_OPT_EXCLUDE_SUBMODULES;
+
+	// below this many files in the index, the status is read on one thread
+	static const size_t kParallelStatusThreshold = 20000;
+
+	static int
+	CollectStatus(git_repository* repository, git_status_show_t show, unsigned int flags,
+		const std::vector<BString>& paths, GitRepository::StatusMap& statuses)
+	{
+		git_status_options statusopt;
+		git_status_init_options(&statusopt, GIT_STATUS_OPTIONS_VERSION);
+		statusopt.show = show;
+		statusopt.flags = flags;
+
+		std::vector<const char*> pathspec;
+		for (const BString& path : paths)
+			pathspec.push_back(path.String());
+		if (!pathspec.empty()) {
+			statusopt.pathspec.strings = const_cast<char**>(pathspec.data());
+			statusopt.pathspec.count = pathspec.size();
+			statusopt.flags |= GIT_STATUS_OPT_DISABLE_PATHSPEC_MATCH;
+		}
+
+		git_status_list *status = nullptr;
+		int error = git_status_list_new(&status, repository, &statusopt);
+		if (error < 0)
+			return error;
+
+		const size_t count = git_status_list_entrycount(status);
+		for (size_t i = 0; i < count; i++) {
+			const git_status_entry *entry = git_status_byindex(status, i);
+			if (entry->status == GIT_STATUS_CURRENT)
+				continue;
+
+			const git_diff_delta *delta = entry->index_to_workdir != nullptr
+				? entry->index_to_workdir : entry->head_to_index;
+			BString path(delta->new_file.path);
+			if (path.EndsWith("/"))
+				path.Truncate(path.Length() - 1);
+			statuses[path] |= entry->status;
+		}
+
+		git_status_list_free(status);
+		return 0;
+	}
+
+	// Untracked and ignored folders are reported once, not file by file,
+	// without the trailing '/'. With paths (literal, relative to the working
+	// tree), only the status of those files and folders is computed.
+	// The index is only read: a write would come back through the path
+	// monitor of .git as a change, and start another full read.
+	GitRepository::StatusMap
+	GitRepository::GetStatus(const std::vector<BString>& paths) const
+	{
+		StatusMap statuses;
+		check(CollectStatus(fRepository, GIT_STATUS_SHOW_INDEX_AND_WORKDIR, kStatusFlags,
+			paths, statuses));
+		return statuses;
+	}
+
+	struct status_job {
+		BString							repositoryPath;
+		std::vector<BString>			paths;
+		GitRepository::StatusMap		statuses;
+		int								error;
+		BString							message;
+	};
+
+	static status_t
+	StatusThread(void* data)
+	{
+		status_job* job = static_cast<status_job*>(data);
+		// each thread needs a repository of its own
+		git_repository* repository = nullptr;
+		job->error = git_repository_open(&repository, job->repositoryPath.String());
+		if (job->error >= 0) {
+			job->error = CollectStatus(repository, GIT_STATUS_SHOW_WORKDIR_ONLY, kStatusFlags,
+				job->paths, job->statuses);
+		}
+		if (job->error < 0 && git_error_last() != nullptr)
+			job->message = git_error_last()->message;
+		git_repository_free(repository);
+		return B_OK;
+	}
+
+	// The same as GetStatus() for the whole working tree. For large ones the
+	// index is compared to HEAD on this thread, while the working tree,
+	// split by its top level entries, is compared to the index on up to
+	// threadCount threads.
+	GitRepository::StatusMap
+	GitRepository::GetStatusInParallel(int32 threadCount) const
+	{
+		git_index* index = nullptr;
+		check(git_repository_index(&index, fRepository));
+		const size_t entryCount = git_index_entrycount(index);
+		if (threadCount < 2 || entryCount < kParallelStatusThreshold) {
+			git_index_free(index);
+			return GetStatus();
+		}
+
+		// the top level entries, weighted by the files they hold
+		std::map<BString, size_t> weights;
+		for (size_t i = 0; i < entryCount; i++) {
+			const char* path = git_index_get_byindex(index, i)->path;
+			const char* slash = strchr(path, '/');
+			weights[BString(path, slash != nullptr ? slash - path : strlen(path))]++;
+		}
+		git_index_free(index);
+
+		BDirectory directory(git_repository_workdir(fRepository));
+		BEntry entry;
+		while (directory.GetNextEntry(&entry) == B_OK) {
+			char name[B_FILE_NAME_LENGTH];
+			if (entry.GetName(name) == B_OK && strcmp(name, ".git") != 0)
+				weights[name]++;
+		}
+
+		std::vector<std::pair<size_t, BString>> entries;
+		for (const auto& weight : weights)
+			entries.emplace_back(weight.second, weight.first);
+		std::sort(entries.begin(), entries.end(),
+			[](const auto& a, const auto& b) { return a.first > b.first; });
+
+		const int32 jobCount = std::min(threadCount, (int32)entries.size());
+		std::vector<status_job> jobs(jobCount);
+		std::vector<size_t> loads(jobCount, 0);
+		for (const auto& entry : entries) {
+			const int32 lightest = std::min_element(loads.begin(), loads.end()) - loads.begin();
+			jobs[lightest].paths.push_back(entry.second);
+			loads[lightest] += entry.first;
+		}
+
+		std::vector<thread_id> threads;
+		for (status_job& job : jobs) {
+			job.repositoryPath = fRepositoryPath;
+			job.error = 0;
+			const thread_id thread = spawn_thread(StatusThread, "git status job",
+				B_LOW_PRIORITY, &job);
+			if (thread < 0 || resume_thread(thread) != B_OK)
+				StatusThread(&job);
+			else
+				threads.push_back(thread);
+		}
+
+		StatusMap statuses;
+		int status = CollectStatus(fRepository, GIT_STATUS_SHOW_INDEX_ONLY, kStatusFlags, {},
+			statuses);
+		BString message;
+		if (status < 0 && git_error_last() != nullptr)
+			message = git_error_last()->message;
+		for (thread_id thread : threads) {
+			status_t exitValue;
+			wait_for_thread(thread, &exitValue);
+		}
+		if (status < 0)
+			throw GitException(status, message);
+
+		for (const status_job& job : jobs) {
+			if (job.error < 0)
+				throw GitException(job.error, job.message);
+			for (const auto& jobStatus : job.statuses)
+				statuses[jobStatus.first] |= jobStatus.second;
+		}
+		return statuses;
+	}
+
+	// Empty on an unborn branch
+	BString
+	GitRepository::GetHeadId() const
+	{
+		git_oid oid;
+		if (git_reference_name_to_id(&oid, fRepository, "HEAD") < 0)
+			return "";
+		char id[GIT_OID_HEXSZ + 1];
+		return git_oid_tostr(id, sizeof(id), &oid);
+	}
+
+	git_revwalk*
+	GitRepository::NewHistoryWalk() const
+	{
+		git_revwalk* walk = nullptr;
+		check(git_revwalk_new(&walk, fRepository));
+		git_revwalk_sorting(walk, GIT_SORT_TIME);
+		// nothing to walk on an unborn branch
+		git_revwalk_push_head(walk);
+		return walk;
+	}
+
+	// Adds up to count commits; returns false once the history is over
+	bool
+	GitRepository::GetNextCommits(git_revwalk* walk, size_t count,
+		std::vector<CommitInfo>& commits) const
+	{
+		git_oid oid;
+		for (size_t i = 0; i < count; i++) {
+			if (git_revwalk_next(&oid, walk) != 0)
+				return false;
+
+			git_commit* commit = nullptr;
+			if (git_commit_lookup(&commit, fRepository, &oid) < 0)
+				continue;
+			char id[GIT_OID_HEXSZ + 1];
+			const git_signature* author = git_commit_author(commit);
+			const char* summary = git_commit_summary(commit);
+			commits.push_back({ git_oid_tostr(id, sizeof(id), &oid),
+				summary != nullptr ? summary : "", author->name,
+				static_cast<time_t>(git_commit_time(commit)) });
+			git_commit_free(commit);
+		}
+		return true;
+	}
+
+	// Against the first parent; the whole tree for a root commit
+	GitRepository::DiffStat
+	GitRepository::GetDiffStat(const BString& commitId) const
+	{
+		git_oid oid;
+		git_commit* commit = nullptr;
+		git_commit* parent = nullptr;
+		git_tree* tree = nullptr;
+		git_tree* parentTree = nullptr;
+		git_diff* diff = nullptr;
+		git_diff_stats* stats = nullptr;
+		auto cleanUp = [&]() {
+			git_diff_stats_free(stats);
+			git_diff_free(diff);
+			git_tree_free(parentTree);
+			git_tree_free(tree);
+			git_commit_free(parent);
+			git_commit_free(commit);
+		};
+
+		check(git_oid_fromstr(&oid, commitId.String()));
+		check(git_commit_lookup(&commit, fRepository, &oid), cleanUp);
+		check(git_commit_tree(&tree, commit), cleanUp);
+		if (git_commit_parentcount(commit) > 0) {
+			check(git_commit_parent(&parent, commit, 0), cleanUp);
+			check(git_commit_tree(&parentTree, parent), cleanUp);
+		}
+		check(git_diff_tree_to_tree(&diff, fRepository, parentTree, tree, nullptr), cleanUp);
+		check(git_diff_get_stats(&stats, diff), cleanUp);
+
+		DiffStat diffStat = { git_diff_stats_files_changed(stats),
+			git_diff_stats_insertions(stats), git_diff_stats_deletions(stats) };
+		cleanUp();
+		return diffStat;
+	}
+
 	const BPath&
 	GitRepository::Clone(const BString& url, const BPath& localPath,
 							git_indexer_progress_cb callback,
@@ -379,9 +707,14 @@ namespace Genio::Git {
 	void
 	GitRepository::Fetch(bool prune)
 	{
+		ForgetRefs();
 		git_remote *remote = nullptr;
 		git_fetch_options fetch_opts = GIT_FETCH_OPTIONS_INIT;
 		fetch_opts.callbacks.credentials = GitCredentialsWindow::authentication_callback;
+		if (fProgressCallback != nullptr) {
+			fetch_opts.callbacks.transfer_progress = _TransferProgress;
+			fetch_opts.callbacks.payload = this;
+		}
 		if (prune)
 			fetch_opts.prune = GIT_FETCH_PRUNE;
 		else
@@ -546,6 +879,17 @@ namespace Genio::Git {
 	  return ret;
 	}
 
+	void
+	GitRepository::ForgetRefs()
+	{
+		BAutolock lock(sRefsLocker);
+		refs_cache& cache = sRefsCache[fRepositoryPath];
+		cache.branches.clear();
+		cache.tags.clear();
+		cache.tagsValid = false;
+		cache.generation++;
+	}
+
 	void
 	GitRepository::_ConfigSet(git_config *cfg, const char *key, const char *value)
 	{
@@ -596,20 +940,109 @@ namespace Genio::Git {
 	void
 	GitRepository::StashPop()
 	{
-		git_stash_apply_options opts = GIT_STASH_APPLY_OPTIONS_INIT;
-		check(git_stash_pop(fRepository, 0, &opts));
+		_StashApply(true);
 	}
 
 	void
 	GitRepository::StashApply()
 	{
+		_StashApply(false);
+	}
+
+	void
+	GitRepository::_StashApply(bool pop)
+	{
+		std::vector<BString> files;
 		git_stash_apply_options opts = GIT_STASH_APPLY_OPTIONS_INIT;
-		check(git_stash_apply(fRepository, 0, &opts));
+		opts.checkout_options.notify_flags = GIT_CHECKOUT_NOTIFY_CONFLICT;
+		opts.checkout_options.notify_cb = checkout_notify;
+		opts.checkout_options.notify_payload = &files;
+		_SetCheckoutProgress(opts.checkout_options);
+		if (fProgressCallback != nullptr) {
+			opts.progress_cb = _StashProgress;
+			opts.progress_payload = this;
+		}
+
+		int status = pop ? git_stash_pop(fRepository, 0, &opts)
+			: git_stash_apply(fRepository, 0, &opts);
+		if (status == GIT_ECONFLICT || (status < 0 && !files.empty()))
+			throw GitConflictException(status, git_error_last()->message, files);
+		check(status);
 	}
 
+	void
+	GitRepository::_SetCheckoutProgress(git_checkout_options& options)
+	{
+		if (fProgressCallback != nullptr) {
+			options.progress_cb = _CheckoutProgress;
+			options.progress_payload = this;
+		}
+	}
 
+	/* static */
+	int
+	GitRepository::_TransferProgress(const git_indexer_progress* stats, void* payload)
+	{
+		GitRepository* repository = static_cast<GitRepository*>(payload);
+		if (stats->received_objects < stats->total_objects) {
+			repository->fProgressCallback(B_TRANSLATE("Receiving objects"),
+				stats->received_objects, stats->total_objects);
+		} else if (stats->total_deltas > 0) {
+			repository->fProgressCallback(B_TRANSLATE("Resolving deltas"),
+				stats->indexed_deltas, stats->total_deltas);
+		}
+		return 0;
+	}
+
+	/* static */
+	void
+	GitRepository::_CheckoutProgress(const char* path, size_t completed, size_t total,
+		void* payload)
+	{
+		GitRepository* repository = static_cast<GitRepository*>(payload);
+		repository->fProgressCallback(B_TRANSLATE("Updating files"), completed, total);
+	}
+
+	/* static */
+	int
+	GitRepository::_StashProgress(git_stash_apply_progress_t progress, void* payload)
+	{
+		// the checkout has a progress of its own
+		if (progress < GIT_STASH_APPLY_PROGRESS_CHECKOUT_UNTRACKED) {
+			GitRepository* repository = static_cast<GitRepository*>(payload);
+			repository->fProgressCallback(B_TRANSLATE("Reading the stash"), progress,
+				GIT_STASH_APPLY_PROGRESS_CHECKOUT_UNTRACKED);
+		}
+		return 0;
+	}
+
+
+	// Read once, until ForgetRefs()
 	std::vector<BString>
 	GitRepository::GetTags() const
+	{
+		uint32 generation;
+		{
+			BAutolock lock(sRefsLocker);
+			const refs_cache& cache = sRefsCache[fRepositoryPath];
+			if (cache.tagsValid)
+				return cache.tags;
+			generation = cache.generation;
+		}
+
+		std::vector<BString> tags = _ReadTags();
+
+		BAutolock lock(sRefsLocker);
+		refs_cache& cache = sRefsCache[fRepositoryPath];
+		if (cache.generation == generation) {
+			cache.tags = tags;
+			cache.tagsValid = true;
+		}
+		return tags;
+	}
+
+	std::vector<BString>
+	GitRepository::_ReadTags() const
 	{
 		std::vector<BString> tags;
 
@@ -629,23 +1062,42 @@ namespace Genio::Git {
 		return tags;
 	}
 
+	// The user name and email are read again only when the config file
+	// changes: a stat() costs much less than parsing it.
 	git_signature*
 	GitRepository::_GetSignature() const
 	{
 		// TODO - Put this into Genio Prefs
-		git_config* cfg = nullptr;
-		git_config* cfgSnapshot = nullptr;
-
-		git_config_open_ondisk(&cfg, "/boot/home/config/settings/git/config");
-		git_config_snapshot(&cfgSnapshot, cfg);
+		const char* configPath = "/boot/home/config/settings/git/config";
+
+		struct stat st = {};
+		stat(configPath, &st);
+		if (!fSignatureValid || st.st_mtim.tv_sec != fConfigTime.tv_sec
+			|| st.st_mtim.tv_nsec != fConfigTime.tv_nsec || st.st_size != fConfigSize) {
+			git_config* cfg = nullptr;
+			git_config* cfgSnapshot = nullptr;
+			git_config_open_ondisk(&cfg, configPath);
+			git_config_snapshot(&cfgSnapshot, cfg);
+
+			const char* userName;
+			const char* userEmail;
+			auto cleanUp = [&]() {
+				git_config_free(cfgSnapshot);
+				git_config_free(cfg);
+			};
+			check(git_config_get_string(&userName, cfgSnapshot, "user.name"), cleanUp);
+			check(git_config_get_string(&userEmail, cfgSnapshot, "user.email"), cleanUp);
+			fSignatureName = userName;
+			fSignatureEmail = userEmail;
+			cleanUp();
+
+			fConfigTime = st.st_mtim;
+			fConfigSize = st.st_size;
+			fSignatureValid = true;
+		}
 
-		const char* userName;
-		const char* userEmail;
 		git_signature *signature = nullptr;
-		check(git_config_get_string(&userName, cfgSnapshot, "user.name"));
-		check(git_config_get_string(&userEmail, cfgSnapshot, "user.email"));
-		check(git_signature_now(&signature, userName, userEmail));
-
+		check(git_signature_now(&signature, fSignatureName.String(), fSignatureEmail.String()));
 		return signature;
 	}
 
@@ -687,6 +1139,7 @@ namespace Genio::Git {
 			ffCheckoutOptions.notify_flags = GIT_CHECKOUT_NOTIFY_CONFLICT;
 			ffCheckoutOptions.notify_cb = checkout_notify;
 			ffCheckoutOptions.notify_payload = &files;
+			_SetCheckoutProgress(ffCheckoutOptions);
 			ffCheckoutOptions.checkout_strategy = GIT_CHECKOUT_SAFE;
 			int status = git_checkout_tree(fRepository, target, &ffCheckoutOptions);
 			if (status < 0) {
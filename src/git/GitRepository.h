@@ -12,6 +12,7 @@
 #include <git2.h>
 
 #include <functional>
+#include <map>
 #include <vector>
 
 #include "GException.h"
@@ -64,6 +65,24 @@ namespace Genio::Git {
 	class GitRepository {
 	public:
 		typedef std::vector<std::pair<BString, BString>> RepoFiles;
+		// path relative to the working tree -> git_status_t flags
+		typedef std::map<BString, uint32> StatusMap;
+		// Called from the thread running the operation: what is being done, done steps, total steps
+		typedef std::function<void(const char* stage, size_t current, size_t total)>
+			ProgressCallback;
+
+		struct CommitInfo {
+			BString		id;
+			BString		summary;
+			BString		author;
+			time_t		time;
+		};
+
+		struct DiffStat {
+			size_t		files;
+			size_t		insertions;
+			size_t		deletions;
+		};
 
 		// Payload to search for merge branch.
 		struct fetch_payload {
@@ -88,6 +107,7 @@ namespace Genio::Git {
 		std::vector<BString>			GetBranches(git_branch_t type = GIT_BRANCH_LOCAL) const;
 		int								SwitchBranch(const BString& branch);
 		BString							GetCurrentBranch() const;
+		BString							GetState() const;
 		void							DeleteBranch(const BString& branch, git_branch_t type);
 		void							RenameBranch(const BString& oldName, const BString& newName,
 											git_branch_t type);
@@ -107,11 +127,48 @@ namespace Genio::Git {
 		void 							StashApply();
 
 		RepoFiles						GetFiles() const;
+		StatusMap						GetStatus(const std::vector<BString>& paths = {}) const;
+		StatusMap						GetStatusInParallel(int32 threadCount) const;
+
+		BString							GetHeadId() const;
+		// The history from HEAD, newest first: read it a page at a time with
+		// GetNextCommits(), then git_revwalk_free() it
+		git_revwalk*					NewHistoryWalk() const;
+		bool							GetNextCommits(git_revwalk* walk, size_t count,
+											std::vector<CommitInfo>& commits) const;
+		DiffStat						GetDiffStat(const BString& commitId) const;
+
+		void							SetProgressCallback(ProgressCallback callback)
+											{ fProgressCallback = callback; }
+
+		// Branches and tags are cached by repository path, shared by all the
+		// GitRepository objects (and threads) of that path. Call this when
+		// the refs change on disk
+		void							ForgetRefs();
 
 	private:
 		git_repository 					*fRepository;
 		BString							fRepositoryPath;
 		bool							fInitialized;
+		ProgressCallback				fProgressCallback;
+
+		mutable BString					fSignatureName;
+		mutable BString					fSignatureEmail;
+		mutable timespec				fConfigTime;
+		mutable off_t					fConfigSize;
+		mutable bool					fSignatureValid;
+
+		std::vector<BString>			_ReadBranches(git_branch_t type) const;
+		std::vector<BString>			_ReadTags() const;
+
+		static int						_TransferProgress(const git_indexer_progress* stats,
+											void* payload);
+		static void						_CheckoutProgress(const char* path, size_t completed,
+											size_t total, void* payload);
+		static int						_StashProgress(git_stash_apply_progress_t progress,
+											void* payload);
+		void							_SetCheckoutProgress(git_checkout_options& options);
+		void							_StashApply(bool pop);
 
 		void							_Open();
 
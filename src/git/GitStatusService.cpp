@@ -0,0 +1,429 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "GitStatusService.h"
+
+#include <Autolock.h>
+
+#include <algorithm>
+
+#include "ConfigManager.h"
+#include "GenioApp.h"
+#include "Log.h"
+
+using Genio::Git::GitException;
+using Genio::Git::GitRepository;
+
+
+// how long a send may block before checking if the service was stopped
+static const bigtime_t kSendTimeout = 100000; // 100 ms
+// past this many paths, the whole status is read again
+static const size_t kMaxPendingPaths = 256;
+// the working tree is read from disk: more threads don't help
+static const int32 kMaxStatusThreads = 4;
+
+
+static bool
+IsInside(const BString& path, const BString& folder)
+{
+	return path == folder || (path.Length() > folder.Length()
+		&& path[folder.Length()] == '/'
+		&& strncmp(path.String(), folder.String(), folder.Length()) == 0);
+}
+
+
+GitStatusService::GitStatusService(const BString& root, const BMessenger& target)
+	:
+	fRoot(root),
+	fTarget(target),
+	fLocker("GitStatusService"),
+	fPendingAll(true),
+	fRefreshSem(create_sem(0, "git status refresh")),
+	fThread(-1),
+	fQuit(false),
+	fThreadCount(1),
+	fVerify(gCFG["git_status_verify"])
+{
+	system_info info;
+	if (get_system_info(&info) == B_OK)
+		fThreadCount = std::clamp((int32)info.cpu_count, (int32)1, kMaxStatusThreads);
+}
+
+
+GitStatusService::~GitStatusService()
+{
+	delete_sem(fRefreshSem);
+}
+
+
+status_t
+GitStatusService::Start()
+{
+	fThread = spawn_thread(&GitStatusService::_StatusThread, "git status",
+		B_LOW_PRIORITY, this);
+	if (fThread < 0)
+		return fThread;
+	release_sem(fRefreshSem);
+	status_t status = resume_thread(fThread);
+	if (status != B_OK) {
+		kill_thread(fThread);
+		fThread = -1;
+	}
+	return status;
+}
+
+
+// A status read can take long on a large working tree: the thread is not
+// waited for, it deletes the service when it is over
+void
+GitStatusService::Release()
+{
+	if (fThread < 0) {
+		delete this;
+		return;
+	}
+	fQuit = true;
+	release_sem(fRefreshSem);
+}
+
+
+// Paths outside of the working tree, or in .git, are ignored
+void
+GitStatusService::Refresh(const BString& path)
+{
+	BString relativePath;
+	if (!_RelativePath(path, relativePath) || relativePath.IsEmpty()
+		|| IsInside(relativePath, ".git")) {
+		return;
+	}
+
+	BAutolock lock(fLocker);
+	if (fPendingAll)
+		return;
+	fPendingPaths.insert(relativePath);
+	if (fPendingPaths.size() > kMaxPendingPaths) {
+		fPendingPaths.clear();
+		fPendingAll = true;
+	}
+	release_sem(fRefreshSem);
+}
+
+
+// For changes which may touch any file: a commit, a checkout, staging
+void
+GitStatusService::RefreshAll()
+{
+	BAutolock lock(fLocker);
+	fPendingPaths.clear();
+	fPendingAll = true;
+	release_sem(fRefreshSem);
+}
+
+
+// The git_status_t flags of an absolute path. Files in untracked or ignored
+// folders share the status of the folder; folders holding changed files
+// have kGitStatusContainsChanges.
+uint32
+GitStatusService::StatusFor(const BString& path)
+{
+	BString relativePath;
+	if (!_RelativePath(path, relativePath))
+		return 0;
+
+	BAutolock lock(fLocker);
+	uint32 status = 0;
+	auto it = fStatuses.find(relativePath);
+	if (it != fStatuses.end())
+		status = it->second;
+
+	for (int32 slash = relativePath.FindFirst('/'); slash > 0 && status == 0;
+			slash = relativePath.FindFirst('/', slash + 1)) {
+		it = fStatuses.find(BString(relativePath.String(), slash));
+		if (it != fStatuses.end()
+			&& (it->second & (GIT_STATUS_WT_NEW | GIT_STATUS_IGNORED)) != 0) {
+			status = it->second;
+		}
+	}
+
+	BString prefix(relativePath);
+	if (!prefix.IsEmpty())
+		prefix << "/";
+	for (it = fStatuses.lower_bound(prefix); it != fStatuses.end()
+			&& strncmp(it->first.String(), prefix.String(), prefix.Length()) == 0; it++) {
+		if ((it->second & GIT_STATUS_IGNORED) == 0) {
+			status |= kGitStatusContainsChanges;
+			break;
+		}
+	}
+	return status;
+}
+
+
+// The paths with a known status inside folder, and the folder itself, are
+// sent again: the items just created for them start without a status
+void
+GitStatusService::Announce(const BString& folder)
+{
+	BString relativePath;
+	if (!_RelativePath(folder, relativePath) || IsInside(relativePath, ".git"))
+		return;
+
+	BAutolock lock(fLocker);
+	fPendingAnnouncements.insert(relativePath);
+	release_sem(fRefreshSem);
+}
+
+
+/* static */
+status_t
+GitStatusService::_StatusThread(void* self)
+{
+	GitStatusService* service = static_cast<GitStatusService*>(self);
+	service->_StatusLoop();
+	delete service;
+	return B_OK;
+}
+
+
+void
+GitStatusService::_StatusLoop()
+{
+	// libgit2 objects can't be shared between threads: this one is ours
+	GitRepository* repository = nullptr;
+	try {
+		repository = new GitRepository(fRoot);
+	} catch (const GitException& ex) {
+	}
+	if (repository == nullptr || !repository->IsInitialized()) {
+		LogError("GitStatusService: can't open the repository in [%s]", fRoot.String());
+		delete repository;
+		return;
+	}
+
+	while (!fQuit) {
+		status_t status;
+		do {
+			status = acquire_sem(fRefreshSem);
+		} while (status == B_INTERRUPTED);
+		if (status != B_OK || fQuit)
+			break;
+
+		bool all;
+		std::vector<BString> paths;
+		std::vector<BString> announcements;
+		{
+			BAutolock lock(fLocker);
+			all = fPendingAll;
+			paths.assign(fPendingPaths.begin(), fPendingPaths.end());
+			announcements.assign(fPendingAnnouncements.begin(), fPendingAnnouncements.end());
+			fPendingAll = false;
+			fPendingPaths.clear();
+			fPendingAnnouncements.clear();
+		}
+
+		if (all || !paths.empty()) {
+			const bigtime_t start = system_time();
+			GitRepository::StatusMap statuses;
+			bool read = true;
+			try {
+				statuses = all ? repository->GetStatusInParallel(fThreadCount)
+					: repository->GetStatus(paths);
+			} catch (const GitException& ex) {
+				read = false;
+			}
+			if (fQuit)
+				break;
+			if (read) {
+				_Apply(statuses, all ? nullptr : &paths);
+				LogDebug("GitStatusService: status of %d paths of [%s] in %" B_PRIdBIGTIME " ms",
+					all ? -1 : (int32)paths.size(), fRoot.String(),
+					(system_time() - start) / 1000);
+				if (fVerify)
+					_Verify(repository);
+			}
+		}
+		if (!announcements.empty())
+			_Announce(announcements);
+	}
+	delete repository;
+}
+
+
+// Replaces the status of the given paths (the whole working tree without
+// them) and sends the paths which changed. Only this thread changes
+// fStatuses: the changes are found without the lock, which is only taken
+// to store them.
+void
+GitStatusService::_Apply(GitRepository::StatusMap& statuses,
+	const std::vector<BString>* paths)
+{
+	std::set<BString> changed;
+	if (paths == nullptr) {
+		auto known = fStatuses.begin();
+		auto found = statuses.begin();
+		while (known != fStatuses.end() || found != statuses.end()) {
+			if (found == statuses.end()
+				|| (known != fStatuses.end() && known->first < found->first)) {
+				changed.insert(known->first);
+				known++;
+			} else if (known == fStatuses.end() || found->first < known->first) {
+				changed.insert(found->first);
+				found++;
+			} else {
+				if (known->second != found->second)
+					changed.insert(known->first);
+				known++;
+				found++;
+			}
+		}
+		BAutolock lock(fLocker);
+		fStatuses.swap(statuses);
+	} else {
+		// the path itself, then what is inside it
+		std::vector<BString> removed;
+		for (const BString& path : *paths) {
+			if (fStatuses.find(path) != fStatuses.end() && statuses.find(path) == statuses.end())
+				removed.push_back(path);
+			BString prefix(path);
+			prefix << "/";
+			for (auto it = fStatuses.lower_bound(prefix); it != fStatuses.end()
+					&& strncmp(it->first.String(), prefix.String(), prefix.Length()) == 0;
+					it++) {
+				if (statuses.find(it->first) == statuses.end())
+					removed.push_back(it->first);
+			}
+		}
+		changed.insert(removed.begin(), removed.end());
+		// new ones, or a folder reported for a path inside it
+		for (const auto& status : statuses) {
+			auto it = fStatuses.find(status.first);
+			if (it == fStatuses.end() || it->second != status.second)
+				changed.insert(status.first);
+		}
+
+		BAutolock lock(fLocker);
+		for (const BString& path : removed)
+			fStatuses.erase(path);
+		for (const auto& status : statuses)
+			fStatuses[status.first] = status.second;
+	}
+	if (!changed.empty())
+		_Send(changed);
+}
+
+
+void
+GitStatusService::_Announce(const std::vector<BString>& folders)
+{
+	std::set<BString> paths;
+	for (const BString& folder : folders) {
+		if (fStatuses.find(folder) != fStatuses.end())
+			paths.insert(folder);
+		BString prefix(folder);
+		if (!prefix.IsEmpty())
+			prefix << "/";
+		for (auto it = fStatuses.lower_bound(prefix); it != fStatuses.end()
+				&& strncmp(it->first.String(), prefix.String(), prefix.Length()) == 0; it++) {
+			paths.insert(it->first);
+		}
+	}
+	if (!paths.empty())
+		_Send(paths);
+}
+
+
+// Sends the paths and the folders holding them, which may have changed too
+void
+GitStatusService::_Send(const std::set<BString>& paths)
+{
+	std::set<BString> folders;
+	folders.insert("");
+	for (const BString& path : paths) {
+		for (int32 slash = path.FindFirst('/'); slash > 0;
+				slash = path.FindFirst('/', slash + 1)) {
+			folders.insert(BString(path.String(), slash));
+		}
+	}
+	folders.insert(paths.begin(), paths.end());
+
+	BMessage message(MSG_GIT_STATUS_CHANGED);
+	message.AddString("root", fRoot);
+	for (const BString& path : folders) {
+		BString absolutePath(fRoot);
+		if (!path.IsEmpty())
+			absolutePath << "/" << path;
+		message.AddString("path", absolutePath);
+	}
+	while (!fQuit) {
+		if (fTarget.SendMessage(&message, (BHandler*)nullptr, kSendTimeout) != B_TIMED_OUT)
+			break;
+	}
+}
+
+
+// Compares what is known to a full status read on one thread, logs the
+// differences, then keeps the full status
+void
+GitStatusService::_Verify(GitRepository* repository)
+{
+	GitRepository::StatusMap statuses;
+	try {
+		statuses = repository->GetStatus();
+	} catch (const GitException& ex) {
+		return;
+	}
+
+	int32 differences = 0;
+	{
+		BAutolock lock(fLocker);
+		auto known = fStatuses.begin();
+		auto full = statuses.begin();
+		while (known != fStatuses.end() || full != statuses.end()) {
+			if (full == statuses.end()
+				|| (known != fStatuses.end() && known->first < full->first)) {
+				LogError("GitStatusService: [%s] is %#" B_PRIx32 ", not in the full status",
+					known->first.String(), known->second);
+				known++;
+			} else if (known == fStatuses.end() || full->first < known->first) {
+				LogError("GitStatusService: [%s] is missing, %#" B_PRIx32 " in the full status",
+					full->first.String(), full->second);
+				full++;
+			} else {
+				if (known->second != full->second) {
+					LogError("GitStatusService: [%s] is %#" B_PRIx32 ", %#" B_PRIx32
+						" in the full status", known->first.String(), known->second,
+						full->second);
+					differences++;
+				}
+				known++;
+				full++;
+				continue;
+			}
+			differences++;
+		}
+	}
+	if (differences > 0) {
+		LogError("GitStatusService: %" B_PRId32 " differences with the full status of [%s]",
+			differences, fRoot.String());
+		_Apply(statuses, nullptr);
+	}
+}
+
+
+bool
+GitStatusService::_RelativePath(const BString& path, BString& relativePath) const
+{
+	if (strncmp(path.String(), fRoot.String(), fRoot.Length()) != 0)
+		return false;
+	if (path.Length() == fRoot.Length()) {
+		relativePath = "";
+		return true;
+	}
+	if (path[fRoot.Length()] != '/')
+		return false;
+	relativePath.SetTo(path.String() + fRoot.Length() + 1);
+	return true;
+}
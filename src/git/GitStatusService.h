@@ -0,0 +1,87 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef GitStatusService_H
+#define GitStatusService_H
+
+
+#include <Locker.h>
+#include <Messenger.h>
+#include <String.h>
+
+#include <atomic>
+#include <set>
+
+#include "GitRepository.h"
+
+const uint32 MSG_GIT_STATUS_CHANGED = 'gsch';
+
+// Added to the git_status_t flags of the folders holding changed files
+const uint32 kGitStatusContainsChanges = 1u << 31;
+
+/*
+ * GitStatusService keeps the git status of the files of a working tree,
+ * computed on a thread of its own with its own repository handle: the
+ * caller never waits for libgit2. It reads the whole status once, then
+ * only the status of the paths passed to Refresh() (as path monitor events
+ * arrive). The absolute paths whose status changed, and their folders, are
+ * sent to the target as "path" fields of MSG_GIT_STATUS_CHANGED messages,
+ * with the working tree as "root". Large working trees are read on several
+ * threads. With the hidden "git_status_verify" setting, each refresh is
+ * checked against a full status read, and the differences are logged.
+ * Announce() sends the paths with a known status inside a folder, for the
+ * items just created for it. StatusFor() locks the service only briefly: the
+ * statuses are computed before the lock is taken.
+ * A started service is not deleted but released: Release() does not wait
+ * for a status read in progress, the thread deletes the service once done.
+ */
+class GitStatusService {
+public:
+								GitStatusService(const BString& root,
+									const BMessenger& target);
+
+			status_t			Start();
+			void				Release();
+
+			const BString&		Root() const { return fRoot; }
+
+			void				Refresh(const BString& path);
+			void				RefreshAll();
+			void				Announce(const BString& folder);
+
+			uint32				StatusFor(const BString& path);
+
+private:
+								~GitStatusService();
+
+	static	status_t			_StatusThread(void* self);
+			void				_StatusLoop();
+			void				_Apply(Genio::Git::GitRepository::StatusMap& statuses,
+									const std::vector<BString>* paths);
+			void				_Announce(const std::vector<BString>& folders);
+			void				_Send(const std::set<BString>& paths);
+			void				_Verify(Genio::Git::GitRepository* repository);
+			bool				_RelativePath(const BString& path,
+									BString& relativePath) const;
+
+			BString				fRoot;
+			BMessenger			fTarget;
+
+			BLocker				fLocker;
+			Genio::Git::GitRepository::StatusMap	fStatuses;
+			std::set<BString>	fPendingPaths;
+			bool				fPendingAll;
+			std::set<BString>	fPendingAnnouncements;
+
+			sem_id				fRefreshSem;
+			thread_id			fThread;
+			std::atomic<bool>	fQuit;
+
+			int32				fThreadCount;
+			// compare each refresh to a full status read
+			bool				fVerify;
+};
+
+
+#endif // GitStatusService_H
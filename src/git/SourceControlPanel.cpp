@@ -22,11 +22,13 @@
 #include <ScrollView.h>
 #include <StringView.h>
 
+#include "CommitLogView.h"
 #include "ConfigManager.h"
 #include "GenioApp.h"
 #include "GenioWindow.h"
 #include "GenioWindowMessages.h"
 #include "GitAlert.h"
+#include "GitOperation.h"
 #include "GTextAlert.h"
 #include "Log.h"
 #include "ProjectFolder.h"
@@ -59,6 +61,7 @@ SourceControlPanel::SourceControlPanel()
 	BView(B_TRANSLATE("Source control"), B_WILL_DRAW | B_FRAME_EVENTS ),
 	fProjectMenu(nullptr),
 	fBranchMenu(nullptr),
+	fCommitLogView(nullptr),
 	fProjectList(nullptr),
 	fSelectedProjectPath(),
 	fCurrentBranch(nullptr),
@@ -134,7 +137,7 @@ SourceControlPanel::_InitToolBar()
 	fToolBar->ChangeIconSize(16);
 	fToolBar->AddAction(MsgShowRepositoryPanel, B_TRANSLATE("Repository"), "kIconGitRepo", true);
 	// fToolBar->AddAction(MsgShowChangesPanel, B_TRANSLATE("Changes"), "kIconGitChanges");
-	// fToolBar->AddAction(MsgShowLogPanel, B_TRANSLATE("Log"), "kIconGitLog");
+	fToolBar->AddAction(MsgShowLogPanel, B_TRANSLATE("Log"), "kIconGitLog", true);
 	fToolBar->AddGlue();
 	fToolBar->AddAction(MsgShowActionsMenu, B_TRANSLATE("Actions"), "kIconGitMore", true);
 }
@@ -166,14 +169,26 @@ SourceControlPanel::_InitChangesView()
 void
 SourceControlPanel::_InitLogView()
 {
-	fLogView = BLayoutBuilder::Group<>(B_HORIZONTAL, B_USE_BORDER_INSETS)
-		.AddGroup(B_VERTICAL)
-			.AddGlue()
-			.Add(new BButton("log"))
-			.AddGlue()
-		.End()
-		.AddGlue()
-		.View();
+	fCommitLogView = new CommitLogView();
+	fLogView = new BScrollView("Log scroll view", fCommitLogView,
+		B_FRAME_EVENTS | B_WILL_DRAW, false, true, border_style::B_NO_BORDER);
+}
+
+
+// The history is read only while the log panel is shown
+void
+SourceControlPanel::_UpdateLogView()
+{
+	if (fPanelsLayout->VisibleIndex() != kPanelsIndexLog)
+		return;
+
+	ProjectFolder* project = _GetSelectedProject();
+	if (project == nullptr || project->GetRepository() == nullptr
+		|| !project->GetRepository()->IsInitialized()) {
+		fCommitLogView->Clear();
+		return;
+	}
+	fCommitLogView->SetRepository(project->Path(), project->GetRepository()->GetHeadId());
 }
 
 
@@ -375,6 +390,7 @@ SourceControlPanel::MessageReceived(BMessage *message)
 				if (fPanelsLayout->VisibleIndex() != kPanelsIndexLog)
 					fPanelsLayout->SetVisibleItem(kPanelsIndexLog);
 				fToolBar->ToggleActionPressed(MsgShowLogPanel);
+				_UpdateLogView();
 				break;
 			}
 			case MsgShowActionsMenu: {
@@ -386,22 +402,18 @@ SourceControlPanel::MessageReceived(BMessage *message)
 			}
 			case MsgFetch: {
 				LogInfo("MsgFetch");
-				ProjectFolder* selectedProject = _GetSelectedProject();
-				if (selectedProject == nullptr)
-					break;
-				selectedProject->GetRepository()->Fetch();
-				_ShowGitNotification(B_TRANSLATE("Fetch completed."));
-				_UpdateBranchList();
+				_RunGitOperation(MsgFetch, "git fetch",
+					[](GitRepository& repository, BMessage& result) {
+						repository.Fetch();
+					});
 				break;
 			}
 			case MsgFetchPrune: {
 				LogInfo("MsgFetchPrune");
-				ProjectFolder* selectedProject = _GetSelectedProject();
-				if (selectedProject == nullptr)
-					break;
-				selectedProject->GetRepository()->Fetch(true);
-				_ShowGitNotification(B_TRANSLATE("Fetch prune completed."));
-				_UpdateBranchList();
+				_RunGitOperation(MsgFetchPrune, "git fetch prune",
+					[](GitRepository& repository, BMessage& result) {
+						repository.Fetch(true);
+					});
 				break;
 			}
 			case MsgStashSave: {
@@ -416,27 +428,35 @@ SourceControlPanel::MessageReceived(BMessage *message)
 				auto result = alert->Go();
 				if (result.Button == GAlertButtons::OkButton) {
 					stashMessage = result.Result;
-					selectedProject->GetRepository()->StashSave(stashMessage);
-					_ShowGitNotification(B_TRANSLATE("Changes stashed."));
+					_RunGitOperation(MsgStashSave, "git stash save",
+						[stashMessage](GitRepository& repository, BMessage& result) {
+							repository.StashSave(stashMessage);
+						});
 				}
 				break;
 			}
 			case MsgStashPop: {
 				LogInfo("MsgStashPop");
-				ProjectFolder* selectedProject = _GetSelectedProject();
-				if (selectedProject == nullptr)
-					break;
-				selectedProject->GetRepository()->StashPop();
-				_ShowGitNotification(B_TRANSLATE("Stashed changes popped."));
+				_RunGitOperation(MsgStashPop, "git stash pop",
+					[](GitRepository& repository, BMessage& result) {
+						repository.StashPop();
+					});
 				break;
 			}
 			case MsgStashApply: {
 				LogInfo("MsgStashApply");
-				ProjectFolder* selectedProject = _GetSelectedProject();
-				if (selectedProject == nullptr)
-					break;
-				selectedProject->GetRepository()->StashApply();
-				_ShowGitNotification(B_TRANSLATE("Stashed changes applied."));
+				_RunGitOperation(MsgStashApply, "git stash apply",
+					[](GitRepository& repository, BMessage& result) {
+						repository.StashApply();
+					});
+				break;
+			}
+			case MSG_GIT_OPERATION_PROGRESS: {
+				_GitOperationProgress(message);
+				break;
+			}
+			case MSG_GIT_OPERATION_DONE: {
+				_GitOperationDone(message);
 				break;
 			}
 			case MsgChangeProject: {
@@ -631,6 +651,7 @@ SourceControlPanel::_ChangeProject(BMessage *message)
 				try {
 					_UpdateBranchList(false);
 					_UpdateRepositoryView();
+					_UpdateLogView();
 				} catch(const GitException &ex) {
 					LogInfo(" %s repository has no valid info", selectedProject->Name().String());
 				}
@@ -672,27 +693,163 @@ void
 SourceControlPanel::_SwitchBranch(BMessage *message)
 {
 	ProjectFolder* project = _GetSelectedProject();
+	if (project == nullptr)
+		return;
 	if (project->IsBuilding()) {
 		OKAlert("Source control panel",
 			B_TRANSLATE("The project is building, changing branch not allowed."),
 			B_STOP_ALERT);
-	} else {
-		const BString branch = message->GetString("value");
-		const BString sender = message->GetString("sender");
-
-		auto repo = project->GetRepository();
-		repo->SwitchBranch(branch);
-		fCurrentBranch = repo->GetCurrentBranch();
-
-		if (sender == kSenderBranchOptionList) {
-			// we update the repository view
-			_UpdateRepositoryView();
-		} else if (sender == kSenderRepositoryPopupMenu || sender == kSenderExternalEvent) {
-			// we update the repository view and the branch option list
+		return;
+	}
+
+	const BString branch = message->GetString("value");
+	const BString sender = message->GetString("sender");
+	if (branch == fCurrentBranch && project->GetRepository()->GetCurrentBranch() == branch) {
+		// nothing to check out
+		_BranchSwitched(sender);
+		return;
+	}
+
+	_RunGitOperation(MsgSwitchBranch, "git switch branch",
+		[branch, sender](GitRepository& repository, BMessage& result) {
+			result.AddString("sender", sender);
+			repository.SwitchBranch(branch);
+		});
+}
+
+
+void
+SourceControlPanel::_BranchSwitched(const BString& sender)
+{
+	ProjectFolder* project = _GetSelectedProject();
+	if (project == nullptr)
+		return;
+	fCurrentBranch = project->GetRepository()->GetCurrentBranch();
+
+	if (sender == kSenderBranchOptionList) {
+		// we update the repository view
+		_UpdateRepositoryView();
+	} else if (sender == kSenderRepositoryPopupMenu || sender == kSenderExternalEvent) {
+		// we update the repository view and the branch option list
+		_UpdateBranchList(false);
+		_UpdateRepositoryView();
+	}
+	_UpdateLogView();
+}
+
+
+// Runs the function on the repository of the selected project, on a thread
+// of its own. The result comes back as MSG_GIT_OPERATION_DONE.
+void
+SourceControlPanel::_RunGitOperation(uint32 operation, const char* name,
+	GitOperation::Function function)
+{
+	ProjectFolder* project = _GetSelectedProject();
+	if (project == nullptr)
+		return;
+
+	status_t status = GitOperation::Run(name, project->Path(), BMessenger(this),
+		[operation, function](GitRepository& repository, BMessage& result) {
+			result.AddInt32("operation", operation);
+			function(repository, result);
+		});
+	if (status == B_BUSY) {
+		_ShowGitNotification(B_TRANSLATE("Another git operation is running, try again later."));
+		// the branch menu shows what was chosen, not the current branch
+		if (operation == MsgSwitchBranch)
 			_UpdateBranchList(false);
-			_UpdateRepositoryView();
+	} else if (status != B_OK) {
+		OKAlert("SourceControlPanel", strerror(status), B_STOP_ALERT);
+	}
+}
+
+
+void
+SourceControlPanel::_GitOperationProgress(BMessage* message)
+{
+	const BString path = message->GetString("path");
+	const uint64 current = message->GetUInt64("current", 0);
+	const uint64 total = message->GetUInt64("total", 0);
+	BString text(message->GetString("stage"));
+	text << B_UTF8_ELLIPSIS << " " << current << "/" << total;
+	ProgressNotification("Genio", path, path, text,
+		total > 0 ? (float)current / total : 0.0f);
+}
+
+
+void
+SourceControlPanel::_GitOperationDone(BMessage* message)
+{
+	const BString path = message->GetString("path");
+	const uint32 operation = message->GetInt32("operation", -1);
+	const bool selected = path == fSelectedProjectPath;
+
+	// the operation ran on a repository of its own: what was cached here
+	// may be stale before the path monitor tells
+	ProjectFolder* project = gMainWindow->GetProjectBrowser()->ProjectByPath(path);
+	if (project != nullptr && project->GetRepository() != nullptr)
+		project->GetRepository()->ForgetRefs();
+
+	int32 error;
+	if (message->FindInt32("error", &error) == B_OK) {
+		// replaces the progress notification
+		ShowNotification("Genio", path, path, B_TRANSLATE("The git operation failed."),
+			B_ERROR_NOTIFICATION);
+		// the credentials window was closed
+		if (error == CANCEL_CREDENTIALS)
+			return;
+		const BString text = message->GetString("message");
+		if (message->GetBool("conflict")) {
+			std::vector<BString> files;
+			BString file;
+			for (int32 i = 0; message->FindString("file", i, &file) == B_OK; i++)
+				files.push_back(file);
+			auto alert = new GitAlert(B_TRANSLATE("Conflicts"), B_TRANSLATE(text.String()),
+				files);
+			alert->Go();
+		} else {
+			OKAlert("SourceControlPanel", text.String(), B_STOP_ALERT);
 		}
+		// in case of conflicts the branch will not change but the item in the OptionList will so
+		// we ask the OptionList to redraw
+		if (selected && operation == MsgSwitchBranch)
+			_UpdateBranchList(false);
+		return;
+	}
+
+	BString text;
+	switch (operation) {
+		case MsgFetch:
+			text = B_TRANSLATE("Fetch completed.");
+			break;
+		case MsgFetchPrune:
+			text = B_TRANSLATE("Fetch prune completed.");
+			break;
+		case MsgStashSave:
+			text = B_TRANSLATE("Changes stashed.");
+			break;
+		case MsgStashPop:
+			text = B_TRANSLATE("Stashed changes popped.");
+			break;
+		case MsgStashApply:
+			text = B_TRANSLATE("Stashed changes applied.");
+			break;
+		case MsgSwitchBranch:
+			text = B_TRANSLATE("Branch switched.");
+			break;
+		default:
+			break;
 	}
+	// replaces the progress notification
+	if (!text.IsEmpty())
+		ShowNotification("Genio", path, path, text);
+
+	if (!selected)
+		return;
+	if (operation == MsgFetch || operation == MsgFetchPrune)
+		_UpdateBranchList();
+	else if (operation == MsgSwitchBranch)
+		_BranchSwitched(message->GetString("sender"));
 }
 
 
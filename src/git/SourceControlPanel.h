@@ -9,6 +9,7 @@
 #include <LayoutBuilder.h>
 #include <ObjectList.h>
 
+#include "GitOperation.h"
 #include "OptionList.h"
 #include "ToolBar.h"
 
@@ -45,6 +46,7 @@ const char* const kSenderRepositoryPopupMenu = "RepositoryPopupMenu";
 const char* const kSenderExternalEvent = "ExternalEvent";
 
 class BCheckBox;
+class CommitLogView;
 class ProjectFolder;
 class RepositoryView;
 class BScrollView;
@@ -68,6 +70,7 @@ private:
 	BScrollView*			fRepositoryViewScroll;
 	BView*					fChangesView;
 	BView*					fLogView;
+	CommitLogView*			fCommitLogView;
 	BView*					fRepositoryNotInitializedView;
 	const BObjectList<ProjectFolder>* fProjectList;
 	BString					fSelectedProjectPath;
@@ -85,6 +88,7 @@ private:
 	void					_UpdateRepositoryView();
 	void					_InitChangesView();
 	void					_InitLogView();
+	void					_UpdateLogView();
 	void					_InitRepositoryNotInitializedView();
 
 	void					_ShowOptionsMenu(BPoint where);
@@ -92,4 +96,10 @@ private:
 
 	void					_ChangeProject(BMessage *message);
 	void					_SwitchBranch(BMessage *message);
+	void					_BranchSwitched(const BString& sender);
+
+	void					_RunGitOperation(uint32 operation, const char* name,
+								GitOperation::Function function);
+	void					_GitOperationProgress(BMessage* message);
+	void					_GitOperationDone(BMessage* message);
 };
@@ -121,6 +121,9 @@ SwitchBranchMenu::_BuildMenu()
 	RemoveItems(0, count, true);
 
 	if (fActiveProjectPath) {
+		// runs in the menu thread: the repository object of the project
+		// belongs to the window thread, so use our own. The branches come
+		// from the refs cache all the objects of the path share.
 		Genio::Git::GitRepository* repo = nullptr;
 		try {
 			repo = new Genio::Git::GitRepository(fActiveProjectPath);
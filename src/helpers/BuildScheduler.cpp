@@ -0,0 +1,115 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "BuildScheduler.h"
+
+#include <OS.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+
+// cores left to the editor and the language servers
+static const int32 kReservedCores = 1;
+
+// how long the busy cores are measured before a build
+static const bigtime_t kSampleWindow = 250000; // 250 ms
+
+
+static bool
+ActiveTime(int32 cpuCount, bigtime_t& activeTime)
+{
+	cpu_info* info = new cpu_info[cpuCount];
+	if (get_cpu_info(0, cpuCount, info) != B_OK) {
+		delete[] info;
+		return false;
+	}
+
+	activeTime = 0;
+	for (int32 i = 0; i < cpuCount; i++)
+		activeTime += info[i].active_time;
+	delete[] info;
+	return true;
+}
+
+
+// Number of cores busy on average right now, over kSampleWindow: an average
+// since the previous build would count that build's own compilers
+static float
+BusyCores(int32 cpuCount)
+{
+	bigtime_t startActive;
+	bigtime_t endActive;
+	const bigtime_t start = system_time();
+	if (!ActiveTime(cpuCount, startActive))
+		return 0;
+	snooze(kSampleWindow);
+	if (!ActiveTime(cpuCount, endActive))
+		return 0;
+
+	const bigtime_t elapsed = system_time() - start;
+	const float busy = elapsed > 0 ? float(endActive - startActive) / elapsed : 0;
+	return std::max(0.0f, busy);
+}
+
+
+static bool
+IsWordBoundary(char c)
+{
+	return c == '\0' || isspace(c) || c == ';' || c == '&' || c == '|';
+}
+
+
+/* static */
+int32
+BuildScheduler::Jobs(int32 jobs)
+{
+	if (jobs != kAutomaticJobs)
+		return std::max(int32(1), jobs);
+
+	system_info info;
+	if (get_system_info(&info) != B_OK)
+		return 1;
+
+	const int32 cpuCount = info.cpu_count;
+	const int32 busy = int32(std::ceil(BusyCores(cpuCount)));
+	return std::max(int32(1), cpuCount - busy - kReservedCores);
+}
+
+
+// jam and plain make commands get a -jN switch, anything else (scripts,
+// make calls inside compound commands) gets MAKEFLAGS. Commands already
+// choosing their parallelism are left alone.
+/* static */
+BString
+BuildScheduler::ApplyJobs(const BString& command, int32 jobs)
+{
+	if (command.FindFirst(" -j") >= 0 || command.FindFirst("--parallel") >= 0
+		|| command.FindFirst("MAKEFLAGS") >= 0) {
+		return command;
+	}
+
+	BString jobsArg;
+	jobsArg << " -j" << jobs;
+
+	BString result(command);
+	result.Trim();
+	static const char* kTools[] = { "jam", "make", "gmake" };
+	for (const char* tool : kTools) {
+		const int32 length = strlen(tool);
+		if (result.Compare(tool, length) == 0
+			&& IsWordBoundary(result.String()[length])
+			&& result.FindFirst("&&") < 0 && result.FindFirst(';') < 0) {
+			result.Insert(jobsArg, length);
+			return result;
+		}
+	}
+
+	result.Prepend("; ").Prepend(jobsArg.String() + 1).Prepend("export MAKEFLAGS=");
+	return result;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef BuildScheduler_H
+#define BuildScheduler_H
+
+
+#include <String.h>
+
+/*
+ * BuildScheduler picks how many parallel jobs a build may use and injects
+ * them in the build command.
+ * The automatic job count is the number of idle cores, measured over a
+ * quarter of a second before the build, minus one core kept for the editor
+ * and the language servers. Builds started while clangd is indexing or the
+ * editor is busy get fewer jobs. Jobs() blocks while measuring: it must not
+ * be called from a window thread.
+ */
+class BuildScheduler {
+public:
+	// jobs: the project setting, kAutomaticJobs or an explicit count
+	static	int32			Jobs(int32 jobs);
+	static	BString			ApplyJobs(const BString& command, int32 jobs);
+
+	static	const int32		kAutomaticJobs = 0;
+};
+
+
+#endif // BuildScheduler_H
@@ -9,10 +9,15 @@
 
 GrepThread::GrepThread(BMessage* cmd_message, const BMessenger& consoleTarget)
 	: ConsoleIOThread(cmd_message, consoleTarget)
+	, fSkipCurrent(false)
 {
 	fCurrentMessage.MakeEmpty();
 	fCurrentFileName[0] = '\0';
 	fNextFileName[0] = '\0';
+
+	const char* skipFile = nullptr;
+	for (int32 i = 0; cmd_message->FindString("skip_file", i, &skipFile) == B_OK; i++)
+		fSkipFiles.insert(skipFile);
 }
 
 // Method freely derived from TextGrep by Matthijs Hollemans
@@ -30,16 +35,26 @@ GrepThread::OnStdOutputLine(const BString& stdOut)
 	sscanf(fLine, "%[^\n:]:%d:%n", fNextFileName, &lineNumber, &textPos);
 	if (textPos > 0) {
 		if (strcmp(fNextFileName, fCurrentFileName) != 0) {
-			fTarget.SendMessage(&fCurrentMessage);
+			if (fCurrentMessage.HasMessage("line"))
+				fTarget.SendMessage(&fCurrentMessage);
 			strncpy(fCurrentFileName, fNextFileName, B_PATH_NAME_LENGTH);
+			fCurrentMessage.MakeEmpty();
+
+			// results for open files come from their editor buffers
+			fSkipCurrent = fSkipFiles.find(fCurrentFileName) != fSkipFiles.end();
+			if (fSkipCurrent)
+				return;
+
 			BEntry entry(fNextFileName);
 			entry.GetRef(&fCurrentRef);
 
-			fCurrentMessage.MakeEmpty();
 			fCurrentMessage.what = MSG_REPORT_RESULT;
 			fCurrentMessage.AddString("filename", fCurrentFileName);
 		}
 
+		if (fSkipCurrent)
+			return;
+
 		char* text = &fLine[strlen(fNextFileName) + 1];
 		BMessage lineMessage;
 		lineMessage.what = B_REFS_RECEIVED;
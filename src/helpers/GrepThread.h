@@ -4,6 +4,9 @@
  */
 #pragma once
 
+#include <set>
+#include <string>
+
 #include "ConsoleIOThread.h"
 
 #define MAX_LINE_LEN B_PATH_NAME_LENGTH * 2
@@ -27,4 +30,7 @@ private:
 	char fNextFileName[B_PATH_NAME_LENGTH];
 	BMessage fCurrentMessage;
 	entry_ref fCurrentRef;
+	// files already searched in their open editor buffer
+	std::set<std::string> fSkipFiles;
+	bool fSkipCurrent;
 };
@@ -11,130 +11,109 @@
 
 #include <cerrno>
 #include <cstdlib>
+#include <fcntl.h>
+#include <spawn.h>
 #include <unistd.h>
-#include <image.h>
 
-#include <Locker.h>
-
- //lock access play with stdin/stdout
-BLocker* PipeImage::sLockStdFilesPntr = new BLocker ("Std-In-Out Changed Lock");
-
-status_t
-PipeImage::Init(const char **argv, int32 argc, bool dupStdErr, bool resume)
+// Both ends are close on exec from the start, so no child spawned
+// meanwhile, by any thread, can inherit them. Our child gets its ends
+// through dup2, which clears the flag on the copy.
+static status_t
+_CreatePipe(int fds[2])
 {
-	// first we should backup current STDIO/STDOUT
-	// then we prepare the pipes for the 'child'
-	// we load_image
-	// if ok we fix the stdio/stdout to link to the child
-	// if ko we revert original state.
-	// we run the thread. crossing finger.
+	if (pipe2(fds, O_CLOEXEC) != 0)
+		return errno;
+	return B_OK;
+}
 
-	fDupStdErr = dupStdErr;
 
-	sLockStdFilesPntr->Lock();
+PipeImage::PipeImage()
+	:
+	fChildpid(-1),
+	fDupStdErr(false)
+{
+	fOutPipe[0] = fOutPipe[1] = fInPipe[0] = fInPipe[1] = -1;
+	fErrPipe[0] = fErrPipe[1] = -1;
+}
 
-	int originalStdIn = dup (STDIN_FILENO);
-	int PipeFlags = fcntl (originalStdIn, F_GETFD);
-	PipeFlags |= FD_CLOEXEC;
-	fcntl (originalStdIn, F_SETFD, PipeFlags);
 
-	int originalStdOut = dup (STDOUT_FILENO);
-	PipeFlags = fcntl (originalStdOut, F_GETFD);
-	PipeFlags |= FD_CLOEXEC;
-	fcntl (originalStdOut, F_SETFD, PipeFlags);
+status_t
+PipeImage::Init(const char **argv, bool dupStdErr,
+	const char* workingDirectory)
+{
+	// we prepare the pipes for the 'child'
+	// we describe the child's stdin/stdout/stderr and working directory
+	// as spawn file actions: nothing changes in our process.
+	// the child is started in its own process group.
 
-	int originalStdErr = 0;
-	if (fDupStdErr) {
-		originalStdErr = dup(STDERR_FILENO);
-		PipeFlags = fcntl (originalStdErr, F_GETFD);
-		PipeFlags |= FD_CLOEXEC;
-		fcntl (originalStdErr, F_SETFD, PipeFlags);
+	fDupStdErr = dupStdErr;
+	fOutPipe[0] = fOutPipe[1] = fInPipe[0] = fInPipe[1] = -1;
+	fErrPipe[0] = fErrPipe[1] = -1;
+
+	status_t status = _CreatePipe(fOutPipe);
+	if (status == B_OK)
+		status = _CreatePipe(fInPipe);
+	if (status == B_OK && fDupStdErr)
+		status = _CreatePipe(fErrPipe);
+	if (status != B_OK) {
+		Close();
+		return status;
 	}
 
-  sLockStdFilesPntr->Unlock();
-
-
-	if (pipe (fOutPipe) != 0) // Returns -1 if failed, 0 if okay.
-		return errno; // Pipe creation failed.
-
-	if (pipe (fInPipe) != 0) // Returns -1 if failed, 0 if okay.
-		return errno; // Pipe creation failed.
-
-	if (fDupStdErr) {
-		if (pipe (fErrPipe) != 0) // Returns -1 if failed, 0 if okay.
-			return errno; // Pipe creation failed.
-	}
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, fOutPipe[READ_END], STDIN_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, fInPipe[WRITE_END], STDOUT_FILENO);
+	if (fDupStdErr)
+		posix_spawn_file_actions_adddup2(&actions, fErrPipe[WRITE_END], STDERR_FILENO);
+	if (workingDirectory != nullptr && workingDirectory[0] != '\0')
+		posix_spawn_file_actions_addchdir_np(&actions, workingDirectory);
 
-	// Write end of the outPipe NOT used by the child, make it close on exec.
-	PipeFlags = fcntl (fOutPipe[WRITE_END], F_GETFD);
-	PipeFlags |= FD_CLOEXEC;
-	fcntl (fOutPipe[WRITE_END], F_SETFD, PipeFlags);
+	posix_spawnattr_t attributes;
+	posix_spawnattr_init(&attributes);
+	posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+	posix_spawnattr_setpgroup(&attributes, 0);
 
-	// Read end of the inPipe NOT used by the child, make it close on exec.
-	PipeFlags = fcntl (fInPipe[READ_END], F_GETFD);
-	PipeFlags |= FD_CLOEXEC;
-	fcntl (fInPipe[READ_END], F_SETFD, PipeFlags);
+	pid_t childpid = -1;
+	int result = posix_spawnp(&childpid, argv[0], &actions, &attributes,
+		const_cast<char* const*>(argv), environ);
 
-	if (fDupStdErr) {
-		// Read end of the errPipe NOT used by the child, make it close on exec.
-		PipeFlags = fcntl (fErrPipe[READ_END], F_GETFD);
-		PipeFlags |= FD_CLOEXEC;
-		fcntl (fErrPipe[READ_END], F_SETFD, PipeFlags);
-	}
+	posix_spawnattr_destroy(&attributes);
+	posix_spawn_file_actions_destroy(&actions);
 
-	dup2(fInPipe[WRITE_END], STDOUT_FILENO);
-	close(fInPipe[WRITE_END]);
-	dup2(fOutPipe[READ_END], STDIN_FILENO);
+	// the child ends are not used by us
 	close(fOutPipe[READ_END]);
-
-	if (fDupStdErr) {
-		dup2(fErrPipe[WRITE_END], STDERR_FILENO);
-		close(fErrPipe[WRITE_END]);
-	}
-
-	status_t stat = B_OK;
-	fChildpid = load_image (argc, argv, const_cast<const char **>(environ));
-	if (fChildpid < 0)
-	{
-		if (fDupStdErr) {
-			close(fErrPipe[READ_END]);
-		}
-		close(fOutPipe[WRITE_END]);
-		close(fInPipe[READ_END]);
-		stat = fChildpid;
-	}
-	else
-	{
-		setpgid (fChildpid, fChildpid);
-		if (resume)
-			resume_thread (fChildpid); // rock'n'roll!
-	}
+	close(fInPipe[WRITE_END]);
+	fOutPipe[READ_END] = fInPipe[WRITE_END] = -1;
 	if (fDupStdErr) {
 		close(fErrPipe[WRITE_END]);
+		fErrPipe[WRITE_END] = -1;
 	}
-	close(fOutPipe[READ_END]);
-	close(fInPipe[WRITE_END]);
 
-	sLockStdFilesPntr->Lock();
-
-	dup2 (originalStdIn, STDIN_FILENO);
-	dup2 (originalStdOut, STDOUT_FILENO);
-	if (fDupStdErr) {
-		dup2 (originalStdErr, STDERR_FILENO);
+	if (result != 0) {
+		Close();
+		fChildpid = -1;
+		return result;
 	}
-	sLockStdFilesPntr->Unlock();
 
-	return stat;
+	fChildpid = childpid;
+	return B_OK;
 }
 
+
 void
 PipeImage::Close()
 {
-	close(fOutPipe[WRITE_END]);
-	if (fDupStdErr) {
-		close(fErrPipe[READ_END]);
+	// safe to call more than once: closed descriptors are reset
+	for (int i = 0; i < 2; i++) {
+		if (fOutPipe[i] >= 0)
+			close(fOutPipe[i]);
+		if (fInPipe[i] >= 0)
+			close(fInPipe[i]);
+		if (fErrPipe[i] >= 0)
+			close(fErrPipe[i]);
+		fOutPipe[i] = fInPipe[i] = fErrPipe[i] = -1;
 	}
-	close(fInPipe[READ_END]);
 }
 
 PipeImage::~PipeImage()
@@ -12,13 +12,21 @@
 
 // to read from the new image created:   read(fInPipe[READ_END],..
 // to write from the new image created:  write(fOutPipe[WRITE_END],..
+//
+// The child is started with posix_spawn: its standard files and working
+// directory are set up for the child only, so the process-wide stdio and
+// current directory are never touched and several children can be
+// started in parallel.
 
-class BLocker;
 class PipeImage {
 
 public:
 
-  status_t Init(const char **argv, int32 argc, bool dupStdErr, bool resume);
+  PipeImage();
+
+  // argv ends with a nullptr
+  status_t Init(const char **argv, bool dupStdErr,
+  				const char* workingDirectory = nullptr);
 
   virtual ~PipeImage();
   void	Close();
@@ -29,8 +37,6 @@ public:
   ssize_t Read(void* buffer, size_t size);
   ssize_t Write(const void* buffer, size_t size);
 
-  static BLocker *sLockStdFilesPntr;
-
   int GetStdOutFD() { return fInPipe[READ_END]; };
   int GetStdErrFD() { return fErrPipe[READ_END]; };
   int GetStdInFD() { return fOutPipe[WRITE_END]; };
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "AnsiDecoder.h"
+
+#include <array>
+#include <cstring>
+
+#include <InterfaceDefs.h>
+
+
+enum {
+	kStateGround = 0,
+	kStateEscape,
+	kStateCSI,
+	kStateOSC,
+	kStateOSCEscape,
+	kStateCount
+};
+
+enum {
+	kClassPrint = 0,	// plain text, including UTF-8 bytes
+	kClassControl,		// C0 controls but ESC and BEL (\n, \t, \r...)
+	kClassEscape,		// ESC
+	kClassBell,			// BEL, terminates OSC
+	kClassDigit,		// CSI parameter digits
+	kClassSeparator,	// CSI parameter separators ; and :
+	kClassIntermediate,	// 0x20-0x2f and private markers 0x3c-0x3f
+	kClassOpenCSI,		// [
+	kClassOpenOSC,		// ]
+	kClassFinal,		// 0x40-0x7e
+	kClassCount
+};
+
+enum {
+	kActionPrint = 0,	// character is part of the text
+	kActionNone,		// character is dropped
+	kActionClear,		// start of a CSI sequence
+	kActionDigit,
+	kActionNextParam,
+	kActionDispatch		// end of a CSI sequence
+};
+
+struct Transition {
+	uint8	action;
+	uint8	state;
+};
+
+
+static constexpr std::array<uint8, 256> kCharClasses = [] {
+	std::array<uint8, 256> classes{};
+	for (int c = 0; c < 256; c++) {
+		if (c == 0x1b)
+			classes[c] = kClassEscape;
+		else if (c == 0x07)
+			classes[c] = kClassBell;
+		else if (c < 0x20 || c == 0x7f)
+			classes[c] = kClassControl;
+		else if (c >= '0' && c <= '9')
+			classes[c] = kClassDigit;
+		else if (c == ';' || c == ':')
+			classes[c] = kClassSeparator;
+		else if (c < 0x30 || (c >= 0x3c && c <= 0x3f))
+			classes[c] = kClassIntermediate;
+		else if (c == '[')
+			classes[c] = kClassOpenCSI;
+		else if (c == ']')
+			classes[c] = kClassOpenOSC;
+		else if (c >= 0x40 && c <= 0x7e)
+			classes[c] = kClassFinal;
+		else
+			classes[c] = kClassPrint;
+	}
+	return classes;
+}();
+
+
+#define T(action, state) { kAction##action, kState##state }
+
+static const Transition kTransitions[kStateCount][kClassCount] = {
+	// Print, Control, Escape, Bell, Digit, Separator, Intermediate, [, ], Final
+	{ // Ground
+		T(Print, Ground), T(Print, Ground), T(None, Escape), T(None, Ground),
+		T(Print, Ground), T(Print, Ground), T(Print, Ground), T(Print, Ground),
+		T(Print, Ground), T(Print, Ground)
+	},
+	{ // Escape
+		T(None, Ground), T(None, Escape), T(None, Escape), T(None, Ground),
+		T(None, Ground), T(None, Ground), T(None, Escape), T(Clear, CSI),
+		T(None, OSC), T(None, Ground)
+	},
+	{ // CSI
+		T(None, Ground), T(None, CSI), T(None, Escape), T(None, CSI),
+		T(Digit, CSI), T(NextParam, CSI), T(None, CSI), T(Dispatch, Ground),
+		T(Dispatch, Ground), T(Dispatch, Ground)
+	},
+	{ // OSC
+		T(None, OSC), T(None, OSC), T(None, OSCEscape), T(None, Ground),
+		T(None, OSC), T(None, OSC), T(None, OSC), T(None, OSC),
+		T(None, OSC), T(None, OSC)
+	},
+	{ // OSCEscape (ESC \ ends the OSC string)
+		T(None, Ground), T(None, Ground), T(None, Escape), T(None, Ground),
+		T(None, Ground), T(None, Ground), T(None, Ground), T(None, Ground),
+		T(None, Ground), T(None, Ground)
+	}
+};
+
+#undef T
+
+
+static const rgb_color kBasicColors[16] = {
+	{   0,   0,   0, 255 }, { 204,   0,   0, 255 }, {  78, 154,   6, 255 },
+	{ 196, 160,   0, 255 }, {  52, 101, 164, 255 }, { 117,  80, 123, 255 },
+	{   6, 152, 154, 255 }, { 211, 215, 207, 255 }, {  85,  87,  83, 255 },
+	{ 239,  41,  41, 255 }, { 138, 226,  52, 255 }, { 252, 233,  79, 255 },
+	{ 114, 159, 207, 255 }, { 173, 127, 168, 255 }, {  52, 226, 226, 255 },
+	{ 238, 238, 236, 255 }
+};
+
+
+static rgb_color
+_PaletteColor(int32 index)
+{
+	if (index < 16)
+		return kBasicColors[index];
+
+	rgb_color color = { 0, 0, 0, 255 };
+	if (index < 232) {
+		// 6x6x6 color cube
+		static const uint8 kLevels[6] = { 0, 95, 135, 175, 215, 255 };
+		index -= 16;
+		color.red = kLevels[index / 36];
+		color.green = kLevels[(index / 6) % 6];
+		color.blue = kLevels[index % 6];
+	} else {
+		// grayscale ramp
+		color.red = color.green = color.blue = 8 + (index - 232) * 10;
+	}
+	return color;
+}
+
+
+AnsiDecoder::AnsiDecoder()
+{
+	Reset();
+}
+
+
+void
+AnsiDecoder::Reset()
+{
+	fState = kStateGround;
+	fParamCount = 0;
+	fStyle.offset = 0;
+	fStyle.color = kBasicColors[0];
+	fStyle.face = B_REGULAR_FACE;
+	fStyle.defaultColor = true;
+}
+
+
+void
+AnsiDecoder::Decode(const BString& input, BString& text,
+	std::vector<console_style_run>& runs)
+{
+	text.Truncate(0);
+	runs.clear();
+	fStyle.offset = 0;
+	runs.push_back(fStyle);
+
+	const char* data = input.String();
+	const int32 length = input.Length();
+
+	// fast path: nothing to decode
+	if (fState == kStateGround && memchr(data, 0x1b, length) == nullptr) {
+		text = input;
+		return;
+	}
+
+	int32 spanStart = 0;
+	for (int32 i = 0; i < length; i++) {
+		const uint8 c = data[i];
+		const Transition& transition = kTransitions[fState][kCharClasses[c]];
+		if (fState == kStateGround && transition.action == kActionPrint)
+			continue;
+
+		// leaving the text: copy the printable span in one go
+		if (fState == kStateGround && i > spanStart)
+			text.Append(data + spanStart, i - spanStart);
+
+		switch (transition.action) {
+			case kActionClear:
+				fParamCount = 1;
+				fParams[0] = -1;
+				break;
+			case kActionDigit:
+			{
+				int32& param = fParams[fParamCount - 1];
+				param = (param < 0 ? 0 : param * 10) + (c - '0');
+				break;
+			}
+			case kActionNextParam:
+				if (fParamCount < kMaxParams)
+					fParams[fParamCount++] = -1;
+				break;
+			case kActionDispatch:
+				if (c == 'm') {
+					_ApplySGR();
+					_SetRun(text, runs);
+				}
+				break;
+			default:
+				break;
+		}
+
+		fState = transition.state;
+		spanStart = i + 1;
+	}
+
+	if (fState == kStateGround && length > spanStart)
+		text.Append(data + spanStart, length - spanStart);
+}
+
+
+int32
+AnsiDecoder::_Param(int32 index) const
+{
+	if (index >= fParamCount || fParams[index] < 0)
+		return 0;
+	return fParams[index];
+}
+
+
+void
+AnsiDecoder::_ApplySGR()
+{
+	for (int32 i = 0; i < fParamCount; i++) {
+		const int32 param = _Param(i);
+		switch (param) {
+			case 0:
+				fStyle.face = B_REGULAR_FACE;
+				fStyle.defaultColor = true;
+				break;
+			case 1:
+				fStyle.face = (fStyle.face & ~B_REGULAR_FACE) | B_BOLD_FACE;
+				break;
+			case 3:
+				fStyle.face = (fStyle.face & ~B_REGULAR_FACE) | B_ITALIC_FACE;
+				break;
+			case 4:
+				fStyle.face = (fStyle.face & ~B_REGULAR_FACE) | B_UNDERSCORE_FACE;
+				break;
+			case 22:
+				fStyle.face &= ~B_BOLD_FACE;
+				break;
+			case 23:
+				fStyle.face &= ~B_ITALIC_FACE;
+				break;
+			case 24:
+				fStyle.face &= ~B_UNDERSCORE_FACE;
+				break;
+			case 38:
+			case 48:
+			{
+				// extended colors: 5;index or 2;r;g;b
+				rgb_color color = { 0, 0, 0, 255 };
+				if (_Param(i + 1) == 5) {
+					color = _PaletteColor(_Param(i + 2) & 0xff);
+					i += 2;
+				} else if (_Param(i + 1) == 2) {
+					color.red = _Param(i + 2);
+					color.green = _Param(i + 3);
+					color.blue = _Param(i + 4);
+					i += 4;
+				}
+				// backgrounds can't be shown by the console text view
+				if (param == 38) {
+					fStyle.color = color;
+					fStyle.defaultColor = false;
+				}
+				break;
+			}
+			case 39:
+				fStyle.defaultColor = true;
+				break;
+			default:
+				if (param >= 30 && param <= 37) {
+					fStyle.color = kBasicColors[param - 30];
+					fStyle.defaultColor = false;
+				} else if (param >= 90 && param <= 97) {
+					fStyle.color = kBasicColors[param - 90 + 8];
+					fStyle.defaultColor = false;
+				}
+				break;
+		}
+	}
+
+	if (fStyle.face == 0)
+		fStyle.face = B_REGULAR_FACE;
+}
+
+
+void
+AnsiDecoder::_SetRun(BString& text, std::vector<console_style_run>& runs)
+{
+	fStyle.offset = text.Length();
+	console_style_run& last = runs.back();
+	if (last.offset == fStyle.offset) {
+		last = fStyle;
+		if (runs.size() > 1) {
+			// same style as the run before: nothing changed
+			const console_style_run& previous = runs[runs.size() - 2];
+			if (previous.face == last.face && previous.defaultColor == last.defaultColor
+				&& (last.defaultColor || previous.color == last.color))
+				runs.pop_back();
+		}
+		return;
+	}
+
+	if (last.face == fStyle.face && last.defaultColor == fStyle.defaultColor
+		&& (fStyle.defaultColor || last.color == fStyle.color))
+		return;
+
+	runs.push_back(fStyle);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef AnsiDecoder_H
+#define AnsiDecoder_H
+
+#include <GraphicsDefs.h>
+#include <String.h>
+
+#include <vector>
+
+/*
+ * A style change in a decoded line: from offset on, the text uses this
+ * color and font face. defaultColor means the console color of the stream.
+ */
+struct console_style_run {
+	int32		offset;
+	rgb_color	color;
+	uint16		face;
+	bool		defaultColor;
+};
+
+/*
+ * AnsiDecoder strips ANSI escape sequences from console output and turns
+ * the SGR ones (ESC [ ... m) into style runs. It is a table driven state
+ * machine; the state and the current style carry over from one line to
+ * the next. Lines without escapes are copied as a single run.
+ */
+class AnsiDecoder {
+public:
+					AnsiDecoder();
+
+			void	Decode(const BString& input, BString& text,
+						std::vector<console_style_run>& runs);
+			void	Reset();
+
+private:
+			void	_ApplySGR();
+			int32	_Param(int32 index) const;
+			void	_SetRun(BString& text, std::vector<console_style_run>& runs);
+
+	static	const int32	kMaxParams = 16;
+
+	uint8				fState;
+	int32				fParams[kMaxParams];
+	int32				fParamCount;
+	console_style_run	fStyle;
+};
+
+
+#endif // AnsiDecoder_H
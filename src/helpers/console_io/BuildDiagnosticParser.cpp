@@ -0,0 +1,174 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "BuildDiagnosticParser.h"
+
+#include <Entry.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+
+struct Severity {
+	const char*	prefix;
+	const char*	category;
+};
+
+static const Severity kSeverities[] = {
+	{ "fatal error:",	"error" },
+	{ "error:",			"error" },
+	{ "warning:",		"warning" },
+	{ "note:",			"note" }
+};
+
+
+BuildDiagnosticParser::BuildDiagnosticParser(const BString& directory)
+{
+	fDirectories.push_back(directory);
+}
+
+
+bool
+BuildDiagnosticParser::ParseLine(const BString& line, BMessage& diagnostic)
+{
+	if (line.IsEmpty())
+		return false;
+
+	diagnostic.MakeEmpty();
+
+	const char* text = line.String();
+	if (_TrackDirectory(text))
+		return false;
+
+	if (!_ParseCompilerLine(text, diagnostic) && !_ParseToolLine(text, diagnostic))
+		return false;
+
+	// the same header diagnostic is reported for every file including it
+	BString key;
+	key << diagnostic.GetString("file", "") << ":" << diagnostic.GetInt32("be:line", 0)
+		<< ":" << diagnostic.GetInt32("lsp:character", 0)
+		<< ":" << diagnostic.GetString("message", "");
+	return fReported.insert(key.String()).second;
+}
+
+
+bool
+BuildDiagnosticParser::_ParseCompilerLine(const char* line, BMessage& diagnostic)
+{
+	// file name: up to the first ':' followed by a line number
+	const char* colon = strchr(line, ':');
+	while (colon != nullptr && !isdigit(colon[1]))
+		colon = strchr(colon + 1, ':');
+	if (colon == nullptr || colon == line)
+		return false;
+
+	char* end = nullptr;
+	const int32 lineNumber = strtol(colon + 1, &end, 10);
+	if (*end != ':')
+		return false;
+
+	int32 column = 0;
+	const char* rest = end + 1;
+	if (isdigit(*rest)) {
+		column = strtol(rest, &end, 10);
+		if (*end != ':')
+			return false;
+		rest = end + 1;
+	}
+	while (*rest == ' ')
+		rest++;
+
+	const Severity* severity = nullptr;
+	for (const Severity& s : kSeverities) {
+		if (strncmp(rest, s.prefix, strlen(s.prefix)) == 0) {
+			severity = &s;
+			break;
+		}
+	}
+	if (severity == nullptr)
+		return false;
+
+	BString message(rest + strlen(severity->prefix));
+	message.Trim();
+
+	const BString path = _ResolvePath(BString(line, colon - line));
+	diagnostic.AddString("category", severity->category);
+	diagnostic.AddString("message", message);
+	diagnostic.AddString("source", path.String() + path.FindLast('/') + 1);
+	diagnostic.AddString("file", path);
+	diagnostic.AddInt32("be:line", lineNumber);
+	diagnostic.AddInt32("lsp:character", column > 0 ? column - 1 : 0);
+
+	entry_ref ref;
+	if (get_ref_for_path(path.String(), &ref) == B_OK && BEntry(&ref).Exists())
+		diagnostic.AddRef("refs", &ref);
+
+	return true;
+}
+
+
+bool
+BuildDiagnosticParser::_ParseToolLine(const char* line, BMessage& diagnostic)
+{
+	const char* source = nullptr;
+	if (strncmp(line, "...failed ", 10) == 0
+		|| strncmp(line, "don't know how to make ", 23) == 0) {
+		source = "jam";
+	} else if (strncmp(line, "make", 4) == 0 && strstr(line, ": *** ") != nullptr) {
+		source = "make";
+	} else {
+		return false;
+	}
+
+	BString message(line);
+	message.Trim();
+	diagnostic.AddString("category", "error");
+	diagnostic.AddString("message", message);
+	diagnostic.AddString("source", source);
+	return true;
+}
+
+
+bool
+BuildDiagnosticParser::_TrackDirectory(const char* line)
+{
+	// make[1]: Entering directory '/path'
+	if (strncmp(line, "make", 4) != 0)
+		return false;
+
+	const bool entering = strstr(line, ": Entering directory ") != nullptr;
+	const bool leaving = !entering && strstr(line, ": Leaving directory ") != nullptr;
+	if (!entering && !leaving)
+		return false;
+
+	if (leaving) {
+		if (fDirectories.size() > 1)
+			fDirectories.pop_back();
+		return true;
+	}
+
+	BString directory(strchr(line, '\'') != nullptr ? strchr(line, '\'') + 1 : "");
+	directory.RemoveAll("'");
+	directory.Trim();
+	if (!directory.IsEmpty())
+		fDirectories.push_back(directory);
+	return true;
+}
+
+
+BString
+BuildDiagnosticParser::_ResolvePath(const BString& path) const
+{
+	if (path.StartsWith("/") || fDirectories.back().IsEmpty())
+		return path;
+
+	BString fullPath(fDirectories.back());
+	if (!fullPath.EndsWith("/"))
+		fullPath << "/";
+	fullPath << path;
+	return fullPath;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef BuildDiagnosticParser_H
+#define BuildDiagnosticParser_H
+
+#include <Message.h>
+#include <String.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+/*
+ * BuildDiagnosticParser extracts compiler diagnostics from build output,
+ * one line at a time, as the lines are read from the build pipes.
+ * Recognized formats:
+ *   GCC / Clang:	file:line[:column]: (fatal error|error|warning|note): message
+ *   jam:			...failed <action> <target>... / don't know how to make <target>
+ *   make:			make[N]: *** ... / make[N]: Entering|Leaving directory '...'
+ * Each diagnostic is a message suitable for ProblemsPanel: "category",
+ * "message", "source" and, when the file exists, "refs", "be:line" and
+ * "lsp:character".
+ */
+class BuildDiagnosticParser {
+public:
+					BuildDiagnosticParser(const BString& directory);
+
+			bool	ParseLine(const BString& line, BMessage& diagnostic);
+
+private:
+			bool	_ParseCompilerLine(const char* line, BMessage& diagnostic);
+			bool	_ParseToolLine(const char* line, BMessage& diagnostic);
+			bool	_TrackDirectory(const char* line);
+			BString	_ResolvePath(const BString& path) const;
+
+	std::vector<BString>	fDirectories;
+	std::set<std::string>	fReported;
+};
+
+
+#endif // BuildDiagnosticParser_H
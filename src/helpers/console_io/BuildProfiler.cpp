@@ -0,0 +1,274 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "BuildProfiler.h"
+
+#include <OS.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+
+// how many of the slowest steps end up in the report
+static const int32 kMaxReportedSteps = 10;
+
+static const char* kCompilers[] = {
+	"gcc", "g++", "cc", "c++", "clang", "clang++"
+};
+
+static const char* kSourceExtensions[] = {
+	".c", ".cc", ".cpp", ".cxx", ".C", ".m", ".mm", ".S", ".s"
+};
+
+
+static const char*
+SkipSpaces(const char* text)
+{
+	while (*text != '\0' && isspace(*text))
+		text++;
+	return text;
+}
+
+
+static void
+SplitWords(const char* text, std::vector<BString>& words)
+{
+	words.clear();
+	text = SkipSpaces(text);
+	while (*text != '\0') {
+		const char* start = text;
+		while (*text != '\0' && !isspace(*text))
+			text++;
+		words.push_back(BString(start, text - start));
+		text = SkipSpaces(text);
+	}
+}
+
+
+static BString
+BaseName(const BString& path)
+{
+	BString name(path);
+	name.RemoveAll("\"").RemoveAll("'");
+	const int32 slash = name.FindLast('/');
+	if (slash >= 0)
+		name.Remove(0, slash + 1);
+	return name;
+}
+
+
+static bool
+HasSuffix(const BString& text, const char* suffix)
+{
+	const int32 length = strlen(suffix);
+	return text.Length() >= length
+		&& strcmp(text.String() + text.Length() - length, suffix) == 0;
+}
+
+
+BuildProfiler::BuildProfiler(bigtime_t start)
+	:
+	fStart(start),
+	fStepOpen(false)
+{
+}
+
+
+void
+BuildProfiler::ParseLine(const BString& line, bigtime_t when)
+{
+	BString name;
+	int32 kind;
+	if (line.IsEmpty() || !_ParseStep(line.String(), name, kind))
+		return;
+
+	// the previous step ends where this one starts
+	_CloseStep(when);
+
+	build_step step;
+	step.name = name;
+	step.kind = kind;
+	step.start = when;
+	step.duration = 0;
+	fSteps.push_back(step);
+	fStepOpen = true;
+}
+
+
+void
+BuildProfiler::Finish(bigtime_t when, BMessage& report)
+{
+	_CloseStep(when);
+
+	bigtime_t compileTime = 0;
+	bigtime_t linkTime = 0;
+	int32 compileCount = 0;
+	int32 linkCount = 0;
+	for (const build_step& step : fSteps) {
+		if (step.kind == kCompileStep) {
+			compileTime += step.duration;
+			compileCount++;
+		} else {
+			linkTime += step.duration;
+			linkCount++;
+		}
+	}
+
+	report.AddInt64("date", real_time_clock());
+	report.AddInt64("duration", when - fStart);
+	report.AddInt64("compile_time", compileTime);
+	report.AddInt64("link_time", linkTime);
+	report.AddInt32("compile_count", compileCount);
+	report.AddInt32("link_count", linkCount);
+
+	std::vector<build_step> slowest(fSteps);
+	std::sort(slowest.begin(), slowest.end(),
+		[](const build_step& a, const build_step& b) {
+			return a.duration > b.duration;
+		});
+	if ((int32)slowest.size() > kMaxReportedSteps)
+		slowest.resize(kMaxReportedSteps);
+
+	for (const build_step& step : slowest) {
+		BMessage stepMessage;
+		stepMessage.AddString("name", step.name);
+		stepMessage.AddString("kind", KindName(step.kind));
+		stepMessage.AddInt64("duration", step.duration);
+		report.AddMessage("step", &stepMessage);
+	}
+}
+
+
+/* static */
+const char*
+BuildProfiler::KindName(int32 kind)
+{
+	return kind == kLinkStep ? "link" : "compile";
+}
+
+
+bool
+BuildProfiler::_ParseStep(const char* line, BString& name, int32& kind) const
+{
+	line = SkipSpaces(line);
+
+	// CMake "[ 42%] ..." and ninja "[3/10] ..." progress lines
+	if (*line == '[') {
+		const char* close = strchr(line, ']');
+		if (close == nullptr)
+			return false;
+		line = SkipSpaces(close + 1);
+
+		if (strncmp(line, "Building ", 9) == 0 || strncmp(line, "Compiling ", 10) == 0) {
+			const char* object = strstr(line, " object ");
+			if (object == nullptr)
+				return false;
+			name = BaseName(SkipSpaces(object + 8));
+			name.Trim();
+			kind = kCompileStep;
+			return !name.IsEmpty();
+		}
+		if (strncmp(line, "Linking ", 8) == 0) {
+			std::vector<BString> words;
+			SplitWords(line, words);
+			name = BaseName(words.back());
+			kind = kLinkStep;
+			return words.size() > 1;
+		}
+		return false;
+	}
+
+	// jam prints the action name followed by its target
+	struct jam_action {
+		const char*	action;
+		int32		kind;
+	};
+	static const jam_action kJamActions[] = {
+		{ "C++ ",		kCompileStep },
+		{ "Cc ",		kCompileStep },
+		{ "Link ",		kLinkStep },
+		{ "Archive ",	kLinkStep }
+	};
+	for (const jam_action& action : kJamActions) {
+		const size_t length = strlen(action.action);
+		if (strncmp(line, action.action, length) != 0)
+			continue;
+		std::vector<BString> words;
+		SplitWords(line + length, words);
+		if (words.size() != 1)
+			return false;
+		name = BaseName(words[0]);
+		kind = action.kind;
+		return true;
+	}
+
+	return _ParseCommand(line, name, kind);
+}
+
+
+// Echoed compiler invocations (make, makefile-engine, custom scripts):
+// "-c" marks a compile step named after its source file, anything else
+// producing an "-o" output is a link step.
+bool
+BuildProfiler::_ParseCommand(const char* line, BString& name, int32& kind) const
+{
+	const char* end = line;
+	while (*end != '\0' && !isspace(*end))
+		end++;
+	const BString program = BaseName(BString(line, end - line));
+
+	bool isCompiler = HasSuffix(program, "-gcc") || HasSuffix(program, "-g++");
+	for (const char* compiler : kCompilers) {
+		if (program == compiler)
+			isCompiler = true;
+	}
+	if (!isCompiler)
+		return false;
+
+	std::vector<BString> words;
+	SplitWords(end, words);
+
+	bool compile = false;
+	BString source;
+	BString output;
+	for (size_t i = 0; i < words.size(); i++) {
+		if (words[i] == "-c") {
+			compile = true;
+		} else if (words[i] == "-o" && i + 1 < words.size()) {
+			output = words[++i];
+		} else if (words[i][0] != '-') {
+			for (const char* extension : kSourceExtensions) {
+				if (HasSuffix(words[i], extension))
+					source = words[i];
+			}
+		}
+	}
+
+	if (compile && !source.IsEmpty()) {
+		name = BaseName(source);
+		kind = kCompileStep;
+		return true;
+	}
+	if (!compile && !output.IsEmpty()) {
+		name = BaseName(output);
+		kind = kLinkStep;
+		return true;
+	}
+	return false;
+}
+
+
+void
+BuildProfiler::_CloseStep(bigtime_t when)
+{
+	if (!fStepOpen)
+		return;
+
+	build_step& step = fSteps.back();
+	step.duration = when - step.start;
+	fStepOpen = false;
+}
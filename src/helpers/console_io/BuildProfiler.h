@@ -0,0 +1,60 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef BuildProfiler_H
+#define BuildProfiler_H
+
+#include <Message.h>
+#include <String.h>
+
+#include <vector>
+
+/*
+ * BuildProfiler times the steps of a build from its output.
+ * Every line is timestamped as it is read; lines announcing a compile or a
+ * link step are recognized and correlated with the file they produce:
+ *   command echo:	gcc|g++|cc|c++|clang[++] ... -c file.cpp / ... -o target
+ *   jam:			C++ <object> / Cc <object> / Link <target> / Archive <target>
+ *   CMake, ninja:	[..] Building|Compiling ... object <object> / [..] Linking ... <target>
+ * A step lasts until the next step is announced (or the build ends), so with
+ * parallel jobs the durations are an approximation of where time goes.
+ * Finish() fills a report: "duration", "date", "compile_time", "link_time",
+ * "compile_count", "link_count" and the slowest "step" messages ("name",
+ * "kind", "duration"), slowest first.
+ */
+class BuildProfiler {
+public:
+	enum step_kind {
+		kCompileStep,
+		kLinkStep
+	};
+
+								BuildProfiler(bigtime_t start);
+
+			void				ParseLine(const BString& line, bigtime_t when);
+			void				Finish(bigtime_t when, BMessage& report);
+
+	static	const char*			KindName(int32 kind);
+
+private:
+	struct build_step {
+		BString		name;
+		int32		kind;
+		bigtime_t	start;
+		bigtime_t	duration;
+	};
+
+			bool				_ParseStep(const char* line, BString& name,
+									int32& kind) const;
+			bool				_ParseCommand(const char* line, BString& name,
+									int32& kind) const;
+			void				_CloseStep(bigtime_t when);
+
+			bigtime_t			fStart;
+			std::vector<build_step>	fSteps;
+			bool				fStepOpen;
+};
+
+
+#endif // BuildProfiler_H
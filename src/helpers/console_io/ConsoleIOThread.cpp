@@ -12,26 +12,46 @@
 #include "ConsoleIOThread.h"
 
 #include <Autolock.h>
+#include <Catalog.h>
 #include <Debug.h>
 #include <Messenger.h>
 
 #include <errno.h>
 #include <image.h>
+#include <poll.h>
 #include <signal.h>
+#include <sys/wait.h>
 #include <termios.h>
 #include <unistd.h>
 
+#include "BuildDiagnosticParser.h"
+#include "BuildProfiler.h"
+#include "BuildScheduler.h"
 #include "Log.h"
 #include "PipeImage.h"
 
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "ConsoleIOThread"
+
+// How long poll() waits before checking if the process is still alive.
+// Only matters when a detached child keeps the pipes open.
+static const int kPollTimeout = 500; // milliseconds
+
 ConsoleIOThread::ConsoleIOThread(BMessage* cmd_message, const BMessenger& consoleTarget)
 	:
 	GenericThread("ConsoleIOThread", B_NORMAL_PRIORITY, cmd_message),
 	fTarget(consoleTarget),
 	fExternalProcessId(-1),
-	fConsoleOutput(nullptr),
-	fConsoleError(nullptr),
-	fIsDone(false)
+	fConsoleOutput(-1),
+	fConsoleError(-1),
+	fOutputBatch(CONSOLEIOTHREAD_STDOUT),
+	fErrorBatch(CONSOLEIOTHREAD_STDERR),
+	fDiagnosticsBatch(CONSOLEIOTHREAD_DIAGNOSTICS),
+	fDiagnosticParser(nullptr),
+	fBuildProfiler(nullptr),
+	fIsDone(false),
+	fExitStatus(-1),
+	fInterrupted(false)
 {
 	SetDataStore(new BMessage(*cmd_message));
 }
@@ -40,6 +60,8 @@ ConsoleIOThread::ConsoleIOThread(BMessage* cmd_message, const BMessenger& consol
 ConsoleIOThread::~ConsoleIOThread()
 {
 	ClosePipes();
+	delete fDiagnosticParser;
+	delete fBuildProfiler;
 }
 
 
@@ -57,6 +79,14 @@ ConsoleIOThread::_RunExternalProcess()
 	GetDataStore()->FindString("cmd_type", &type);
 	fCmdType = type;
 
+	// the working directory is set for the child only
+	BString cwd = GetDataStore()->GetString("cwd", "");
+
+	if (GetDataStore()->GetBool("parse_diagnostics", false))
+		fDiagnosticParser = new BuildDiagnosticParser(cwd);
+	if (GetDataStore()->GetBool("profile_build", false))
+		fBuildProfiler = new BuildProfiler(system_time());
+
 	int32 argc = 3;
 	const char** argv = new const char * [argc + 1];
 
@@ -65,7 +95,7 @@ ConsoleIOThread::_RunExternalProcess()
 	argv[2] = strdup(cmd.String());
 	argv[argc] = nullptr;
 
-	status = fPipeImage.Init(argv, argc, true, false);
+	status = fPipeImage.Init(argv, true, cwd.String());
 
 	delete[] argv;
 
@@ -77,13 +107,6 @@ ConsoleIOThread::_RunExternalProcess()
 	// lower the command priority since it is a background task.
 	set_thread_priority(fExternalProcessId, B_LOW_PRIORITY);
 
-	status = resume_thread(fExternalProcessId);
-	if (status != B_OK) {
-		kill_thread(fExternalProcessId);
-		fExternalProcessId = -1;
-		return status;
-	}
-
 	int flags = fcntl(fPipeImage.GetStdOutFD(), F_GETFL, 0);
 	flags |= O_NONBLOCK;
 	fcntl(fPipeImage.GetStdOutFD(), F_SETFL, flags);
@@ -91,34 +114,42 @@ ConsoleIOThread::_RunExternalProcess()
 	flags |= O_NONBLOCK;
 	fcntl(fPipeImage.GetStdErrFD(), F_SETFL, flags);
 
-	// avoid having some buffered stuff in the output
-	// of the new process. It looks like when forking we are
-	// inheriting output buffers of the main process.
-	_CleanPipes();
-
-	fConsoleOutput = fdopen(fPipeImage.GetStdOutFD(), "r");
-	if (fConsoleOutput == nullptr) {
-		LogErrorF("Can't open ConsoleOutput file! (%d) [%s]", errno, strerror(errno));
-		kill_thread(fExternalProcessId);
-		fExternalProcessId = -1;
-		return errno;
-	}
-	fConsoleError = fdopen(fPipeImage.GetStdErrFD(), "r");
-	if (fConsoleError == nullptr) {
-		LogErrorF("Can't open ConsoleError file! (%d) [%s]", errno, strerror(errno));
-		kill_thread(fExternalProcessId);
-		fExternalProcessId = -1;
-		return errno;
-	}
+	fConsoleOutput = fPipeImage.GetStdOutFD();
+	fConsoleError = fPipeImage.GetStdErrFD();
 
 	return B_OK;
 }
 
 
+// A build with "build_jobs" (the project setting) gets its parallel jobs
+// here, off the window thread: the idle cores are measured first
+void
+ConsoleIOThread::_ScheduleBuildJobs()
+{
+	int32 setting;
+	if (GetDataStore()->FindInt32("build_jobs", &setting) != B_OK)
+		return;
+
+	const BString command = GetDataStore()->GetString("cmd", "");
+	const int32 jobs = BuildScheduler::Jobs(setting);
+	const BString scheduled = BuildScheduler::ApplyJobs(command, jobs);
+	if (scheduled == command)
+		return;
+	GetDataStore()->ReplaceString("cmd", scheduled);
+
+	BString line;
+	line.SetToFormat(B_TRANSLATE("%d jobs"), (int)jobs);
+	BMessage message(CONSOLEIOTHREAD_STDOUT);
+	message.AddString("stdout", BString(" *** ") << line << "\n");
+	fTarget.SendMessage(&message);
+}
+
+
 /* virtual */
 status_t
 ConsoleIOThread::ThreadStartup(void)
 {
+	_ScheduleBuildJobs();
 	return _RunExternalProcess();
 }
 
@@ -129,69 +160,160 @@ ConsoleIOThread::ExecuteUnit()
 	if (fExternalProcessId < 0)
 		return B_NO_INIT;
 
-	// read output and error from command
-	// send it to window
-	BString outStr("");
-	BString errStr("");
-	status_t status = GetFromPipe(outStr, errStr);
-	if (status == B_OK) {
-		fLastOutputString += outStr;
-		fLastErrorString  += errStr;
-
-		if (!fLastOutputString.IsEmpty()) {
-			if (fLastOutputString.EndsWith("\n")) {
-				OnStdOutputLine(fLastOutputString);
-				fLastOutputString = "";
-			}
-		}
-
-		if (!fLastErrorString.IsEmpty()) {
-			if (fLastErrorString.EndsWith("\n")) {
-				OnStdErrorLine(fLastErrorString);
-				fLastErrorString = "";
-			}
-		}
+	// block until one of the pipes has data (or is closed)
+	struct pollfd fds[2];
+	fds[0].fd = fConsoleOutput;
+	fds[0].events = POLLIN;
+	fds[1].fd = fConsoleError;
+	fds[1].events = POLLIN;
+	fds[0].revents = fds[1].revents = 0;
+
+	int ready = poll(fds, 2, kPollTimeout);
+	if (ready < 0) {
+		if (errno == EINTR)
+			return B_OK;
+		LogErrorF("poll() failed! (%d) [%s]", errno, strerror(errno));
+		return errno;
+	}
 
-		if (!IsProcessAlive() && outStr.IsEmpty() && errStr.IsEmpty()) {
+	if (ready == 0) {
+		if (!IsProcessAlive()) {
+			int waitStatus;
+			if (waitpid(fExternalProcessId, &waitStatus, WNOHANG) > 0 && WIFEXITED(waitStatus))
+				fExitStatus = WEXITSTATUS(waitStatus);
+			if (!fLastOutputString.IsEmpty())
+				_DispatchLine(fLastOutputString, false);
+			if (!fLastErrorString.IsEmpty())
+				_DispatchLine(fLastErrorString, true);
+			_FlushOutput();
 			LogTrace("ExecuteUnit() done!");
 			return EOF;
 		}
+		return B_OK;
+	}
+
+	// read output and error from command
+	// send it to window
+	if (fds[0].revents != 0 && ReadFromPipe(fConsoleOutput, fLastOutputString, false) == EOF)
+		fConsoleOutput = -1;
+	if (fds[1].revents != 0 && ReadFromPipe(fConsoleError, fLastErrorString, true) == EOF)
+		fConsoleError = -1;
+
+	_FlushOutput();
+
+	if (fConsoleOutput < 0 && fConsoleError < 0) {
+		// both pipes are closed, the process is exiting
+		status_t exitValue;
+		if (wait_for_thread(fExternalProcessId, &exitValue) == B_OK)
+			fExitStatus = exitValue;
+		LogTrace("ExecuteUnit() done!");
+		return EOF;
 	}
 
-	// streams are non blocking, sleep every 1ms
-	snooze(1000);
-	return status;
+	return B_OK;
 }
 
 
+// The style runs of the line being dispatched travel with the text,
+// so the view can apply them without decoding anything.
 void
 ConsoleIOThread::OnStdOutputLine(const BString& stdOut)
 {
-	BMessage outMessage(CONSOLEIOTHREAD_STDOUT);
-	outMessage.AddString("stdout", stdOut);
-	fTarget.SendMessage(&outMessage);
+	fOutputBatch.AddString("stdout", stdOut);
+	fOutputBatch.AddData("stdout_runs", B_RAW_TYPE, fLineRuns.data(),
+		fLineRuns.size() * sizeof(console_style_run), false);
 }
 
 
 void
 ConsoleIOThread::OnStdErrorLine(const BString& stdErr)
 {
-	BMessage errMessage(CONSOLEIOTHREAD_STDERR);
-	errMessage.AddString("stderr", stdErr);
-	fTarget.SendMessage(&errMessage);
+	fErrorBatch.AddString("stderr", stdErr);
+	fErrorBatch.AddData("stderr_runs", B_RAW_TYPE, fLineRuns.data(),
+		fLineRuns.size() * sizeof(console_style_run), false);
 }
 
 
+// Reads one chunk from the pipe and passes every complete line to the
+// OnStd*Line hooks. The trailing partial line is kept in pending.
 status_t
-ConsoleIOThread::GetFromPipe(BString& stdOut, BString& stdErr)
+ConsoleIOThread::ReadFromPipe(int fd, BString& pending, bool isStdErr)
 {
-	if (fConsoleOutput) {
-		stdOut = fgets(fConsoleOutputBuffer, LINE_MAX, fConsoleOutput);
+	ssize_t size = read(fd, fConsoleOutputBuffer, sizeof(fConsoleOutputBuffer));
+	if (size < 0)
+		return (errno == EAGAIN || errno == EINTR) ? B_OK : EOF;
+
+	if (size == 0) {
+		// the other end is closed: deliver the unterminated last line
+		if (!pending.IsEmpty()) {
+			_DispatchLine(pending, isStdErr);
+			pending = "";
+		}
+		return EOF;
+	}
+
+	const char* start = fConsoleOutputBuffer;
+	const char* end = fConsoleOutputBuffer + size;
+	while (start < end) {
+		const char* newLine = (const char*)memchr(start, '\n', end - start);
+		if (newLine == nullptr) {
+			pending.Append(start, end - start);
+			break;
+		}
+		const int32 length = newLine - start + 1;
+		if (pending.IsEmpty()) {
+			BString line(start, length);
+			_DispatchLine(line, isStdErr);
+		} else {
+			pending.Append(start, length);
+			_DispatchLine(pending, isStdErr);
+			pending = "";
+		}
+		start = newLine + 1;
 	}
-	if (fConsoleError) {
-		stdErr = fgets(fConsoleOutputBuffer, LINE_MAX, fConsoleError);
+	return B_OK;
+}
+
+
+void
+ConsoleIOThread::_DispatchLine(const BString& line, bool isStdErr)
+{
+	// ANSI escapes and compiler diagnostics are decoded here,
+	// on the reader thread
+	AnsiDecoder& decoder = isStdErr ? fErrorDecoder : fOutputDecoder;
+	decoder.Decode(line, fLineText, fLineRuns);
+
+	if (fDiagnosticParser != nullptr) {
+		BMessage diagnostic;
+		if (fDiagnosticParser->ParseLine(fLineText, diagnostic))
+			fDiagnosticsBatch.AddMessage("diagnostic", &diagnostic);
+	}
+	if (fBuildProfiler != nullptr)
+		fBuildProfiler->ParseLine(fLineText, system_time());
+
+	if (isStdErr)
+		OnStdErrorLine(fLineText);
+	else
+		OnStdOutputLine(fLineText);
+}
+
+
+// Sends the lines collected during one wakeup as a single message per stream
+void
+ConsoleIOThread::_FlushOutput()
+{
+	if (fDiagnosticsBatch.HasMessage("diagnostic")) {
+		fTarget.SendMessage(&fDiagnosticsBatch);
+		fDiagnosticsBatch.MakeEmpty();
+	}
+	if (fOutputBatch.HasString("stdout")) {
+		fTarget.SendMessage(&fOutputBatch);
+		fOutputBatch.MakeEmpty();
+	}
+	if (fErrorBatch.HasString("stderr")) {
+		fTarget.SendMessage(&fErrorBatch);
+		fErrorBatch.MakeEmpty();
 	}
-	return (::feof(fConsoleOutput) && ::feof(fConsoleError)) ? EOF : B_OK;
 }
 
 
@@ -216,6 +338,15 @@ ConsoleIOThread::ThreadShutdown()
 {
 	ClosePipes();
 	fIsDone = true;
+
+	if (fBuildProfiler != nullptr) {
+		BMessage report(CONSOLEIOTHREAD_BUILD_PROFILE);
+		fBuildProfiler->Finish(system_time(), report);
+		report.AddBool("succeeded", fExitStatus == 0 && !fInterrupted);
+		report.AddString("project_path", GetDataStore()->GetString("project_path", ""));
+		fTarget.SendMessage(&report);
+	}
+
 	ThreadExitNotification();
 
 	// the job is done, let's wait to be killed..
@@ -231,12 +362,7 @@ ConsoleIOThread::ThreadShutdown()
 void
 ConsoleIOThread::ClosePipes()
 {
-	if (fConsoleOutput)
-		::fclose(fConsoleOutput);
-	if (fConsoleError)
-		::fclose(fConsoleError);
-
-	fConsoleOutput = fConsoleError = nullptr;
+	fConsoleOutput = fConsoleError = -1;
 
 	fPipeImage.Close();
 }
@@ -263,6 +389,7 @@ ConsoleIOThread::InterruptExternal()
 {
 	BAutolock lock(fProcessIDLock);
 	if (IsProcessAlive()) {
+		fInterrupted = true;
 		status_t status = send_signal(-fExternalProcessId, SIGTERM);
 		status = wait_for_thread_etc(fExternalProcessId, B_RELATIVE_TIMEOUT, 2000000, nullptr); //2 seconds
 		if (status != B_OK) {
@@ -278,15 +405,3 @@ ConsoleIOThread::InterruptExternal()
 	return B_ERROR;
 }
 
-
-void
-ConsoleIOThread::_CleanPipes()
-{
-	// pipes are set to non-blocking so we should never be stuck here.
-	while (read(fPipeImage.GetStdOutFD(), fConsoleOutputBuffer, LINE_MAX) > 0) {
-		// loop
-	}
-	while (read(fPipeImage.GetStdErrFD(), fConsoleOutputBuffer, LINE_MAX) > 0) {
-		// loop
-	}
-}
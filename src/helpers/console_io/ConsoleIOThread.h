@@ -13,6 +13,15 @@
  * program input/output, etc.).
  * It gets the command (via message) from main window, executes it in pipes
  * and sends the streams to the visual class, ConsoleIOView (via messages).
+ * The pipes are waited on with poll() and read in large chunks; the lines
+ * found during one wakeup are sent together in a single message.
+ * For builds, compiler diagnostics are parsed from the lines on this thread
+ * and sent in batches too (CONSOLEIOTHREAD_DIAGNOSTICS).
+ * When profiling is requested, compile and link steps are timed from the
+ * lines and a breakdown is sent at the end (CONSOLEIOTHREAD_BUILD_PROFILE),
+ * with "succeeded" false if the command failed or was interrupted.
+ * ANSI escapes are stripped from every line and their colors are sent
+ * along as compact style runs ("stdout_runs"/"stderr_runs").
  * Some logic is also sent, like enabling and disabling Stop button, and start,
  * end, error banners.
  * When the thread is over, or in case of error, a message is sent to the main
@@ -32,16 +41,23 @@
 #include <Messenger.h>
 #include <String.h>
 
-#include <cstdio>
+#include <atomic>
+#include <vector>
 
+#include "AnsiDecoder.h"
 #include "PipeImage.h"
 
 enum {
 	CONSOLEIOTHREAD_EXIT				= 'Cexi',
 	CONSOLEIOTHREAD_STDOUT				= 'Csou',
-	CONSOLEIOTHREAD_STDERR				= 'Cser'
+	CONSOLEIOTHREAD_STDERR				= 'Cser',
+	CONSOLEIOTHREAD_DIAGNOSTICS			= 'Cdia',
+	CONSOLEIOTHREAD_BUILD_PROFILE		= 'Cbpr'
 };
 
+class BuildDiagnosticParser;
+class BuildProfiler;
+
 class ConsoleIOThread : public GenericThread {
 public:
 								ConsoleIOThread(BMessage* cmd_message,
@@ -62,25 +78,38 @@ protected:
 private:
 			void				PushInput(BString text);
 			bool				IsProcessAlive() const;
-			status_t			GetFromPipe(BString& stdOut, BString& stdErr);
+			status_t			ReadFromPipe(int fd, BString& pending, bool isStdErr);
 			void				ClosePipes();
 	virtual	status_t			ThreadStartup() override;
 	virtual	status_t			ExecuteUnit() override;
 	virtual	status_t			ThreadShutdown() override;
 
-			void				_CleanPipes();
+			void				_ScheduleBuildJobs();
 			status_t			_RunExternalProcess();
+			void				_DispatchLine(const BString& line, bool isStdErr);
+			void				_FlushOutput();
 
 	virtual status_t			Kill(void);
 
 			thread_id			fExternalProcessId;
-			FILE*				fConsoleOutput;
-			FILE*				fConsoleError;
-			char				fConsoleOutputBuffer[LINE_MAX];
+			int					fConsoleOutput;
+			int					fConsoleError;
+			char				fConsoleOutputBuffer[64 * 1024];
+			BMessage			fOutputBatch;
+			BMessage			fErrorBatch;
+			BMessage			fDiagnosticsBatch;
+			BuildDiagnosticParser*	fDiagnosticParser;
+			BuildProfiler*		fBuildProfiler;
+			AnsiDecoder			fOutputDecoder;
+			AnsiDecoder			fErrorDecoder;
+			BString				fLineText;
+			std::vector<console_style_run>	fLineRuns;
 			BString 			fCmdType;
 			bool				fIsDone;
 			BString				fLastOutputString;
 			BString				fLastErrorString;
 			BLocker				fProcessIDLock;
 			PipeImage			fPipeImage;
+			int32				fExitStatus;	// -1 until known
+			std::atomic<bool>	fInterrupted;
 };
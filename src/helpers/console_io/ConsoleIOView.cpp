@@ -15,9 +15,11 @@
 #include <Catalog.h>
 #include <CheckBox.h>
 #include <LayoutBuilder.h>
+#include <MessageRunner.h>
 #include <ScrollView.h>
 #include <String.h>
 
+#include "AnsiDecoder.h"
 #include "ConfigManager.h"
 #include "ConsoleIOThread.h"
 #include "GenioApp.h"
@@ -31,34 +33,60 @@ enum {
 	MSG_CLEAR_OUTPUT	= 'clou',
 	MSG_POST_OUTPUT		= 'poou',
 	MSG_STOP_PROCESS	= 'stpr',
-	MSG_RUN_PROCESS		= 'runp'
+	MSG_RUN_PROCESS		= 'runp',
+	MSG_CLOSE_SESSION	= 'clse'
 };
 
+// pending output is appended to the text view at most once per frame
+static const bigtime_t kOutputFrameInterval = 1000000 / 60;
+
 struct ConsoleIOView::OutputInfo {
 	int32 	fd;
 	BString	text;
+	std::vector<console_style_run> runs;
 
-	OutputInfo(int32 fd, const BString& text)
+	OutputInfo(int32 fd, const BString& text, const console_style_run* styleRuns,
+			int32 runCount)
 		:
 		fd(fd),
 		text(text)
 	{
+		if (styleRuns != nullptr && runCount > 0) {
+			runs.assign(styleRuns, styleRuns + runCount);
+		} else {
+			console_style_run run = { 0, {}, B_REGULAR_FACE, true };
+			runs.push_back(run);
+		}
 	}
 };
 
 
-ConsoleIOView::ConsoleIOView(const BString& name, const BMessenger& target)
+static bool
+SameStyle(const console_style_run& a, const console_style_run& b)
+{
+	return a.face == b.face && a.defaultColor == b.defaultColor
+		&& (a.defaultColor || a.color == b.color);
+}
+
+
+ConsoleIOView::ConsoleIOView(const BString& name, const BMessenger& target,
+	bool closable)
 	:
 	BGroupView(B_VERTICAL, 0.0f)
 	, fWindowTarget(target)
 	, fConsoleIOText(nullptr)
+	, fCloseButton(nullptr)
 	, fPendingOutput(nullptr)
+	, fOutputPosted(false)
+	, fLastOutputFlush(0)
+	, fMaxLines(50000)
+	, fRunPending(false)
 	, fConsoleIOThread(nullptr)
 {
 	SetName(name);
 
 	try {
-		_Init();
+		_Init(closable);
 	} catch (...) {
 		throw;
 	}
@@ -77,7 +105,19 @@ status_t
 ConsoleIOView::RunCommand(BMessage* cmd_message)
 {
 	cmd_message->what = MSG_RUN_PROCESS;
-	return BMessenger(this).SendMessage(cmd_message);
+	status_t status = BMessenger(this).SendMessage(cmd_message);
+	if (status == B_OK)
+		fRunPending = true;
+	return status;
+}
+
+
+// A view runs one command at a time: a busy view means a new session
+// (another ConsoleIOView) is needed to run a command concurrently.
+bool
+ConsoleIOView::IsRunning() const
+{
+	return fRunPending || (fConsoleIOThread != nullptr && !fConsoleIOThread->IsDone());
 }
 
 
@@ -125,42 +165,52 @@ void
 ConsoleIOView::MessageReceived(BMessage* message)
 {
 	switch (message->what) {
-		case CONSOLEIOTHREAD_STDERR: {
-			BString string;
-			if (message->FindString("stderr",  &string) == B_OK)
-				ConsoleOutputReceived(2, string);
-			break;
-		}
+		case CONSOLEIOTHREAD_STDERR:
 		case CONSOLEIOTHREAD_STDOUT: {
+			// lines come in batches, one message per reader wakeup,
+			// each with the style runs decoded from its ANSI escapes
+			const bool isStdErr = message->what == CONSOLEIOTHREAD_STDERR;
+			const char* textField = isStdErr ? "stderr" : "stdout";
+			const char* runsField = isStdErr ? "stderr_runs" : "stdout_runs";
 			BString string;
-			if (message->FindString("stdout",  &string) == B_OK)
-				ConsoleOutputReceived(1, string);
+			for (int32 i = 0; message->FindString(textField, i, &string) == B_OK; i++) {
+				const void* runs = nullptr;
+				ssize_t size = 0;
+				if (message->FindData(runsField, B_RAW_TYPE, i, &runs, &size) != B_OK)
+					size = 0;
+				ConsoleOutputReceived(isStdErr ? 2 : 1, string,
+					(const console_style_run*)runs, size / sizeof(console_style_run));
+			}
 			break;
 		}
+		case CONSOLEIOTHREAD_DIAGNOSTICS:
+		case CONSOLEIOTHREAD_BUILD_PROFILE:
+			// already parsed by the reader thread, the window routes them
+			fWindowTarget.SendMessage(message);
+			break;
 		case MSG_CLEAR_OUTPUT:
 		{
 			fConsoleIOText->SetText("");
 			fPendingOutput->MakeEmpty();
+			fLastOutputFlush = 0;
 
 			// Used to reload settings too
 			fWrapEnabled->SetValue(gCFG["wrap_console"] ? B_CONTROL_ON : B_CONTROL_OFF);
 			fConsoleIOText->SetWordWrap(fWrapEnabled->Value());
 			fBannerEnabled->SetValue(gCFG["console_banner"]);
+			fMaxLines = gCFG["console_max_lines"];
 
 			break;
 		}
 		case MSG_POST_OUTPUT:
 		{
-			OutputInfo* info = fPendingOutput->RemoveItemAt(0);
-			if (info == nullptr)
-				break;
-
-			ObjectDeleter<OutputInfo> infoDeleter(info);
-			_HandleConsoleOutput(info);
+			fOutputPosted = false;
+			_FlushPendingOutput();
 			break;
 		}
 		case MSG_RUN_PROCESS:
 		{
+			fRunPending = false;
 			if (fConsoleIOThread != nullptr && !fConsoleIOThread->IsDone()) {
 				// TODO: Horrible hack to be able to stop and relaunch build.
 				// should be done differently
@@ -198,6 +248,15 @@ ConsoleIOView::MessageReceived(BMessage* message)
 			_StopCommand();
 			break;
 		}
+		case MSG_CLOSE_SESSION:
+		{
+			// the window still hears about the end of the command
+			_StopCommand();
+			BMessage close(MSG_CONSOLE_SESSION_CLOSE);
+			close.AddPointer("view", this);
+			fWindowTarget.SendMessage(&close);
+			break;
+		}
 		default:
 			BGroupView::MessageReceived(message);
 			break;
@@ -236,10 +295,13 @@ ConsoleIOView::AttachedToWindow()
 	fWrapEnabled->SetValue(gCFG["wrap_console"]);
 	fConsoleIOText->SetWordWrap(fWrapEnabled->Value());
 	fBannerEnabled->SetValue(gCFG["console_banner"]);
+	fMaxLines = gCFG["console_max_lines"];
 
 	fClearButton->SetTarget(this);
 	fStopButton->SetTarget(this);
 	fStopButton->SetEnabled(false);
+	if (fCloseButton != nullptr)
+		fCloseButton->SetTarget(this);
 }
 
 
@@ -251,14 +313,15 @@ ConsoleIOView::Clear()
 
 
 void
-ConsoleIOView::ConsoleOutputReceived(int32 fd, const BString& output)
+ConsoleIOView::ConsoleOutputReceived(int32 fd, const BString& output,
+	const console_style_run* runs, int32 runCount)
 {
 	if (fd == 1 && fStdoutEnabled->Value() != B_CONTROL_ON)
 		return;
 	else if (fd == 2 && fStderrEnabled->Value() != B_CONTROL_ON)
 		return;
 
-	OutputInfo* info = new(std::nothrow) OutputInfo(fd, output);
+	OutputInfo* info = new(std::nothrow) OutputInfo(fd, output, runs, runCount);
 	if (info == nullptr)
 		return;
 
@@ -267,7 +330,22 @@ ConsoleIOView::ConsoleOutputReceived(int32 fd, const BString& output)
 		infoDeleter.Detach();
 	}
 
-	BMessenger(this).SendMessage(MSG_POST_OUTPUT);
+	// lines beyond the limit would be trimmed right after being inserted
+	while (fPendingOutput->CountItems() > fMaxLines)
+		delete fPendingOutput->RemoveItemAt(0);
+
+	// coalesce: a single MSG_POST_OUTPUT is in flight at any time, and it
+	// is delayed so the text view is updated at most once per frame
+	if (fOutputPosted)
+		return;
+	fOutputPosted = true;
+
+	BMessage postMessage(MSG_POST_OUTPUT);
+	bigtime_t delay = fLastOutputFlush + kOutputFrameInterval - system_time();
+	if (delay <= 0)
+		BMessenger(this).SendMessage(&postMessage);
+	else
+		BMessageRunner::StartSending(BMessenger(this), &postMessage, delay, 1);
 }
 
 
@@ -279,7 +357,7 @@ ConsoleIOView::EnableStopButton(bool doIt)
 
 
 void
-ConsoleIOView::_Init()
+ConsoleIOView::_Init(bool closable)
 {
 	fPendingOutput = new OutputInfoList(1, true);
 
@@ -299,9 +377,11 @@ ConsoleIOView::_Init()
 	fClearButton = new BButton(B_TRANSLATE("Clear"), new BMessage(MSG_CLEAR_OUTPUT));
 	fStopButton = new BButton(B_TRANSLATE("Stop"), new BMessage(MSG_STOP_PROCESS));
 
+	BGroupLayout* buttons;
 	BLayoutBuilder::Group<>(this, B_HORIZONTAL, 0.0f)
 		.Add(consoleScrollView, 3.0f)
 		.AddGroup(B_VERTICAL, 0.0f)
+			.GetLayout(&buttons)
 			.SetInsets(B_USE_SMALL_SPACING)
 			.Add(fStdoutEnabled)
 			.Add(fStderrEnabled)
@@ -313,28 +393,79 @@ ConsoleIOView::_Init()
 		.End()
 	.End();
 
+	if (closable) {
+		fCloseButton = new BButton(B_TRANSLATE("Close"), new BMessage(MSG_CLOSE_SESSION));
+		buttons->AddView(fCloseButton);
+	}
+
 }
 
 
 void
-ConsoleIOView::_HandleConsoleOutput(OutputInfo* info)
+ConsoleIOView::_FlushPendingOutput()
 {
-	if (info->fd == 1 && fStdoutEnabled->Value() != B_CONTROL_ON)
-		return;
-	else if (info->fd == 2 && fStderrEnabled->Value() != B_CONTROL_ON)
+	fLastOutputFlush = system_time();
+
+	const int32 count = fPendingOutput->CountItems();
+	if (count == 0)
 		return;
 
-	text_run_array run;
-	run.count = 1;
-	run.runs[0].font = be_fixed_font;
-	run.runs[0].offset = 0;
-	// stderr goes orange
-	if (info->fd == 2) {
-		run.runs[0].color = ui_color(B_FAILURE_COLOR);
-	} else {
-		run.runs[0].color = ui_color(B_LIST_ITEM_TEXT_COLOR);
+	// Merge all the pending lines in one text with one run per style change,
+	// so the whole batch is a single Insert() and a single redraw.
+	// Plain output has one run per stream change, like before.
+	int32 runCount = 0;
+	int32 lastFd = -1;
+	const console_style_run* lastRun = nullptr;
+	for (int32 i = 0; i < count; i++) {
+		OutputInfo* info = fPendingOutput->ItemAt(i);
+		if (info->fd == 1 && fStdoutEnabled->Value() != B_CONTROL_ON)
+			continue;
+		else if (info->fd == 2 && fStderrEnabled->Value() != B_CONTROL_ON)
+			continue;
+		for (const console_style_run& styleRun : info->runs) {
+			if (info->fd != lastFd || !SameStyle(styleRun, *lastRun))
+				runCount++;
+			lastFd = info->fd;
+			lastRun = &styleRun;
+		}
 	}
-	run.runs[0].color.alpha = 255;
+
+	BString text;
+	text_run_array* runs = runCount > 0 ? BTextView::AllocRunArray(runCount) : nullptr;
+	int32 run = -1;
+	lastFd = -1;
+	lastRun = nullptr;
+	for (int32 i = 0; i < count && runs != nullptr; i++) {
+		OutputInfo* info = fPendingOutput->ItemAt(i);
+		if (info->fd == 1 && fStdoutEnabled->Value() != B_CONTROL_ON)
+			continue;
+		else if (info->fd == 2 && fStderrEnabled->Value() != B_CONTROL_ON)
+			continue;
+		for (const console_style_run& styleRun : info->runs) {
+			if (info->fd == lastFd && SameStyle(styleRun, *lastRun))
+				continue;
+			lastFd = info->fd;
+			lastRun = &styleRun;
+			run++;
+			runs->runs[run].font = be_fixed_font;
+			runs->runs[run].font.SetFace(styleRun.face);
+			runs->runs[run].offset = text.Length() + styleRun.offset;
+			if (!styleRun.defaultColor) {
+				runs->runs[run].color = styleRun.color;
+			} else if (info->fd == 2) {
+				// stderr goes orange
+				runs->runs[run].color = ui_color(B_FAILURE_COLOR);
+			} else {
+				runs->runs[run].color = ui_color(B_LIST_ITEM_TEXT_COLOR);
+			}
+			runs->runs[run].color.alpha = 255;
+		}
+		text.Append(info->text);
+	}
+	fPendingOutput->MakeEmpty();
+
+	if (runs == nullptr)
+		return;
 
 	bool autoScroll = false;
 	BScrollBar* scroller = fConsoleIOText->ScrollBar(B_VERTICAL);
@@ -343,8 +474,11 @@ ConsoleIOView::_HandleConsoleOutput(OutputInfo* info)
 	if (min == max || scroller->Value() == max)
 		autoScroll = true;
 
-	fConsoleIOText->Insert(fConsoleIOText->TextLength(), info->text,
-		info->text.Length(), &run);
+	fConsoleIOText->Insert(fConsoleIOText->TextLength(), text, text.Length(), runs);
+	BTextView::FreeRunArray(runs);
+
+	_TrimToLineLimit();
+
 	if (autoScroll) {
 		scroller->GetRange(&min, &max);
 		fConsoleIOText->ScrollTo(0.0, max);
@@ -352,6 +486,24 @@ ConsoleIOView::_HandleConsoleOutput(OutputInfo* info)
 }
 
 
+// The text view works as a ring buffer: once the line limit is exceeded
+// the oldest lines are dropped. BTextView only draws the visible lines, so
+// the cost of an update is bounded by the limit, not by the whole output.
+void
+ConsoleIOView::_TrimToLineLimit()
+{
+	const int32 excess = fConsoleIOText->CountLines() - fMaxLines;
+	if (excess <= 0)
+		return;
+
+	// keep the visible text still when the user scrolled back
+	const float removedHeight = fConsoleIOText->TextHeight(0, excess - 1);
+	fConsoleIOText->Delete(0, fConsoleIOText->OffsetAt(excess));
+	const float top = fConsoleIOText->Bounds().top - removedHeight;
+	fConsoleIOText->ScrollTo(0.0, top > 0.0 ? top : 0.0);
+}
+
+
 BTextView*
 ConsoleIOView::TextView()
 {
@@ -13,6 +13,10 @@
 #include <Messenger.h>
 #include <ObjectList.h>
 
+// asks the target to remove a closable session, with the "view" pointer
+const uint32 MSG_CONSOLE_SESSION_CLOSE = 'Ccls';
+
+struct console_style_run;
 class BButton;
 class BCheckBox;
 class BTextView;
@@ -20,7 +24,8 @@ class ConsoleIOThread;
 class WordTextView;
 class ConsoleIOView : public BGroupView {
 public:
-								ConsoleIOView(const BString& name, const BMessenger& target);
+								ConsoleIOView(const BString& name, const BMessenger& target,
+									bool closable = false);
 								~ConsoleIOView();
 
 	virtual	void				MessageReceived(BMessage* message);
@@ -28,20 +33,24 @@ public:
 
 			void				Clear();
 			void				ConsoleOutputReceived(
-									int32 fd, const BString& output);
+									int32 fd, const BString& output,
+									const console_style_run* runs = nullptr,
+									int32 runCount = 0);
 			void				EnableStopButton(bool doIt);
 
 			BTextView*			TextView();
 
 			status_t			RunCommand(BMessage* cmd_message);
+			bool				IsRunning() const;
 
 private:
 			struct OutputInfo;
 			typedef BObjectList<OutputInfo> OutputInfoList;
 
 private:
-			void				_Init();
-			void				_HandleConsoleOutput(OutputInfo* info);
+			void				_Init(bool closable);
+			void				_FlushPendingOutput();
+			void				_TrimToLineLimit();
 			void				_BannerMessage(BString status);
 			void				Pulse();
 			void				_StopThreads();
@@ -57,9 +66,14 @@ private:
 			WordTextView*		fConsoleIOText;
 			BButton*			fClearButton;
 			BButton*			fStopButton;
+			BButton*			fCloseButton;
 			BString				fCmdType;
 			BString				fBannerClaim;
 			OutputInfoList*		fPendingOutput;
+			bool				fOutputPosted;
+			bigtime_t			fLastOutputFlush;
+			int32				fMaxLines;
+			bool				fRunPending;
 			ConsoleIOThread*	fConsoleIOThread;
 };
 
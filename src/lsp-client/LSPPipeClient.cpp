@@ -12,10 +12,15 @@
 #include "LSPReaderThread.h"
 #include <Messenger.h>
 
+#include <vector>
+
 status_t
-LSPPipeClient::Start(const char **argv, int32 argc)
+LSPPipeClient::Start(const char **argv, int32 argc, const char* workingDirectory)
 {
-	status_t image_status = fPipeImage.Init(argv, argc, false, true);
+	// the server configurations don't end their arguments with a nullptr
+	std::vector<const char*> arguments(argv, argv + argc);
+	arguments.push_back(nullptr);
+	status_t image_status = fPipeImage.Init(arguments.data(), false, workingDirectory);
 	if (image_status == B_OK)
 		LSPPipeClient::Run();
 	return image_status;
@@ -103,11 +103,11 @@ LSPProjectWrapper::_Create()
 	looper->AddHandler(this);
 	BMessenger thisProject = BMessenger(this, looper);
 
-	chdir(Name());
-
 	fLSPPipeClient = new LSPPipeClient(kLSPMessage, thisProject);
 
-	status_t started = fLSPPipeClient->Start((const char**)fServerConfig.Argv(), fServerConfig.Argc());
+	// the server runs in the project folder (the handler name)
+	status_t started = fLSPPipeClient->Start((const char**)fServerConfig.Argv(),
+		fServerConfig.Argc(), Name());
 
 	if ( started != B_OK) {
 		// TODO: show an alert to the user. (but only once per session!)
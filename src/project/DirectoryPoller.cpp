@@ -0,0 +1,333 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "DirectoryPoller.h"
+
+#include <Autolock.h>
+#include <Directory.h>
+#include <NodeMonitor.h>
+#include <Path.h>
+
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "Log.h"
+
+
+// a pass starts at most this often...
+static const bigtime_t kMinPollInterval = 2000000; // 2 s
+// ...and the poller sleeps at least this many times the last pass duration
+static const int32 kIdleFactor = 20;
+
+
+static BString
+ChildPath(const BString& parent, const BString& name)
+{
+	BString path(parent);
+	path << "/" << name;
+	return path;
+}
+
+
+DirectoryPoller::DirectoryPoller()
+	:
+	fLocker("DirectoryPoller"),
+	fListener(nullptr),
+	fQuitSem(create_sem(0, "directory poller quit")),
+	fThread(-1)
+{
+	fThread = spawn_thread(&DirectoryPoller::_PollThread, "directory poller",
+		B_LOW_PRIORITY, this);
+	if (fThread >= 0)
+		resume_thread(fThread);
+	else
+		LogError("DirectoryPoller: can't start the poller thread");
+}
+
+
+DirectoryPoller::~DirectoryPoller()
+{
+	delete_sem(fQuitSem);
+	if (fThread >= 0) {
+		status_t exitValue;
+		wait_for_thread(fThread, &exitValue);
+	}
+}
+
+
+void
+DirectoryPoller::SetTarget(const BMessenger& target)
+{
+	BAutolock lock(fLocker);
+	fTarget = target;
+}
+
+
+void
+DirectoryPoller::SetListener(Listener* listener)
+{
+	BAutolock lock(fLocker);
+	fListener = listener;
+}
+
+
+void
+DirectoryPoller::SetIgnoreList(const IgnoreList& ignoreList)
+{
+	BAutolock lock(fLocker);
+	fIgnoreLists[ignoreList.Root().String()] = ignoreList;
+}
+
+
+void
+DirectoryPoller::RemoveIgnoreList(const BString& root)
+{
+	BAutolock lock(fLocker);
+	fIgnoreLists.erase(root.String());
+}
+
+
+// Takes the first snapshot right away: changes made after Add()
+// returns are reported.
+void
+DirectoryPoller::Add(const node_ref& node, const BString& root)
+{
+	directory_state state;
+	state.root = root;
+	if (_ReadDirectory(node, state.modified, &state.entries) != B_OK)
+		return;
+
+	BAutolock lock(fLocker);
+	fDirectories[node] = state;
+}
+
+
+void
+DirectoryPoller::Remove(const node_ref& node)
+{
+	BAutolock lock(fLocker);
+	fDirectories.erase(node);
+}
+
+
+// Stops polling the folders of a project, those found by the poller too
+void
+DirectoryPoller::RemoveRoot(const BString& root)
+{
+	BAutolock lock(fLocker);
+	for (auto it = fDirectories.begin(); it != fDirectories.end();) {
+		if (it->second.root == root)
+			it = fDirectories.erase(it);
+		else
+			it++;
+	}
+}
+
+
+int32
+DirectoryPoller::CountDirectories(const BString& root)
+{
+	BAutolock lock(fLocker);
+	int32 count = 0;
+	for (const auto& directory : fDirectories) {
+		if (directory.second.root == root)
+			count++;
+	}
+	return count;
+}
+
+
+/* static */
+status_t
+DirectoryPoller::_PollThread(void* self)
+{
+	static_cast<DirectoryPoller*>(self)->_PollLoop();
+	return B_OK;
+}
+
+
+void
+DirectoryPoller::_PollLoop()
+{
+	bigtime_t interval = kMinPollInterval;
+	while (acquire_sem_etc(fQuitSem, 1, B_RELATIVE_TIMEOUT, interval) == B_TIMED_OUT) {
+		const bigtime_t start = system_time();
+
+		std::vector<node_ref> nodes;
+		{
+			BAutolock lock(fLocker);
+			for (const auto& directory : fDirectories)
+				nodes.push_back(directory.first);
+		}
+		for (const node_ref& node : nodes) {
+			if (_Quitting())
+				return;
+			_Poll(node);
+		}
+
+		interval = std::max(kMinPollInterval, (system_time() - start) * kIdleFactor);
+	}
+}
+
+
+void
+DirectoryPoller::_Poll(const node_ref& node)
+{
+	bigtime_t modified;
+	if (_ReadDirectory(node, modified, nullptr) != B_OK) {
+		// removed: the parent folder reports it
+		BAutolock lock(fLocker);
+		fDirectories.erase(node);
+		return;
+	}
+
+	directory_state state;
+	{
+		BAutolock lock(fLocker);
+		auto it = fDirectories.find(node);
+		if (it == fDirectories.end() || it->second.modified == modified)
+			return;
+		state = it->second;
+	}
+
+	std::vector<poll_entry> entries;
+	BPath path;
+	BEntry entry;
+	BDirectory directory(&node);
+	if (_ReadDirectory(node, modified, &entries) != B_OK
+		|| directory.GetEntry(&entry) != B_OK || entry.GetPath(&path) != B_OK) {
+		return;
+	}
+	const BString parentPath(path.Path());
+
+	// both lists are sorted by node: the same node under another name
+	// has been renamed
+	auto oldEntry = state.entries.begin();
+	auto newEntry = entries.begin();
+	while (oldEntry != state.entries.end() || newEntry != entries.end()) {
+		if (newEntry == entries.end()
+			|| (oldEntry != state.entries.end() && oldEntry->node < newEntry->node)) {
+			_Notify(B_ENTRY_REMOVED, state.root, ChildPath(parentPath, oldEntry->name), "");
+			// it may be a folder the poller found, or a live one promoted since
+			const node_ref removed(node.device, oldEntry->node);
+			Listener* listener;
+			{
+				BAutolock lock(fLocker);
+				listener = fListener;
+				fDirectories.erase(removed);
+			}
+			if (listener != nullptr)
+				listener->DirectoryRemoved(removed);
+			oldEntry++;
+		} else if (oldEntry == state.entries.end() || newEntry->node < oldEntry->node) {
+			const BString newPath = ChildPath(parentPath, newEntry->name);
+			_Notify(B_ENTRY_CREATED, state.root, newPath, "");
+			if (BEntry(newPath).IsDirectory() && !_IsIgnored(state.root, newPath))
+				_AddCreated(node, node_ref(node.device, newEntry->node), state.root);
+			newEntry++;
+		} else {
+			if (oldEntry->name != newEntry->name) {
+				_Notify(B_ENTRY_MOVED, state.root, ChildPath(parentPath, newEntry->name),
+					ChildPath(parentPath, oldEntry->name));
+			}
+			oldEntry++;
+			newEntry++;
+		}
+	}
+
+	BAutolock lock(fLocker);
+	auto it = fDirectories.find(node);
+	if (it != fDirectories.end()) {
+		it->second.modified = modified;
+		it->second.entries = entries;
+	}
+}
+
+
+// The listener adds the folder, so that it knows it; without one, the
+// poller does
+void
+DirectoryPoller::_AddCreated(const node_ref& parent, const node_ref& node, const BString& root)
+{
+	Listener* listener;
+	{
+		BAutolock lock(fLocker);
+		listener = fListener;
+	}
+	if (listener != nullptr)
+		listener->DirectoryCreated(parent, node);
+	else
+		Add(node, root);
+}
+
+
+// The modification time of the folder, and its entries when asked
+/* static */
+status_t
+DirectoryPoller::_ReadDirectory(const node_ref& node, bigtime_t& modified,
+	std::vector<poll_entry>* entries)
+{
+	BDirectory directory(&node);
+	struct stat st;
+	status_t status = directory.InitCheck();
+	if (status != B_OK || (status = directory.GetStat(&st)) != B_OK)
+		return status;
+	modified = (bigtime_t)st.st_mtim.tv_sec * 1000000 + st.st_mtim.tv_nsec / 1000;
+
+	if (entries == nullptr)
+		return B_OK;
+
+	char buffer[sizeof(dirent) + B_FILE_NAME_LENGTH];
+	dirent* dent = reinterpret_cast<dirent*>(buffer);
+	while (directory.GetNextDirents(dent, sizeof(buffer), 1) > 0) {
+		if (strcmp(dent->d_name, ".") == 0 || strcmp(dent->d_name, "..") == 0)
+			continue;
+		entries->push_back({ dent->d_ino, dent->d_name });
+	}
+	std::sort(entries->begin(), entries->end(),
+		[](const poll_entry& a, const poll_entry& b) {
+			return a.node < b.node;
+		});
+	return B_OK;
+}
+
+
+bool
+DirectoryPoller::_Quitting() const
+{
+	const status_t status = acquire_sem_etc(fQuitSem, 1, B_RELATIVE_TIMEOUT, 0);
+	return status != B_WOULD_BLOCK && status != B_TIMED_OUT;
+}
+
+
+void
+DirectoryPoller::_Notify(int32 opcode, const BString& root, const BString& path,
+	const BString& fromPath)
+{
+	BMessage message(B_PATH_MONITOR);
+	message.AddInt32("opcode", opcode);
+	message.AddString("path", path);
+	if (opcode == B_ENTRY_MOVED)
+		message.AddString("from path", fromPath);
+	message.AddString("watched_path", root);
+
+	BMessenger target;
+	{
+		BAutolock lock(fLocker);
+		target = fTarget;
+	}
+	target.SendMessage(&message);
+}
+
+
+bool
+DirectoryPoller::_IsIgnored(const BString& root, const BString& path)
+{
+	BAutolock lock(fLocker);
+	auto it = fIgnoreLists.find(root.String());
+	return it != fIgnoreLists.end() && it->second.IsIgnored(path, true);
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef DirectoryPoller_H
+#define DirectoryPoller_H
+
+
+#include <Locker.h>
+#include <Messenger.h>
+#include <Node.h>
+#include <String.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "IgnoreList.h"
+
+/*
+ * DirectoryPoller watches the folders GenioWatchingFilter has no node
+ * monitor for. A low priority thread compares each folder modification
+ * time with a snapshot (node and name of every entry) and, when it moved,
+ * reads the folder again and sends the differences to the target as
+ * B_PATH_MONITOR messages, like BPathMonitor would: "opcode"
+ * (B_ENTRY_CREATED, B_ENTRY_REMOVED, B_ENTRY_MOVED), "path", "from path"
+ * and "watched_path". Folders created inside a polled folder are polled too,
+ * and the listener, if any, is told about them and about those removed.
+ * The interval between passes grows with the time a pass takes.
+ */
+class DirectoryPoller {
+public:
+	class Listener {
+	public:
+		virtual					~Listener() {}
+		// called by the poller thread, without the poller lock held
+		virtual	void			DirectoryCreated(const node_ref& parent,
+									const node_ref& node) = 0;
+		virtual	void			DirectoryRemoved(const node_ref& node) = 0;
+	};
+
+								DirectoryPoller();
+								~DirectoryPoller();
+
+			void				SetTarget(const BMessenger& target);
+			void				SetListener(Listener* listener);
+			void				SetIgnoreList(const IgnoreList& ignoreList);
+			void				RemoveIgnoreList(const BString& root);
+
+			void				Add(const node_ref& node, const BString& root);
+			void				Remove(const node_ref& node);
+			void				RemoveRoot(const BString& root);
+
+			int32				CountDirectories(const BString& root);
+
+private:
+	struct poll_entry {
+		ino_t		node;
+		BString		name;
+	};
+
+	struct directory_state {
+		BString					root;
+		bigtime_t				modified;
+		std::vector<poll_entry>	entries;	// sorted by node
+	};
+
+	static	status_t			_PollThread(void* self);
+			void				_PollLoop();
+			void				_Poll(const node_ref& node);
+			void				_AddCreated(const node_ref& parent, const node_ref& node,
+									const BString& root);
+	static	status_t			_ReadDirectory(const node_ref& node, bigtime_t& modified,
+									std::vector<poll_entry>* entries);
+			bool				_Quitting() const;
+			void				_Notify(int32 opcode, const BString& root,
+									const BString& path, const BString& fromPath);
+			bool				_IsIgnored(const BString& root, const BString& path);
+
+			BLocker				fLocker;
+			BMessenger			fTarget;
+			Listener*			fListener;
+			std::map<node_ref, directory_state>	fDirectories;
+			std::map<std::string, IgnoreList>	fIgnoreLists;
+			sem_id				fQuitSem;
+			thread_id			fThread;
+};
+
+
+#endif // DirectoryPoller_H
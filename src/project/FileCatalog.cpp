@@ -0,0 +1,723 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "FileCatalog.h"
+
+#include <Autolock.h>
+#include <Directory.h>
+#include <OS.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <sys/stat.h>
+
+#include "Log.h"
+#include "ProjectFolder.h"
+
+
+// files read by the crawler are added in batches of this size
+static const size_t kCrawlBatch = 512;
+// below this, a query is not worth another thread
+static const uint32 kEntriesPerJob = 16384;
+// removed entries are dropped when they are this many, and a quarter
+static const int32 kCompactThreshold = 4096;
+static const size_t kMaxRecent = 32;
+
+static const int32 kMatchScore = 16;
+static const int32 kConsecutiveBonus = 12;
+static const int32 kBoundaryBonus = 10;
+static const int32 kCamelCaseBonus = 8;
+static const int32 kNameBonus = 4;
+static const int32 kGapPenalty = 1;
+// for the most recent file, then less by kRecentStep for each one after it
+static const int32 kRecentBonus = 96;
+static const int32 kRecentStep = 3;
+
+
+static inline char
+Lower(char c)
+{
+	return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+
+// Paths missing a character of the query can't match it
+static inline uint64
+CharBit(char c)
+{
+	c = Lower(c);
+	if (c >= 'a' && c <= 'z')
+		return 1ULL << (c - 'a');
+	if (c >= '0' && c <= '9')
+		return 1ULL << (26 + c - '0');
+	switch (c) {
+		case '.':
+			return 1ULL << 36;
+		case '_':
+			return 1ULL << 37;
+		case '-':
+			return 1ULL << 38;
+		case '/':
+			return 1ULL << 39;
+		default:
+			return 0;
+	}
+}
+
+
+static inline bool
+IsSeparator(char c)
+{
+	return c == '/' || c == '_' || c == '-' || c == '.' || c == ' ';
+}
+
+
+// The first c (in lower case) in [from, end), in either case, or nullptr.
+// Done with memchr(), which is much faster than a loop on long paths.
+static inline const char*
+FindChar(const char* from, const char* end, char c)
+{
+	const char* lower = (const char*)memchr(from, c, end - from);
+	if (c < 'a' || c > 'z')
+		return lower;
+	const char* upper = (const char*)memchr(from, c - ('a' - 'A'),
+		(lower != nullptr ? lower : end) - from);
+	return upper != nullptr ? upper : lower;
+}
+
+
+// The shortest part of text, after from, which ends where the query is
+// first matched entirely
+static bool
+FindWindow(const char* text, int32 from, int32 length, const char* query,
+	int32 queryLength, int32& start, int32& end)
+{
+	const char* textEnd = text + length;
+	const char* position = text + from;
+	for (int32 q = 0; q < queryLength; q++) {
+		position = FindChar(position, textEnd, query[q]);
+		if (position == nullptr)
+			return false;
+		position++;
+	}
+	end = position - text;
+
+	int32 q = queryLength - 1;
+	int32 i = end - 1;
+	for (; i >= from; i--) {
+		if (Lower(text[i]) == query[q] && q-- == 0)
+			break;
+	}
+	start = i;
+	return true;
+}
+
+
+FileCatalog::FileCatalog()
+	:
+	fLocker("FileCatalog"),
+	fRemovedCount(0),
+	fGeneration(0),
+	fJobSem(create_sem(0, "file catalog jobs")),
+	fCrawlThread(-1),
+	fQuit(false),
+	fCPUCount(1)
+{
+	system_info info;
+	if (get_system_info(&info) == B_OK)
+		fCPUCount = std::max((int32)info.cpu_count, (int32)1);
+}
+
+
+FileCatalog::~FileCatalog()
+{
+	fQuit = true;
+	delete_sem(fJobSem);
+	if (fCrawlThread >= 0) {
+		status_t exitValue;
+		wait_for_thread(fCrawlThread, &exitValue);
+	}
+}
+
+
+void
+FileCatalog::AddProject(ProjectFolder* project)
+{
+	BAutolock lock(fLocker);
+	if (fProjects.size() >= UINT16_MAX) {
+		LogError("FileCatalog: too many projects opened");
+		return;
+	}
+	fProjects.push_back({ project, project->Path(), project->Name(),
+		project->GetIgnoreList(), true });
+	_QueueCrawl(fProjects.size() - 1, "");
+}
+
+
+void
+FileCatalog::RemoveProject(ProjectFolder* project)
+{
+	BAutolock lock(fLocker);
+	for (uint16 p = 0; p < fProjects.size(); p++) {
+		if (!fProjects[p].open || fProjects[p].folder != project)
+			continue;
+		fProjects[p].open = false;
+		fProjects[p].folder = nullptr;
+
+		for (auto it = fJobs.begin(); it != fJobs.end();) {
+			if (it->project == p)
+				it = fJobs.erase(it);
+			else
+				it++;
+		}
+		for (catalog_entry& entry : fEntries) {
+			if (entry.project != p || entry.length == 0)
+				continue;
+			fIndex.erase(_Hash(p, fNames.data() + entry.offset, entry.length));
+			entry.length = 0;
+			fRemovedCount++;
+		}
+	}
+	fGeneration++;
+	_Compact();
+}
+
+
+void
+FileCatalog::PathCreated(const BString& path)
+{
+	struct stat st;
+	if (BEntry(path).GetStat(&st) != B_OK)
+		return;
+	const bool isFolder = S_ISDIR(st.st_mode);
+
+	BAutolock lock(fLocker);
+	BString relativePath;
+	const int32 project = _ProjectFor(path, relativePath);
+	if (project < 0 || relativePath.IsEmpty()
+		|| fProjects[project].ignoreList.IsIgnored(path, isFolder)) {
+		return;
+	}
+
+	// moved in from outside of the project, or made by an archiver
+	if (isFolder)
+		_QueueCrawl(project, relativePath);
+	else if (_Add(project, relativePath))
+		fGeneration++;
+}
+
+
+// Removed entries can't tell if they were a file or a folder: only a
+// path not found as a file is looked for as a folder.
+void
+FileCatalog::PathRemoved(const BString& path)
+{
+	BAutolock lock(fLocker);
+	BString relativePath;
+	const int32 project = _ProjectFor(path, relativePath);
+	if (project < 0 || relativePath.IsEmpty())
+		return;
+
+	if (!_Remove(project, relativePath))
+		_RemoveFolder(project, relativePath, nullptr);
+	fGeneration++;
+	_Compact();
+}
+
+
+void
+FileCatalog::PathMoved(const BString& fromPath, const BString& path)
+{
+	struct stat st;
+	if (BEntry(path).GetStat(&st) != B_OK)
+		return;
+	const bool isFolder = S_ISDIR(st.st_mode);
+
+	BAutolock lock(fLocker);
+	BString fromRelativePath;
+	const int32 fromProject = _ProjectFor(fromPath, fromRelativePath);
+	BString relativePath;
+	const int32 project = _ProjectFor(path, relativePath);
+	const bool ignored = project < 0 || relativePath.IsEmpty()
+		|| fProjects[project].ignoreList.IsIgnored(path, isFolder);
+	const bool known = fromProject >= 0 && !fromRelativePath.IsEmpty();
+
+	if (!isFolder) {
+		if (known)
+			_Remove(fromProject, fromRelativePath);
+		if (!ignored)
+			_Add(project, relativePath);
+	} else {
+		std::vector<BString> files;
+		if (known)
+			_RemoveFolder(fromProject, fromRelativePath, ignored ? nullptr : &files);
+		if (!ignored) {
+			// an empty list may just mean the folder was not read yet
+			if (files.empty())
+				_QueueCrawl(project, relativePath);
+			for (const BString& file : files) {
+				BString movedPath(relativePath);
+				movedPath << (file.String() + fromRelativePath.Length());
+				BString absolutePath(fProjects[project].root);
+				absolutePath << "/" << movedPath;
+				if (!fProjects[project].ignoreList.IsIgnored(absolutePath, false))
+					_Add(project, movedPath);
+			}
+		}
+	}
+	fGeneration++;
+	_Compact();
+}
+
+
+void
+FileCatalog::FileOpened(const BString& path)
+{
+	BAutolock lock(fLocker);
+	auto it = std::find(fRecent.begin(), fRecent.end(), path);
+	if (it != fRecent.end())
+		fRecent.erase(it);
+	fRecent.insert(fRecent.begin(), path);
+	if (fRecent.size() > kMaxRecent)
+		fRecent.pop_back();
+}
+
+
+int32
+FileCatalog::CountFiles()
+{
+	BAutolock lock(fLocker);
+	return fEntries.size() - fRemovedCount;
+}
+
+
+// An empty query gives the recently opened files
+void
+FileCatalog::Find(const BString& query, int32 maxCount, std::vector<catalog_match>& matches)
+{
+	matches.clear();
+
+	BString lowered;
+	uint64 queryMask = 0;
+	for (int32 i = 0; i < query.Length(); i++) {
+		if (query[i] == ' ')
+			continue;
+		lowered << Lower(query[i]);
+		queryMask |= CharBit(query[i]);
+	}
+
+	BAutolock lock(fLocker);
+
+	std::vector<scored_entry> boosts;
+	for (size_t r = 0; r < fRecent.size(); r++) {
+		BString relativePath;
+		const int32 project = _ProjectFor(fRecent[r], relativePath);
+		if (project < 0)
+			continue;
+		auto it = fIndex.find(_Hash(project, relativePath, relativePath.Length()));
+		if (it != fIndex.end())
+			boosts.push_back({ it->second, kRecentBonus - (int32)r * kRecentStep });
+	}
+
+	std::vector<scored_entry> results;
+	if (lowered.IsEmpty()) {
+		results = boosts;
+	} else {
+		std::sort(boosts.begin(), boosts.end(),
+			[](const scored_entry& a, const scored_entry& b) { return a.index < b.index; });
+
+		const uint32 count = fEntries.size();
+		const int32 jobCount = std::clamp((int32)(count / kEntriesPerJob), (int32)1, fCPUCount);
+		std::vector<find_job> jobs(jobCount);
+		for (int32 j = 0; j < jobCount; j++) {
+			find_job& job = jobs[j];
+			job.catalog = this;
+			job.query = lowered.String();
+			job.queryLength = lowered.Length();
+			job.queryMask = queryMask;
+			job.start = (uint64)count * j / jobCount;
+			job.end = (uint64)count * (j + 1) / jobCount;
+			job.maxCount = maxCount;
+			job.boosts = &boosts;
+		}
+
+		std::vector<thread_id> threads;
+		for (int32 j = 1; j < jobCount; j++) {
+			const thread_id thread = spawn_thread(&FileCatalog::_FindThread,
+				"file catalog find", B_NORMAL_PRIORITY, &jobs[j]);
+			if (thread < 0 || resume_thread(thread) != B_OK)
+				_FindRange(jobs[j]);
+			else
+				threads.push_back(thread);
+		}
+		_FindRange(jobs[0]);
+		for (thread_id thread : threads) {
+			status_t exitValue;
+			wait_for_thread(thread, &exitValue);
+		}
+
+		for (const find_job& job : jobs)
+			results.insert(results.end(), job.results.begin(), job.results.end());
+	}
+
+	// shorter paths first among equal scores
+	std::sort(results.begin(), results.end(),
+		[this](const scored_entry& a, const scored_entry& b) {
+			if (a.score != b.score)
+				return a.score > b.score;
+			return fEntries[a.index].length < fEntries[b.index].length;
+		});
+	if (results.size() > (size_t)maxCount)
+		results.resize(maxCount);
+
+	for (const scored_entry& result : results) {
+		const catalog_entry& entry = fEntries[result.index];
+		const catalog_project& project = fProjects[entry.project];
+		catalog_match match;
+		match.relativePath.SetTo(_PathAt(result.index), entry.length);
+		match.path << project.root << "/" << match.relativePath;
+		match.project = project.name;
+		match.score = result.score;
+		matches.push_back(match);
+	}
+}
+
+
+int32
+FileCatalog::_ProjectFor(const BString& path, BString& relativePath) const
+{
+	for (size_t p = 0; p < fProjects.size(); p++) {
+		const catalog_project& project = fProjects[p];
+		const int32 rootLength = project.root.Length();
+		if (!project.open || strncmp(path.String(), project.root.String(), rootLength) != 0)
+			continue;
+		if (path[rootLength] == '\0') {
+			relativePath = "";
+			return p;
+		}
+		if (path[rootLength] == '/') {
+			relativePath.SetTo(path.String() + rootLength + 1);
+			return p;
+		}
+	}
+	return -1;
+}
+
+
+// Entries are looked up by hash only: two paths with the same 64 bits
+// hash would be taken for the same file.
+uint64
+FileCatalog::_Hash(uint16 project, const char* relativePath, size_t length) const
+{
+	return std::hash<std::string_view>()(std::string_view(relativePath, length)) * 31
+		+ project;
+}
+
+
+bool
+FileCatalog::_Add(uint16 project, const BString& relativePath)
+{
+	const int32 length = relativePath.Length();
+	if (length == 0 || length > UINT16_MAX)
+		return false;
+	const uint64 hash = _Hash(project, relativePath, length);
+	if (fIndex.count(hash) > 0)
+		return false;
+
+	catalog_entry entry;
+	entry.mask = 0;
+	entry.offset = fNames.size();
+	entry.length = length;
+	entry.nameStart = relativePath.FindLast('/') + 1;
+	entry.project = project;
+	for (int32 i = 0; i < length; i++)
+		entry.mask |= CharBit(relativePath[i]);
+
+	fNames.insert(fNames.end(), relativePath.String(), relativePath.String() + length);
+	fIndex[hash] = fEntries.size();
+	fEntries.push_back(entry);
+	return true;
+}
+
+
+bool
+FileCatalog::_Remove(uint16 project, const BString& relativePath)
+{
+	auto it = fIndex.find(_Hash(project, relativePath, relativePath.Length()));
+	if (it == fIndex.end())
+		return false;
+	fEntries[it->second].length = 0;
+	fIndex.erase(it);
+	fRemovedCount++;
+	return true;
+}
+
+
+// Returns how many files were in the folder; their paths are added to
+// removed, if given
+int32
+FileCatalog::_RemoveFolder(uint16 project, const BString& relativePath,
+	std::vector<BString>* removed)
+{
+	if (relativePath.IsEmpty())
+		return 0;
+	BString prefix(relativePath);
+	prefix << "/";
+
+	int32 count = 0;
+	for (uint32 i = 0; i < fEntries.size(); i++) {
+		catalog_entry& entry = fEntries[i];
+		if (entry.project != project || entry.length <= prefix.Length()
+			|| memcmp(_PathAt(i), prefix.String(), prefix.Length()) != 0) {
+			continue;
+		}
+		if (removed != nullptr)
+			removed->push_back(BString(_PathAt(i), entry.length));
+		fIndex.erase(_Hash(project, _PathAt(i), entry.length));
+		entry.length = 0;
+		fRemovedCount++;
+		count++;
+	}
+	return count;
+}
+
+
+void
+FileCatalog::_Compact()
+{
+	if (fRemovedCount < kCompactThreshold || fRemovedCount * 4 < (int32)fEntries.size())
+		return;
+
+	std::vector<char> names;
+	std::vector<catalog_entry> entries;
+	names.reserve(fNames.size());
+	entries.reserve(fEntries.size() - fRemovedCount);
+	fIndex.clear();
+	for (uint32 i = 0; i < fEntries.size(); i++) {
+		catalog_entry entry = fEntries[i];
+		if (entry.length == 0)
+			continue;
+		const char* path = _PathAt(i);
+		entry.offset = names.size();
+		names.insert(names.end(), path, path + entry.length);
+		fIndex[_Hash(entry.project, path, entry.length)] = entries.size();
+		entries.push_back(entry);
+	}
+	fNames.swap(names);
+	fEntries.swap(entries);
+	fRemovedCount = 0;
+}
+
+
+void
+FileCatalog::_QueueCrawl(uint16 project, const BString& folder)
+{
+	fJobs.push_back({ project, folder });
+	if (fCrawlThread < 0) {
+		fCrawlThread = spawn_thread(&FileCatalog::_CrawlThread, "file catalog crawler",
+			B_LOW_PRIORITY, this);
+		if (fCrawlThread < 0 || resume_thread(fCrawlThread) != B_OK) {
+			LogError("FileCatalog: can't start the crawler");
+			fCrawlThread = -1;
+			return;
+		}
+	}
+	release_sem(fJobSem);
+}
+
+
+/* static */
+status_t
+FileCatalog::_CrawlThread(void* self)
+{
+	static_cast<FileCatalog*>(self)->_CrawlLoop();
+	return B_OK;
+}
+
+
+void
+FileCatalog::_CrawlLoop()
+{
+	while (!fQuit) {
+		status_t status;
+		do {
+			status = acquire_sem(fJobSem);
+		} while (status == B_INTERRUPTED);
+		// deleted when quitting
+		if (status != B_OK)
+			break;
+
+		crawl_job job;
+		{
+			BAutolock lock(fLocker);
+			// the jobs of a closed project were dropped
+			if (fJobs.empty())
+				continue;
+			job = fJobs.front();
+			fJobs.pop_front();
+		}
+		_Crawl(job);
+	}
+}
+
+
+void
+FileCatalog::_Crawl(const crawl_job& job)
+{
+	BString root;
+	IgnoreList ignoreList;
+	{
+		BAutolock lock(fLocker);
+		if (!fProjects[job.project].open)
+			return;
+		root = fProjects[job.project].root;
+		ignoreList = fProjects[job.project].ignoreList;
+	}
+
+	const bigtime_t start = system_time();
+	std::vector<BString> folders;
+	folders.push_back(job.folder);
+	std::vector<BString> files;
+	while (!folders.empty() && !fQuit) {
+		const BString folder = folders.back();
+		folders.pop_back();
+
+		BString folderPath(root);
+		if (!folder.IsEmpty())
+			folderPath << "/" << folder;
+		BDirectory directory(folderPath);
+		entry_ref ref;
+		while (directory.GetNextRef(&ref) == B_OK && !fQuit) {
+			struct stat st;
+			if (BEntry(&ref).GetStat(&st) != B_OK)
+				continue;
+			BString relativePath(folder);
+			if (!relativePath.IsEmpty())
+				relativePath << "/";
+			relativePath << ref.name;
+			BString path(root);
+			path << "/" << relativePath;
+
+			const bool isFolder = S_ISDIR(st.st_mode);
+			if (ignoreList.IsIgnored(path, isFolder))
+				continue;
+			if (isFolder)
+				folders.push_back(relativePath);
+			else
+				files.push_back(relativePath);
+
+			// the project was closed meanwhile
+			if (files.size() >= kCrawlBatch && !_AddCrawled(job.project, files))
+				return;
+		}
+	}
+	_AddCrawled(job.project, files);
+
+	LogInfo("FileCatalog: [%s] read in %" B_PRIdBIGTIME " ms", job.folder.IsEmpty()
+		? root.String() : job.folder.String(), (system_time() - start) / 1000);
+}
+
+
+bool
+FileCatalog::_AddCrawled(uint16 project, std::vector<BString>& files)
+{
+	BAutolock lock(fLocker);
+	if (!fProjects[project].open)
+		return false;
+	for (const BString& file : files)
+		_Add(project, file);
+	files.clear();
+	fGeneration++;
+	return true;
+}
+
+
+/* static */
+status_t
+FileCatalog::_FindThread(void* job)
+{
+	_FindRange(*static_cast<find_job*>(job));
+	return B_OK;
+}
+
+
+// Keeps the best maxCount entries of the range, in a min-heap
+/* static */
+void
+FileCatalog::_FindRange(find_job& job)
+{
+	const std::vector<catalog_entry>& entries = job.catalog->fEntries;
+	const std::vector<scored_entry>& boosts = *job.boosts;
+	auto scoreGreater = [](const scored_entry& a, const scored_entry& b) {
+		return a.score > b.score;
+	};
+	for (uint32 i = job.start; i < job.end; i++) {
+		const catalog_entry& entry = entries[i];
+		if (entry.length == 0 || (entry.mask & job.queryMask) != job.queryMask)
+			continue;
+
+		int32 score;
+		if (!_Score(job.catalog->_PathAt(i), entry.length, entry.nameStart, job.query,
+				job.queryLength, score)) {
+			continue;
+		}
+		if (!boosts.empty()) {
+			auto it = std::lower_bound(boosts.begin(), boosts.end(), i,
+				[](const scored_entry& boost, uint32 index) { return boost.index < index; });
+			if (it != boosts.end() && it->index == i)
+				score += it->score;
+		}
+
+		if ((int32)job.results.size() < job.maxCount) {
+			job.results.push_back({ i, score });
+			std::push_heap(job.results.begin(), job.results.end(), scoreGreater);
+		} else if (score > job.results.front().score) {
+			std::pop_heap(job.results.begin(), job.results.end(), scoreGreater);
+			job.results.back() = { i, score };
+			std::push_heap(job.results.begin(), job.results.end(), scoreGreater);
+		}
+	}
+}
+
+
+// The query characters must appear in order. A match within the file name
+// is preferred, then matches which are consecutive or start a word.
+/* static */
+bool
+FileCatalog::_Score(const char* text, int32 length, int32 nameStart, const char* query,
+	int32 queryLength, int32& score)
+{
+	int32 start;
+	int32 end;
+	if (!FindWindow(text, nameStart, length, query, queryLength, start, end)
+		&& !FindWindow(text, 0, length, query, queryLength, start, end)) {
+		return false;
+	}
+
+	score = 0;
+	int32 q = 0;
+	bool previousMatched = false;
+	for (int32 i = start; i < end && q < queryLength; i++) {
+		if (Lower(text[i]) != query[q]) {
+			score -= kGapPenalty;
+			previousMatched = false;
+			continue;
+		}
+		score += kMatchScore;
+		if (previousMatched)
+			score += kConsecutiveBonus;
+		if (i == 0 || IsSeparator(text[i - 1]))
+			score += kBoundaryBonus;
+		else if (islower(text[i - 1]) && isupper(text[i]))
+			score += kCamelCaseBonus;
+		if (i >= nameStart)
+			score += kNameBonus;
+		previousMatched = true;
+		q++;
+	}
+	return true;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef FileCatalog_H
+#define FileCatalog_H
+
+
+#include <Locker.h>
+#include <String.h>
+
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "IgnoreList.h"
+
+class ProjectFolder;
+
+struct catalog_match {
+	BString		path;			// absolute
+	BString		relativePath;	// to the project folder
+	BString		project;		// project name
+	int32		score;
+};
+
+/*
+ * FileCatalog lists the files of the open projects, for the quick open
+ * window. The paths, relative to their project, are kept one after the
+ * other in a single buffer; each entry has the set of characters of its
+ * path, so that most paths are discarded by a query without reading them.
+ * Projects are read by a low priority thread; after that the catalog is
+ * kept current by the path monitor events the projects browser receives.
+ * Find() scores the paths with a fuzzy matcher, on one thread per CPU for
+ * large catalogs. Recently opened files rank higher.
+ */
+class FileCatalog {
+public:
+								FileCatalog();
+								~FileCatalog();
+
+			void				AddProject(ProjectFolder* project);
+			void				RemoveProject(ProjectFolder* project);
+
+			void				PathCreated(const BString& path);
+			void				PathRemoved(const BString& path);
+			void				PathMoved(const BString& fromPath, const BString& path);
+
+			void				FileOpened(const BString& path);
+
+			int32				CountFiles();
+			// changes each time files are added or removed
+			uint32				Generation() const { return fGeneration; }
+
+			void				Find(const BString& query, int32 maxCount,
+									std::vector<catalog_match>& matches);
+
+private:
+	struct catalog_project {
+		ProjectFolder*	folder;
+		BString			root;
+		BString			name;
+		IgnoreList		ignoreList;
+		bool			open;
+	};
+
+	struct catalog_entry {
+		uint64		mask;		// see CharBit()
+		uint32		offset;		// in fNames
+		uint16		length;		// 0 once removed
+		uint16		nameStart;	// of the file name, in the path
+		uint16		project;
+	};
+
+	struct crawl_job {
+		uint16		project;
+		BString		folder;		// relative path, "" for the project folder
+	};
+
+	struct scored_entry {
+		uint32		index;
+		int32		score;
+	};
+
+	struct find_job {
+		const FileCatalog*	catalog;
+		const char*			query;
+		int32				queryLength;
+		uint64				queryMask;
+		uint32				start;
+		uint32				end;
+		int32				maxCount;
+		const std::vector<scored_entry>*	boosts;
+		std::vector<scored_entry>	results;
+	};
+
+			int32				_ProjectFor(const BString& path,
+									BString& relativePath) const;
+			uint64				_Hash(uint16 project, const char* relativePath,
+									size_t length) const;
+			bool				_Add(uint16 project, const BString& relativePath);
+			bool				_Remove(uint16 project, const BString& relativePath);
+			int32				_RemoveFolder(uint16 project, const BString& relativePath,
+									std::vector<BString>* removed);
+			void				_Compact();
+			const char*			_PathAt(uint32 index) const
+									{ return fNames.data() + fEntries[index].offset; }
+
+			void				_QueueCrawl(uint16 project, const BString& folder);
+	static	status_t			_CrawlThread(void* self);
+			void				_CrawlLoop();
+			void				_Crawl(const crawl_job& job);
+			bool				_AddCrawled(uint16 project, std::vector<BString>& files);
+
+	static	status_t			_FindThread(void* job);
+	static	void				_FindRange(find_job& job);
+	static	bool				_Score(const char* text, int32 length, int32 nameStart,
+									const char* query, int32 queryLength, int32& score);
+
+			BLocker				fLocker;
+			std::vector<catalog_project>	fProjects;
+			std::vector<char>	fNames;
+			std::vector<catalog_entry>	fEntries;
+			std::unordered_map<uint64, uint32>	fIndex;		// hash -> entry
+			int32				fRemovedCount;
+			std::atomic<uint32>	fGeneration;
+
+			std::vector<BString>	fRecent;	// most recent first
+
+			std::deque<crawl_job>	fJobs;
+			sem_id				fJobSem;
+			thread_id			fCrawlThread;
+			std::atomic<bool>	fQuit;
+
+			int32				fCPUCount;
+};
+
+
+#endif // FileCatalog_H
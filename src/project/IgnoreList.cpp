@@ -0,0 +1,155 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "IgnoreList.h"
+
+#include <File.h>
+#include <Path.h>
+
+#include <cctype>
+#include <cstring>
+#include <fnmatch.h>
+
+
+IgnoreList::IgnoreList()
+{
+}
+
+
+void
+IgnoreList::SetTo(const BString& root, const BString& patterns)
+{
+	fRoot = root;
+	fPatterns.clear();
+
+	int32 start = 0;
+	while (start < patterns.Length()) {
+		int32 end = start;
+		while (end < patterns.Length() && !isspace(patterns[end]))
+			end++;
+		BString glob(patterns.String() + start, end - start);
+		start = end + 1;
+		if (glob.IsEmpty() || glob[0] == '#')
+			continue;
+
+		ignore_pattern pattern;
+		pattern.negated = glob[0] == '!';
+		if (pattern.negated)
+			glob.Remove(0, 1);
+		pattern.directoryOnly = glob.EndsWith("/");
+		if (pattern.directoryOnly)
+			glob.Truncate(glob.Length() - 1);
+		// "**/name" matches at any depth, like "name"; "**/a/b" matches
+		// a/b in any folder
+		const bool anyDepth = glob.StartsWith("**/");
+		if (anyDepth)
+			glob.Remove(0, 3);
+		pattern.anchored = glob.FindFirst('/') >= 0;
+		pattern.anyDepth = anyDepth && pattern.anchored;
+		if (glob.StartsWith("/"))
+			glob.Remove(0, 1);
+		// fnmatch() has no "**": let '*' match '/' instead
+		pattern.flags = glob.FindFirst("**") >= 0 ? 0 : FNM_PATHNAME;
+		if (glob.IsEmpty())
+			continue;
+
+		pattern.glob = glob;
+		fPatterns.push_back(pattern);
+	}
+}
+
+
+// path is absolute: entries outside the project are never ignored
+bool
+IgnoreList::IsIgnored(const char* path, bool isDirectory) const
+{
+	if (fPatterns.empty() || fRoot.IsEmpty() || strncmp(path, fRoot.String(), fRoot.Length()) != 0
+		|| path[fRoot.Length()] != '/') {
+		return false;
+	}
+
+	const BString relativePath(path + fRoot.Length() + 1);
+
+	// a folder can't be re-included once its parent is ignored
+	for (int32 slash = relativePath.FindFirst('/'); slash >= 0;
+			slash = relativePath.FindFirst('/', slash + 1)) {
+		if (_Matches(BString(relativePath.String(), slash), true))
+			return true;
+	}
+	return _Matches(relativePath, isDirectory);
+}
+
+
+// The patterns of the .gitignore file in root, in the same format taken
+// by SetTo(). Patterns containing spaces can't be represented and are lost.
+/* static */
+BString
+IgnoreList::ReadGitIgnore(const BString& root)
+{
+	BPath path(root);
+	path.Append(".gitignore");
+	BFile file(path.Path(), B_READ_ONLY);
+	off_t size;
+	if (file.InitCheck() != B_OK || file.GetSize(&size) != B_OK)
+		return "";
+
+	BString content;
+	char* buffer = content.LockBuffer(size + 1);
+	const ssize_t read = file.Read(buffer, size);
+	content.UnlockBuffer(read > 0 ? read : 0);
+
+	BString patterns;
+	int32 start = 0;
+	while (start < content.Length()) {
+		int32 end = content.FindFirst('\n', start);
+		if (end < 0)
+			end = content.Length();
+		BString line(content.String() + start, end - start);
+		start = end + 1;
+		line.Trim();
+		if (line.IsEmpty() || line[0] == '#' || line.FindFirst(' ') >= 0
+			|| line.FindFirst('\t') >= 0) {
+			continue;
+		}
+		if (!patterns.IsEmpty())
+			patterns << " ";
+		patterns << line;
+	}
+	return patterns;
+}
+
+
+// the last matching pattern decides
+bool
+IgnoreList::_Matches(const char* relativePath, bool isDirectory) const
+{
+	const char* name = strrchr(relativePath, '/');
+	name = name != nullptr ? name + 1 : relativePath;
+
+	bool ignored = false;
+	for (const ignore_pattern& pattern : fPatterns) {
+		if (pattern.directoryOnly && !isDirectory)
+			continue;
+		if (pattern.negated != ignored)
+			continue;
+		bool matches = false;
+		if (pattern.anyDepth) {
+			// the path from the project folder, or from any folder in it
+			for (const char* subject = relativePath; subject != nullptr && !matches;) {
+				matches = fnmatch(pattern.glob.String(), subject, pattern.flags) == 0;
+				subject = strchr(subject, '/');
+				if (subject != nullptr)
+					subject++;
+			}
+		} else {
+			const char* subject = pattern.anchored ? relativePath : name;
+			matches = fnmatch(pattern.glob.String(), subject, pattern.flags) == 0;
+		}
+		if (matches)
+			ignored = !pattern.negated;
+	}
+	return ignored;
+}
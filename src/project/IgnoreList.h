@@ -0,0 +1,54 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef IgnoreList_H
+#define IgnoreList_H
+
+
+#include <String.h>
+
+#include <vector>
+
+/*
+ * IgnoreList holds the ignore patterns of a project: files and folders
+ * matching them are neither shown in the projects browser nor watched.
+ * Patterns are separated by spaces and follow .gitignore rules:
+ *   build			any entry named "build"
+ *   *.o			any entry whose name matches the glob
+ *   generated/		folders only
+ *   /objects.*		anchored to the project folder (so is any pattern with a '/')
+ *   **/gen/out		gen/out in any folder
+ *   !keep.o		re-includes what a previous pattern ignored
+ * Everything inside an ignored folder is ignored.
+ */
+class IgnoreList {
+public:
+								IgnoreList();
+
+			void				SetTo(const BString& root, const BString& patterns);
+			const BString&		Root() const { return fRoot; }
+
+			bool				IsIgnored(const char* path, bool isDirectory) const;
+
+	static	BString				ReadGitIgnore(const BString& root);
+
+private:
+	struct ignore_pattern {
+		BString		glob;
+		bool		negated;
+		bool		directoryOnly;
+		bool		anchored;
+		bool		anyDepth;	// anchored to any folder ("**/a/b")
+		int			flags;
+	};
+
+			bool				_Matches(const char* relativePath,
+									bool isDirectory) const;
+
+			BString				fRoot;
+			std::vector<ignore_pattern>	fPatterns;
+};
+
+
+#endif // IgnoreList_H
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "MimeTypeUpdater.h"
+
+#include <Directory.h>
+#include <Mime.h>
+#include <Node.h>
+#include <Path.h>
+
+#include <vector>
+
+#include "Log.h"
+#include "ProjectFolder.h"
+
+
+// how long a send may block before checking if the update was stopped
+static const bigtime_t kSendTimeout = 100000; // 100 ms
+// typed files are reported in batches of this size...
+static const int32 kBatchSize = 64;
+// ...or at least this often
+static const bigtime_t kBatchInterval = 500000; // 500 ms
+
+static int32 sNextUpdaterID = 1;
+
+
+MimeTypeUpdater::MimeTypeUpdater(ProjectFolder* project, const BMessenger& target)
+	:
+	fFolder(*project->EntryRef()),
+	fProject(project),
+	fIgnoreList(project->GetIgnoreList()),
+	fTarget(target),
+	fID(atomic_add(&sNextUpdaterID, 1)),
+	fThread(-1),
+	fQuit(false)
+{
+}
+
+
+MimeTypeUpdater::~MimeTypeUpdater()
+{
+	Stop();
+}
+
+
+status_t
+MimeTypeUpdater::Start()
+{
+	fThread = spawn_thread(&MimeTypeUpdater::_UpdateThread, "mime type updater",
+		B_LOW_PRIORITY, this);
+	if (fThread < 0)
+		return fThread;
+	return resume_thread(fThread);
+}
+
+
+void
+MimeTypeUpdater::Stop()
+{
+	if (fThread < 0)
+		return;
+	fQuit = true;
+	status_t exitValue;
+	wait_for_thread(fThread, &exitValue);
+	fThread = -1;
+}
+
+
+/* static */
+status_t
+MimeTypeUpdater::_UpdateThread(void* self)
+{
+	static_cast<MimeTypeUpdater*>(self)->_Update();
+	return B_OK;
+}
+
+
+void
+MimeTypeUpdater::_Update()
+{
+	const bigtime_t start = system_time();
+	int32 typedCount = 0;
+
+	BMessage batch(MSG_PROJECT_MIME_TYPES_UPDATED);
+	int32 batchCount = 0;
+	bigtime_t lastFlush = system_time();
+
+	std::vector<BPath> folders;
+	folders.push_back(BPath(&fFolder));
+	while (!folders.empty() && !fQuit) {
+		const BPath folderPath = folders.back();
+		folders.pop_back();
+
+		BDirectory directory(folderPath.Path());
+		entry_ref ref;
+		while (directory.GetNextRef(&ref) == B_OK && !fQuit) {
+			BPath path(folderPath);
+			path.Append(ref.name);
+			BNode node(&ref);
+			if (node.InitCheck() != B_OK)
+				continue;
+
+			const bool isDirectory = node.IsDirectory();
+			if (fIgnoreList.IsIgnored(path.Path(), isDirectory))
+				continue;
+			if (isDirectory) {
+				folders.push_back(path);
+				continue;
+			}
+
+			attr_info info;
+			if (node.GetAttrInfo("BEOS:TYPE", &info) == B_OK)
+				continue;
+			if (update_mime_info(path.Path(), false, true, B_UPDATE_MIME_INFO_NO_FORCE) != B_OK)
+				continue;
+
+			typedCount++;
+			batch.AddRef("ref", &ref);
+			if (++batchCount >= kBatchSize || system_time() - lastFlush > kBatchInterval) {
+				_Flush(batch);
+				batchCount = 0;
+				lastFlush = system_time();
+			}
+		}
+	}
+	if (!fQuit)
+		batch.AddBool("done", true);
+	_Flush(batch);
+
+	LogInfo("MimeTypeUpdater: %d files typed in %" B_PRIdBIGTIME " ms%s", typedCount,
+		(system_time() - start) / 1000, fQuit ? " (stopped)" : "");
+}
+
+
+void
+MimeTypeUpdater::_Flush(BMessage& batch)
+{
+	if (batch.IsEmpty())
+		return;
+
+	batch.AddInt32("updater_id", fID);
+	// Stop() waits for this thread from the browser's looper: never block
+	// on a full port while being asked to quit.
+	while (!fQuit) {
+		if (fTarget.SendMessage(&batch, (BHandler*)nullptr, kSendTimeout) != B_TIMED_OUT)
+			break;
+	}
+	batch.MakeEmpty();
+	batch.what = MSG_PROJECT_MIME_TYPES_UPDATED;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef MimeTypeUpdater_H
+#define MimeTypeUpdater_H
+
+
+#include <Entry.h>
+#include <Message.h>
+#include <Messenger.h>
+
+#include <atomic>
+
+#include "IgnoreList.h"
+
+const uint32 MSG_PROJECT_MIME_TYPES_UPDATED = 'pmtu';
+
+class ProjectFolder;
+
+/*
+ * MimeTypeUpdater sets the MIME type of the files of a project on a low
+ * priority worker thread, so that opening a project does not wait for
+ * update_mime_info() to sniff every file. Files which already have a type
+ * and folders ignored by the project are skipped. The refs of the files
+ * typed are sent in batches to the target, as "ref" fields of
+ * MSG_PROJECT_MIME_TYPES_UPDATED messages, to refresh their icons. Each
+ * message has the "updater_id"; the last one, sent when the whole project
+ * has been walked, has "done" too: the updater can then be deleted.
+ */
+class MimeTypeUpdater {
+public:
+								MimeTypeUpdater(ProjectFolder* project,
+									const BMessenger& target);
+								~MimeTypeUpdater();
+
+			status_t			Start();
+			void				Stop();
+
+			int32				ID() const { return fID; }
+			ProjectFolder*		Project() const { return fProject; }
+
+private:
+	static	status_t			_UpdateThread(void* self);
+			void				_Update();
+			void				_Flush(BMessage& batch);
+
+			entry_ref			fFolder;
+			ProjectFolder*		fProject;
+			IgnoreList			fIgnoreList;
+			BMessenger			fTarget;
+			int32				fID;
+			thread_id			fThread;
+			std::atomic<bool>	fQuit;
+};
+
+
+#endif // MimeTypeUpdater_H
@@ -12,15 +12,21 @@
 #include <OutlineListView.h>
 #include <Path.h>
 
+#include <algorithm>
+
 #include "ConfigManager.h"
 #include "LSPProjectWrapper.h"
 #include "LSPServersManager.h"
 #include "GenioNamespace.h"
+#include "GitStatusService.h"
 #include "GSettings.h"
 
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "ProjectSettingsWindow"
 
+// build profiles kept in the project settings, oldest first
+static const int32 kMaxBuildHistory = 20;
+
 SourceItem::SourceItem(const BString& path)
 	:
 	fEntryRef(),
@@ -54,6 +60,17 @@ SourceItem::SourceItem(const entry_ref& ref)
 }
 
 
+// For callers which already know the type, like ProjectScanner:
+// saves a stat() on the caller's thread
+SourceItem::SourceItem(const entry_ref& ref, SourceItemType type)
+	:
+	fEntryRef(ref),
+	fType(type),
+	fProjectFolder(nullptr)
+{
+}
+
+
 SourceItem::~SourceItem()
 {
 }
@@ -88,6 +105,7 @@ ProjectFolder::ProjectFolder(const entry_ref& ref, BMessenger& msgr)
 	fSettings(nullptr),
 	fMessenger(msgr),
 	fGitRepository(nullptr),
+	fGitStatus(nullptr),
 	fIsBuilding(false)
 {
 	fProjectFolder = this;
@@ -123,6 +141,7 @@ ProjectFolder::~ProjectFolder()
 	for (LSPProjectWrapper* w : fLSPProjectWrappers) {
 		delete w;
 	}
+	StopGitStatus();
 	delete fGitRepository;
 	delete fSettings;
 }
@@ -139,6 +158,10 @@ ProjectFolder::Open()
 	if (status != B_OK)
 		LogInfoF("%s", "Cannot load project settings");
 
+	UpdateIgnoreList();
+	UpdateRepositoryStatus();
+	fSnapshot.Load(Path());
+
 	// not a fatal error, just start with defaults
 	return B_OK;
 }
@@ -148,6 +171,7 @@ status_t
 ProjectFolder::Close()
 {
 	SaveSettings();
+	fSnapshot.Save();
 	return B_OK;
 }
 
@@ -240,6 +264,26 @@ ProjectFolder::GetBuildCommand() const
 }
 
 
+void
+ProjectFolder::SetBuildJobs(int32 jobs, BuildMode mode)
+{
+	if (mode == BuildMode::ReleaseMode)
+		(*fSettings)["project_release_build_jobs"] = jobs;
+	else
+		(*fSettings)["project_debug_build_jobs"] = jobs;
+}
+
+
+int32
+ProjectFolder::GetBuildJobs() const
+{
+	if (GetBuildMode() == BuildMode::ReleaseMode)
+		return (*fSettings)["project_release_build_jobs"];
+	else
+		return (*fSettings)["project_debug_build_jobs"];
+}
+
+
 void
 ProjectFolder::SetCleanCommand(BString const& command, BuildMode mode)
 {
@@ -317,6 +361,35 @@ ProjectFolder::RunInTerminal() const
 }
 
 
+void
+ProjectFolder::AddBuildProfile(const BMessage& profile)
+{
+	const BMessage history = BuildHistory();
+	int32 count = 0;
+	history.GetInfo("build", nullptr, &count);
+
+	BMessage updated;
+	BMessage build;
+	for (int32 i = std::max(0, count - kMaxBuildHistory + 1);
+			history.FindMessage("build", i, &build) == B_OK; i++) {
+		updated.AddMessage("build", &build);
+	}
+
+	build = profile;
+	build.AddInt32("build_mode", int32(GetBuildMode()));
+	updated.AddMessage("build", &build);
+
+	(*fSettings)["build_history"] = updated;
+}
+
+
+BMessage const
+ProjectFolder::BuildHistory() const
+{
+	return (*fSettings)["build_history"];
+}
+
+
 GitRepository*
 ProjectFolder::GetRepository() const
 {
@@ -328,6 +401,74 @@ void
 ProjectFolder::InitRepository(bool createInitialCommit)
 {
 	fGitRepository->Init(createInitialCommit);
+	UpdateRepositoryStatus();
+	if (fGitStatusTarget.IsValid())
+		StartGitStatus(fGitStatusTarget);
+}
+
+
+// Reads the current branch and the operation in progress from the
+// repository. The projects browser calls this when .git/HEAD or
+// .git/index change; returns true if anything changed.
+bool
+ProjectFolder::UpdateRepositoryStatus()
+{
+	BString branch;
+	BString state;
+	try {
+		if (fGitRepository != nullptr && fGitRepository->IsInitialized()) {
+			branch = fGitRepository->GetCurrentBranch();
+			state = fGitRepository->GetState();
+		}
+	} catch (const GitException &ex) {
+	}
+
+	if (branch == fCurrentBranch && state == fRepositoryState)
+		return false;
+
+	fCurrentBranch = branch;
+	fRepositoryState = state;
+	return true;
+}
+
+
+// The status of the files is computed in background: target receives
+// the paths whose status changed (see GitStatusService)
+void
+ProjectFolder::StartGitStatus(const BMessenger& target)
+{
+	StopGitStatus();
+	fGitStatusTarget = target;
+	if (fGitRepository == nullptr || !fGitRepository->IsInitialized())
+		return;
+
+	fGitStatus = new GitStatusService(Path(), target);
+	status_t status = fGitStatus->Start();
+	if (status != B_OK) {
+		LogError("Can't start the git status of project %s: %s", Path().String(),
+			strerror(status));
+		StopGitStatus();
+	}
+}
+
+
+// Doesn't wait for a status read in progress
+void
+ProjectFolder::StopGitStatus()
+{
+	if (fGitStatus != nullptr)
+		fGitStatus->Release();
+	fGitStatus = nullptr;
+}
+
+
+// Call when the "ignore_patterns" setting changes, with the project
+// not shown in the projects browser: it applies them when populating.
+void
+ProjectFolder::UpdateIgnoreList()
+{
+	BString patterns = (*fSettings)["ignore_patterns"];
+	fIgnoreList.SetTo(Path(), patterns);
 }
 
 
@@ -365,11 +506,22 @@ ProjectFolder::_PrepareSettings()
 	fSettings->AddConfig("General", "color",
 		B_TRANSLATE("Color:"), color, nullptr, kStorageTypeAttribute);
 
+	// new projects start from their .gitignore
+	BString ignorePatterns(".git");
+	const BString gitIgnore = IgnoreList::ReadGitIgnore(Path());
+	if (!gitIgnore.IsEmpty())
+		ignorePatterns << " " << gitIgnore;
+	fSettings->AddConfig("General", "ignore_patterns",
+		B_TRANSLATE("Ignored files and folders:"), ignorePatterns.String());
+
 	fSettings->AddConfig("Build", "build_mode",
 		B_TRANSLATE("Build mode:"), int32(BuildMode::ReleaseMode), &buildModes);
 
+	GMessage jobsLimits = { {"min", 0}, {"max", 256} };
 	fSettings->AddConfig("Build/Release", "project_release_build_command",
 		B_TRANSLATE("Build command:"), "");
+	fSettings->AddConfig("Build/Release", "project_release_build_jobs",
+		B_TRANSLATE("Parallel jobs (0 = automatic):"), 0, &jobsLimits);
 	fSettings->AddConfig("Build/Release", "project_release_clean_command",
 		B_TRANSLATE("Clean command:"), "");
 	fSettings->AddConfig("Build/Release", "project_release_execute_args",
@@ -378,6 +530,8 @@ ProjectFolder::_PrepareSettings()
 		B_TRANSLATE("Target:"), "");
 	fSettings->AddConfig("Build/Debug", "project_debug_build_command",
 		B_TRANSLATE("Build command:"), "");
+	fSettings->AddConfig("Build/Debug", "project_debug_build_jobs",
+		B_TRANSLATE("Parallel jobs (0 = automatic):"), 0, &jobsLimits);
 	fSettings->AddConfig("Build/Debug", "project_debug_clean_command",
 		B_TRANSLATE("Clean command:"), "");
 	fSettings->AddConfig("Build/Debug", "project_debug_execute_args",
@@ -387,6 +541,8 @@ ProjectFolder::_PrepareSettings()
 
 	fSettings->AddConfig("Run", "project_run_in_terminal",
 		B_TRANSLATE("Run in terminal"), false);
+
+	fSettings->AddConfig("Hidden", "build_history", "build_history", BMessage());
 }
 
 
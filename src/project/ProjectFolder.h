@@ -12,11 +12,14 @@
 #include <vector>
 
 #include "GitRepository.h"
+#include "IgnoreList.h"
+#include "ProjectSnapshot.h"
 
 using namespace Genio::Git;
 
 class BMessenger;
 class ConfigManager;
+class GitStatusService;
 class LSPProjectWrapper;
 class LSPTextDocument;
 
@@ -39,6 +42,7 @@ class SourceItem {
 public:
 					explicit	SourceItem(const BString& path);
 					explicit	SourceItem(const entry_ref& ref);
+								SourceItem(const entry_ref& ref, SourceItemType type);
 								~SourceItem();
 
 	const entry_ref*			EntryRef() const;
@@ -80,6 +84,9 @@ public:
 	bool						IsBuilding() const { return fIsBuilding; }
 	void						SetBuildingState(bool isBuilding) { fIsBuilding = isBuilding; }
 
+	void						SetBuildJobs(int32 jobs, BuildMode mode);
+	int32						GetBuildJobs() const;
+
 	void						SetCleanCommand(BString const& command, BuildMode mode);
 	BString const				GetCleanCommand() const;
 
@@ -95,9 +102,27 @@ public:
 	void						SetRunInTerminal(bool enabled);
 	bool						RunInTerminal() const;
 
+	void						AddBuildProfile(const BMessage& profile);
+	BMessage const				BuildHistory() const;
+
 	GitRepository*				GetRepository() const;
 	void						InitRepository(bool createInitialCommit = true);
 
+	// cached: safe to call while drawing
+	BString const				CurrentBranch() const { return fCurrentBranch; }
+	BString const				RepositoryState() const { return fRepositoryState; }
+	bool						UpdateRepositoryStatus();
+
+	// nullptr when the project is not a git repository, or not shown
+	GitStatusService*			GitStatus() const { return fGitStatus; }
+	void						StartGitStatus(const BMessenger& target);
+	void						StopGitStatus();
+
+	ProjectSnapshot&			Snapshot() { return fSnapshot; }
+
+	const IgnoreList&			GetIgnoreList() const { return fIgnoreList; }
+	void						UpdateIgnoreList();
+
 	void						SetGuessedBuilder(const BString& string);
 
 	const rgb_color				Color() const;
@@ -115,6 +140,12 @@ private:
 	ConfigManager*				fSettings;
 	BMessenger					fMessenger;
 	GitRepository*				fGitRepository;
+	BString						fCurrentBranch;
+	BString						fRepositoryState;
+	GitStatusService*			fGitStatus;
+	BMessenger					fGitStatusTarget;
+	IgnoreList					fIgnoreList;
+	ProjectSnapshot				fSnapshot;
 	bool						fIsBuilding;
 	BString						fFullPath;
 };
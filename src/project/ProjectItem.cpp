@@ -22,6 +22,47 @@
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "ProjectsFolderBrowser"
 
+// mixed with the text color, so that they suit dark and light themes
+static const rgb_color kGitNewColor = { 0, 160, 0, 255 };
+static const rgb_color kGitModifiedColor = { 220, 120, 0, 255 };
+static const rgb_color kGitConflictedColor = { 220, 0, 0, 255 };
+
+
+// The letter drawn after the name of a file
+static const char*
+GitStatusMarker(uint32 status)
+{
+	if ((status & GIT_STATUS_CONFLICTED) != 0)
+		return "C";
+	if ((status & GIT_STATUS_INDEX_NEW) != 0)
+		return "A";
+	if ((status & GIT_STATUS_WT_NEW) != 0)
+		return "U";
+	if ((status & (GIT_STATUS_INDEX_RENAMED | GIT_STATUS_WT_RENAMED)) != 0)
+		return "R";
+	if ((status & (GIT_STATUS_INDEX_MODIFIED | GIT_STATUS_WT_MODIFIED
+			| GIT_STATUS_INDEX_TYPECHANGE | GIT_STATUS_WT_TYPECHANGE)) != 0) {
+		return "M";
+	}
+	return nullptr;
+}
+
+
+static rgb_color
+GitStatusColor(uint32 status, rgb_color textColor)
+{
+	if ((status & GIT_STATUS_IGNORED) != 0)
+		return tint_color(textColor, textColor.IsDark() ? B_LIGHTEN_1_TINT : B_DARKEN_1_TINT);
+	if ((status & GIT_STATUS_CONFLICTED) != 0)
+		return mix_color(textColor, kGitConflictedColor, 192);
+	if ((status & (GIT_STATUS_INDEX_NEW | GIT_STATUS_WT_NEW)) != 0)
+		return mix_color(textColor, kGitNewColor, 192);
+	if (status != 0)
+		return mix_color(textColor, kGitModifiedColor, 192);
+	return textColor;
+}
+
+
 class ProjectItem;
 
 class TemporaryTextControl: public BTextControl {
@@ -75,10 +116,16 @@ ProjectItem::ProjectItem(SourceItem *sourceItem)
 	:
 	StyledItem(sourceItem->Name()),
 	fSourceItem(sourceItem),
+	fIcon(nullptr),
+	fLiveFolders(0),
+	fPolledFolders(0),
+	fGitStatus(0),
 	fNeedsSave(false),
 	fOpenedInEditor(false),
 	fTextControl(nullptr)
 {
+	UpdateIcon();
+	UpdateRepositoryStatus();
 }
 
 
@@ -128,37 +175,13 @@ ProjectItem::DrawItem(BView* owner, BRect bounds, bool complete)
 			SetTextFontFace(B_BOLD_FACE);
 		else
 			SetTextFontFace(B_REGULAR_FACE);
-
-		// TODO: this part is quite computationally intensive
-		// and shoud be moved away from the DrawItem.
-
-		BString projectName = Text();
-		BString projectPath = projectFolder->Path();
-		BString branchName;
-		try {
-			if (projectFolder->GetRepository()) {
-				branchName = projectFolder->GetRepository()->GetCurrentBranch();
-				BString extraText;
-				extraText << "  [" << branchName << "]";
-				SetExtraText(extraText);
-			}
-		} catch (const Genio::Git::GitException &ex) {
-		}
-
-		BString toolTipText;
-		toolTipText.SetToFormat("%s: %s\n%s: %s\n%s: %s",
-									B_TRANSLATE("Project"), projectName.String(),
-									B_TRANSLATE("Path"), projectPath.String(),
-									B_TRANSLATE("Current branch"), branchName.String());
-		SetToolTipText(toolTipText);
 	} else if (fOpenedInEditor)
 		SetTextFontFace(B_ITALIC_FACE);
 	else
 		SetTextFontFace(B_REGULAR_FACE);
 
-	const BBitmap* icon = IconCache::GetIcon(GetSourceItem()->EntryRef());
 	float iconSize = be_control_look->ComposeIconSize(B_MINI_ICON).Height();
-	BRect iconRect = DrawIcon(owner, bounds, icon, iconSize);
+	BRect iconRect = DrawIcon(owner, bounds, fIcon, iconSize);
 
 	// There's a TextControl for renaming
 	if (fTextControl != nullptr) {
@@ -177,10 +200,14 @@ ProjectItem::DrawItem(BView* owner, BRect bounds, bool complete)
 		if (fNeedsSave)
 			text.Append("*");
 		text.Append(ExtraText());
+		if (!isProject) {
+			if (!IsSelected())
+				owner->SetHighColor(GitStatusColor(fGitStatus, owner->HighColor()));
+			if (const char* marker = GitStatusMarker(fGitStatus))
+				text << "  " << marker;
+		}
 
 		DrawText(owner, text, textPoint);
-
-		owner->Sync();
 	}
 }
 
@@ -212,8 +239,6 @@ ProjectItem::DrawText(BView* owner, const char* text, const BPoint& textPoint)
 	}
 	owner->MovePenTo(textPoint);
 	owner->DrawString(text);
-
-	owner->Sync();
 }
 
 
@@ -239,6 +264,53 @@ ProjectItem::Update(BView* owner, const BFont* font)
 }
 
 
+// Resolves the icon from the node type: DrawItem() uses the stored bitmap.
+// Called again when the path monitor reports that the entry changed.
+void
+ProjectItem::UpdateIcon()
+{
+	const entry_ref* ref = GetSourceItem()->EntryRef();
+	// placeholders have no entry
+	fIcon = ref->name != nullptr ? IconCache::GetIcon(ref) : nullptr;
+}
+
+
+// The status comes from the GitStatusService of the project, computed in
+// background: items start without one. Returns true if it changed.
+bool
+ProjectItem::SetGitStatus(uint32 status)
+{
+	if (status == fGitStatus)
+		return false;
+	fGitStatus = status;
+	return true;
+}
+
+
+// Takes the branch and the repository state cached by the ProjectFolder:
+// DrawItem() must not query the repository.
+void
+ProjectItem::UpdateRepositoryStatus()
+{
+	_UpdateProjectText();
+}
+
+
+// How many folders of the project have a node monitor, and how many are
+// polled instead (see GenioWatchingFilter). Returns true if they changed.
+bool
+ProjectItem::SetMonitoringStatus(int32 liveFolders, int32 polledFolders)
+{
+	if (liveFolders == fLiveFolders && polledFolders == fPolledFolders)
+		return false;
+
+	fLiveFolders = liveFolders;
+	fPolledFolders = polledFolders;
+	_UpdateProjectText();
+	return true;
+}
+
+
 void
 ProjectItem::InitRename(BView* owner, BMessage* message)
 {
@@ -279,6 +351,44 @@ ProjectItem::CommitRename()
 }
 
 
+void
+ProjectItem::_UpdateProjectText()
+{
+	if (GetSourceItem()->Type() != SourceItemType::ProjectFolderItem)
+		return;
+
+	ProjectFolder *projectFolder = static_cast<ProjectFolder*>(GetSourceItem());
+	BString branchName = projectFolder->CurrentBranch();
+	BString extraText;
+	if (!branchName.IsEmpty()) {
+		extraText << "  [" << branchName;
+		if (!projectFolder->RepositoryState().IsEmpty())
+			extraText << "|" << projectFolder->RepositoryState();
+		extraText << "]";
+	}
+
+	BString toolTipText;
+	toolTipText.SetToFormat("%s: %s\n%s: %s\n%s: %s",
+								B_TRANSLATE("Project"), Text(),
+								B_TRANSLATE("Path"), projectFolder->Path().String(),
+								B_TRANSLATE("Current branch"), branchName.String());
+
+	if (fPolledFolders > 0) {
+		const int32 total = fLiveFolders + fPolledFolders;
+		BString polled;
+		polled.SetToFormat(B_TRANSLATE("%d%% polled"), int(fPolledFolders * 100 / total));
+		extraText << "  (" << polled << ")";
+		BString monitored;
+		monitored.SetToFormat(B_TRANSLATE("Folders: %d monitored, %d polled for changes"),
+			int(fLiveFolders), int(fPolledFolders));
+		toolTipText << "\n" << monitored;
+	}
+
+	SetExtraText(extraText);
+	SetToolTipText(toolTipText);
+}
+
+
 void
 ProjectItem::_DestroyTextWidget()
 {
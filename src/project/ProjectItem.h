@@ -8,6 +8,7 @@
 #include "StyledItem.h"
 
 
+class BBitmap;
 class BTextControl;
 class SourceItem;
 class ProjectItem : public StyledItem {
@@ -23,6 +24,11 @@ public:
 
 	void			SetNeedsSave(bool needs);
 	void			SetOpenedInEditor(bool open);
+	void			UpdateRepositoryStatus();
+	void			UpdateIcon();
+	uint32			GitStatus() const { return fGitStatus; }
+	bool			SetGitStatus(uint32 status);
+	bool			SetMonitoringStatus(int32 liveFolders, int32 polledFolders);
 
 	void			InitRename(BView* owner, BMessage* message);
 	void			AbortRename();
@@ -30,11 +36,16 @@ public:
 
 private:
 	SourceItem		*fSourceItem;
+	const BBitmap	*fIcon;
+	int32			fLiveFolders;
+	int32			fPolledFolders;
+	uint32			fGitStatus;
 	bool			fNeedsSave;
 	bool			fOpenedInEditor;
 	BTextControl	*fTextControl;
 
 	void			_DestroyTextWidget();
+	void			_UpdateProjectText();
 };
 
 
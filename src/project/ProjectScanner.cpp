@@ -0,0 +1,183 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "ProjectScanner.h"
+
+#include <Directory.h>
+#include <NaturalCompare.h>
+#include <Path.h>
+
+#include <algorithm>
+#include <sys/stat.h>
+#include <vector>
+
+#include "Log.h"
+#include "ProjectFolder.h"
+
+
+// how long a send may block before checking if the scan was stopped
+static const bigtime_t kSendTimeout = 100000; // 100 ms
+
+static int32 sNextScanID = 1;
+
+
+struct scan_entry {
+	entry_ref	ref;
+	ino_t		node;
+	bool		folder;
+};
+
+
+// same order as ProjectsFolderBrowser::_CompareProjectItems()
+static bool
+CompareEntries(const scan_entry& a, const scan_entry& b)
+{
+	if (a.folder != b.folder)
+		return a.folder;
+	return BPrivate::NaturalCompare(a.ref.name, b.ref.name) < 0;
+}
+
+
+ProjectScanner::ProjectScanner(const entry_ref& folder, ProjectItem* folderItem,
+	ProjectFolder* project, const BMessenger& target)
+	:
+	fFolder(folder),
+	fFolderItem(folderItem),
+	fProject(project),
+	fIgnoreList(project->GetIgnoreList()),
+	fTarget(target),
+	fKnownNode(-1),
+	fKnownModified(-1),
+	fID(atomic_add(&sNextScanID, 1)),
+	fThread(-1),
+	fQuit(false),
+	fStale(false)
+{
+}
+
+
+ProjectScanner::~ProjectScanner()
+{
+	Stop();
+}
+
+
+// The folder node and modification time, as stored in a ProjectSnapshot
+void
+ProjectScanner::SetKnownState(ino_t node, bigtime_t modified)
+{
+	fKnownNode = node;
+	fKnownModified = modified;
+}
+
+
+status_t
+ProjectScanner::Start()
+{
+	fThread = spawn_thread(&ProjectScanner::_ScanThread, "project scanner",
+		B_LOW_PRIORITY, this);
+	if (fThread < 0)
+		return fThread;
+	return resume_thread(fThread);
+}
+
+
+void
+ProjectScanner::Stop()
+{
+	if (fThread < 0)
+		return;
+	fQuit = true;
+	status_t exitValue;
+	wait_for_thread(fThread, &exitValue);
+	fThread = -1;
+}
+
+
+// Reads at most one entry: enough to know if an expander is needed
+/* static */
+bool
+ProjectScanner::HasChildren(const entry_ref& folder)
+{
+	BDirectory directory(&folder);
+	entry_ref ref;
+	return directory.InitCheck() == B_OK && directory.GetNextRef(&ref) == B_OK;
+}
+
+
+/* static */
+status_t
+ProjectScanner::_ScanThread(void* self)
+{
+	static_cast<ProjectScanner*>(self)->_Scan();
+	return B_OK;
+}
+
+
+void
+ProjectScanner::_Scan()
+{
+	BMessage batch(MSG_PROJECT_SCAN_BATCH);
+	batch.AddInt32("scan_id", fID);
+
+	// the time is taken before reading: a change made meanwhile
+	// is seen the next time
+	BDirectory directory(&fFolder);
+	struct stat st;
+	if (directory.InitCheck() != B_OK || directory.GetStat(&st) != B_OK) {
+		LogError("Can't scan folder [%s]", fFolder.name);
+	} else {
+		const bigtime_t modified = (bigtime_t)st.st_mtim.tv_sec * 1000000
+			+ st.st_mtim.tv_nsec / 1000;
+		if (st.st_ino == fKnownNode && modified == fKnownModified) {
+			batch.AddBool("unchanged", true);
+			_Send(batch);
+			return;
+		}
+		batch.AddInt64("folder_node", st.st_ino);
+		batch.AddInt64("modified", modified);
+	}
+
+	const BPath folderPath(&fFolder);
+	std::vector<scan_entry> entries;
+	scan_entry entry;
+	while (directory.GetNextRef(&entry.ref) == B_OK && !fQuit) {
+		struct stat entryStat;
+		if (BEntry(&entry.ref).GetStat(&entryStat) != B_OK)
+			continue;
+		entry.node = entryStat.st_ino;
+		entry.folder = S_ISDIR(entryStat.st_mode);
+		BPath path(folderPath);
+		path.Append(entry.ref.name);
+		if (fIgnoreList.IsIgnored(path.Path(), entry.folder))
+			continue;
+		entries.push_back(entry);
+	}
+	std::sort(entries.begin(), entries.end(), CompareEntries);
+
+	for (const scan_entry& item : entries) {
+		if (fQuit)
+			return;
+		batch.AddRef("ref", &item.ref);
+		batch.AddInt64("node", item.node);
+		batch.AddBool("folder", item.folder);
+		batch.AddBool("has_children", item.folder && HasChildren(item.ref));
+	}
+
+	_Send(batch);
+}
+
+
+void
+ProjectScanner::_Send(BMessage& batch)
+{
+	// Stop() waits for this thread from the browser's looper: never block
+	// on a full port while being asked to quit.
+	while (!fQuit) {
+		if (fTarget.SendMessage(&batch, (BHandler*)nullptr, kSendTimeout) != B_TIMED_OUT)
+			break;
+	}
+}
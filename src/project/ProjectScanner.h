@@ -0,0 +1,78 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef ProjectScanner_H
+#define ProjectScanner_H
+
+
+#include <Entry.h>
+#include <Message.h>
+#include <Messenger.h>
+
+#include <atomic>
+
+#include "IgnoreList.h"
+
+const uint32 MSG_PROJECT_SCAN_BATCH = 'psba';
+
+class ProjectFolder;
+class ProjectItem;
+
+/*
+ * ProjectScanner reads one folder of a project on a worker thread and sends
+ * its content to the projects browser in a MSG_PROJECT_SCAN_BATCH message.
+ * The browser populates folders lazily, the first time they are expanded.
+ * Each entry of the message has "ref", "folder" and, for folders,
+ * "has_children": a cheap probe used to show the expander without reading
+ * the folder. Entries are already sorted like the browser sorts them
+ * (folders first, natural order); entries matching the project ignore
+ * patterns are left out. The message also has the "folder_node" and
+ * "modified" time of the folder and the "node" of each entry.
+ * With SetKnownState(), a folder which did not change since it was read is
+ * not read again: the message only has "unchanged".
+ * A scan is marked stale when the folder changes while it runs: what it
+ * read may already be out of date.
+ */
+class ProjectScanner {
+public:
+								ProjectScanner(const entry_ref& folder,
+									ProjectItem* folderItem,
+									ProjectFolder* project,
+									const BMessenger& target);
+								~ProjectScanner();
+
+			void				SetKnownState(ino_t node, bigtime_t modified);
+			status_t			Start();
+			void				Stop();
+
+			// only used by the thread of the target
+			void				SetStale() { fStale = true; }
+			bool				IsStale() const { return fStale; }
+
+			int32				ID() const { return fID; }
+			ProjectFolder*		Project() const { return fProject; }
+			ProjectItem*		FolderItem() const { return fFolderItem; }
+
+	static	bool				HasChildren(const entry_ref& folder);
+
+private:
+	static	status_t			_ScanThread(void* self);
+			void				_Scan();
+			void				_Send(BMessage& batch);
+
+			entry_ref			fFolder;
+			ProjectItem*		fFolderItem;
+			ProjectFolder*		fProject;
+			IgnoreList			fIgnoreList;
+			BMessenger			fTarget;
+			ino_t				fKnownNode;
+			bigtime_t			fKnownModified;
+			int32				fID;
+			thread_id			fThread;
+			std::atomic<bool>	fQuit;
+			bool				fStale;
+};
+
+
+#endif // ProjectScanner_H
@@ -0,0 +1,279 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "ProjectSnapshot.h"
+
+#include <DataIO.h>
+#include <Directory.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <Path.h>
+
+#include <functional>
+
+#include "GenioNamespace.h"
+#include "Log.h"
+#include "ProjectScanner.h"
+
+
+static const uint32 kSnapshotMagic = 'GPSN';
+static const uint32 kSnapshotVersion = 1;
+
+
+static void
+WriteString(BPositionIO& io, const char* string)
+{
+	const uint16 length = strlen(string);
+	io.Write(&length, sizeof(length));
+	io.Write(string, length);
+}
+
+
+template<typename T>
+static bool
+ReadValue(BPositionIO& io, T& value)
+{
+	return io.Read(&value, sizeof(value)) == sizeof(value);
+}
+
+
+static bool
+ReadString(BPositionIO& io, BString& string)
+{
+	uint16 length;
+	if (!ReadValue(io, length))
+		return false;
+	char* buffer = string.LockBuffer(length);
+	const ssize_t read = io.Read(buffer, length);
+	string.UnlockBuffer(read == length ? length : 0);
+	return read == length;
+}
+
+
+ProjectSnapshot::ProjectSnapshot()
+	:
+	fChanged(false)
+{
+}
+
+
+// A missing or damaged snapshot leaves it empty: the project is read
+// from scratch.
+status_t
+ProjectSnapshot::Load(const BString& projectPath)
+{
+	fProjectPath = projectPath;
+	fFolders.clear();
+	fChanged = false;
+
+	BPath path;
+	status_t status = _GetFile(projectPath, path);
+	if (status != B_OK)
+		return status;
+
+	BFile file(path.Path(), B_READ_ONLY);
+	off_t size;
+	if ((status = file.InitCheck()) != B_OK || (status = file.GetSize(&size)) != B_OK)
+		return status;
+
+	// read it at once: parsing a file of small records would be slow
+	BMallocIO buffer;
+	buffer.SetSize(size);
+	if (file.ReadAt(0, (void*)buffer.Buffer(), size) != size)
+		return B_IO_ERROR;
+
+	uint32 magic;
+	uint32 version;
+	BString snapshotPath;
+	uint32 folderCount;
+	if (!ReadValue(buffer, magic) || magic != kSnapshotMagic
+		|| !ReadValue(buffer, version) || version != kSnapshotVersion
+		|| !ReadString(buffer, snapshotPath) || snapshotPath != projectPath
+		|| !ReadValue(buffer, folderCount)) {
+		LogInfo("Discarding the snapshot of project %s", projectPath.String());
+		return B_BAD_DATA;
+	}
+
+	for (uint32 i = 0; i < folderCount; i++) {
+		BString relativePath;
+		folder_state folder;
+		uint32 entryCount;
+		if (!ReadString(buffer, relativePath) || !ReadValue(buffer, folder.node)
+			|| !ReadValue(buffer, folder.modified) || !ReadValue(buffer, entryCount)
+			|| entryCount > (uint32)size) {
+			fFolders.clear();
+			return B_BAD_DATA;
+		}
+		folder.entries.resize(entryCount);
+		for (snapshot_entry& entry : folder.entries) {
+			if (!ReadString(buffer, entry.name) || !ReadValue(buffer, entry.node)
+				|| !ReadValue(buffer, entry.flags)) {
+				fFolders.clear();
+				return B_BAD_DATA;
+			}
+		}
+		fFolders[relativePath.String()] = folder;
+	}
+	return B_OK;
+}
+
+
+status_t
+ProjectSnapshot::Save()
+{
+	if (!fChanged || fProjectPath.IsEmpty())
+		return B_OK;
+
+	BMallocIO buffer;
+	buffer.Write(&kSnapshotMagic, sizeof(kSnapshotMagic));
+	buffer.Write(&kSnapshotVersion, sizeof(kSnapshotVersion));
+	WriteString(buffer, fProjectPath);
+	const uint32 folderCount = fFolders.size();
+	buffer.Write(&folderCount, sizeof(folderCount));
+	for (const auto& folder : fFolders) {
+		WriteString(buffer, folder.first.c_str());
+		buffer.Write(&folder.second.node, sizeof(folder.second.node));
+		buffer.Write(&folder.second.modified, sizeof(folder.second.modified));
+		const uint32 entryCount = folder.second.entries.size();
+		buffer.Write(&entryCount, sizeof(entryCount));
+		for (const snapshot_entry& entry : folder.second.entries) {
+			WriteString(buffer, entry.name);
+			buffer.Write(&entry.node, sizeof(entry.node));
+			buffer.Write(&entry.flags, sizeof(entry.flags));
+		}
+	}
+
+	BPath path;
+	status_t status = _GetFile(fProjectPath, path);
+	if (status != B_OK)
+		return status;
+	BFile file(path.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+	if ((status = file.InitCheck()) != B_OK)
+		return status;
+	if (file.Write(buffer.Buffer(), buffer.BufferLength()) != (ssize_t)buffer.BufferLength())
+		return B_IO_ERROR;
+
+	fChanged = false;
+	return B_OK;
+}
+
+
+void
+ProjectSnapshot::MakeEmpty()
+{
+	fFolders.clear();
+	fChanged = true;
+}
+
+
+// Fills batch like ProjectScanner would have: the entry_refs are built from
+// the device of the project and the folder node, without reading the disk.
+// node and modified are those of the folder when it was read.
+bool
+ProjectSnapshot::GetFolder(const BString& relativePath, dev_t device, BMessage& batch,
+	ino_t& node, bigtime_t& modified) const
+{
+	auto it = fFolders.find(relativePath.String());
+	if (it == fFolders.end())
+		return false;
+
+	const folder_state& folder = it->second;
+	node = folder.node;
+	modified = folder.modified;
+
+	batch.what = MSG_PROJECT_SCAN_BATCH;
+	for (const snapshot_entry& entry : folder.entries) {
+		const entry_ref ref(device, folder.node, entry.name);
+		batch.AddRef("ref", &ref);
+		batch.AddInt64("node", entry.node);
+		batch.AddBool("folder", (entry.flags & kFolderEntry) != 0);
+		batch.AddBool("has_children", (entry.flags & kHasChildren) != 0);
+	}
+	return true;
+}
+
+
+void
+ProjectSnapshot::SetFolder(const BString& relativePath, const BMessage& batch)
+{
+	folder_state folder;
+	folder.node = batch.GetInt64("folder_node", -1);
+	folder.modified = batch.GetInt64("modified", -1);
+
+	int32 count = 0;
+	batch.GetInfo("ref", nullptr, &count);
+	folder.entries.resize(count);
+	for (int32 i = 0; i < count; i++) {
+		snapshot_entry& entry = folder.entries[i];
+		entry_ref ref;
+		batch.FindRef("ref", i, &ref);
+		entry.name = ref.name;
+		entry.node = batch.GetInt64("node", i, -1);
+		entry.flags = 0;
+		if (batch.GetBool("folder", i, false))
+			entry.flags |= kFolderEntry;
+		if (batch.GetBool("has_children", i, false))
+			entry.flags |= kHasChildren;
+	}
+
+	// forget the folders which are gone
+	auto it = fFolders.find(relativePath.String());
+	if (it != fFolders.end()) {
+		for (const snapshot_entry& old : it->second.entries) {
+			if ((old.flags & kFolderEntry) == 0)
+				continue;
+			bool found = false;
+			for (const snapshot_entry& entry : folder.entries) {
+				if (entry.node == old.node && entry.name == old.name) {
+					found = true;
+					break;
+				}
+			}
+			if (!found) {
+				BString childPath(relativePath);
+				if (!childPath.IsEmpty())
+					childPath << "/";
+				childPath << old.name;
+				_RemoveSubtree(childPath);
+			}
+		}
+	}
+
+	fFolders[relativePath.String()] = folder;
+	fChanged = true;
+}
+
+
+void
+ProjectSnapshot::_RemoveSubtree(const BString& relativePath)
+{
+	fFolders.erase(relativePath.String());
+
+	const std::string prefix = BString(relativePath).Append("/").String();
+	auto it = fFolders.lower_bound(prefix);
+	while (it != fFolders.end() && it->first.compare(0, prefix.length(), prefix) == 0)
+		it = fFolders.erase(it);
+}
+
+
+// One file per project, named after the hash of its path
+/* static */
+status_t
+ProjectSnapshot::_GetFile(const BString& projectPath, BPath& path)
+{
+	status_t status = find_directory(B_USER_CACHE_DIRECTORY, &path, true);
+	if (status != B_OK)
+		return status;
+	path.Append(GenioNames::kApplicationName);
+	path.Append("projects");
+	status = create_directory(path.Path(), 0755);
+	if (status != B_OK)
+		return status;
+
+	BString name;
+	name.SetToFormat("%016zx", std::hash<std::string>()(projectPath.String()));
+	return path.Append(name);
+}
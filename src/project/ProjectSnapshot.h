@@ -0,0 +1,69 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef ProjectSnapshot_H
+#define ProjectSnapshot_H
+
+
+#include <Entry.h>
+#include <Message.h>
+#include <String.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+class BPath;
+
+/*
+ * ProjectSnapshot keeps the content of the project folders read so far
+ * (names, types, nodes and the folder modification time), so that a project
+ * reopened later is shown at once and only the folders which changed are
+ * read again. Folders are keyed by their path relative to the project
+ * ("" is the project folder) and exchanged as MSG_PROJECT_SCAN_BATCH
+ * messages, as sent by ProjectScanner.
+ * It is stored in the user cache directory, in a compact binary format.
+ */
+class ProjectSnapshot {
+public:
+								ProjectSnapshot();
+
+			status_t			Load(const BString& projectPath);
+			status_t			Save();
+			void				MakeEmpty();
+
+			bool				GetFolder(const BString& relativePath, dev_t device,
+									BMessage& batch, ino_t& node,
+									bigtime_t& modified) const;
+			void				SetFolder(const BString& relativePath,
+									const BMessage& batch);
+
+private:
+	enum {
+		kFolderEntry	= 0x01,
+		kHasChildren	= 0x02
+	};
+
+	struct snapshot_entry {
+		BString		name;
+		ino_t		node;
+		uint8		flags;
+	};
+
+	struct folder_state {
+		ino_t						node;
+		bigtime_t					modified;
+		std::vector<snapshot_entry>	entries;
+	};
+
+			void				_RemoveSubtree(const BString& relativePath);
+	static	status_t			_GetFile(const BString& projectPath, BPath& path);
+
+			BString				fProjectPath;
+			std::map<std::string, folder_state>	fFolders;
+			bool				fChanged;
+};
+
+
+#endif // ProjectSnapshot_H
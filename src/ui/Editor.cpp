@@ -581,6 +581,77 @@ Editor::Find(const BString&  text, int flags, bool backwards, bool onWrap)
 	return position;
 }
 
+static inline bool
+_IsWordChar(char c)
+{
+	return isalnum((unsigned char)c) || c == '_';
+}
+
+
+static bool
+_LineContains(const char* start, const char* end, const BString& text,
+	bool matchCase, bool wholeWord)
+{
+	const size_t length = text.Length();
+	for (const char* p = start; p + length <= end; p++) {
+		if (matchCase ? memcmp(p, text.String(), length) != 0
+				: strncasecmp(p, text.String(), length) != 0)
+			continue;
+		if (wholeWord && ((p > start && _IsWordChar(p[-1]))
+				|| (p + length < end && _IsWordChar(p[length]))))
+			continue;
+		return true;
+	}
+	return false;
+}
+
+
+// Scans the live document for find in files, adding a grep-like "line"
+// message for every matching line. The text is read in place through
+// SCI_GETCHARACTERPOINTER so unsaved changes and line numbers are current.
+int32
+Editor::FindInBuffer(const BString& text, bool matchCase, bool wholeWord,
+	BMessage* result)
+{
+	if (text.IsEmpty())
+		return 0;
+
+	const char* buffer = (const char*)SendMessage(SCI_GETCHARACTERPOINTER, UNSET, UNSET);
+	const Sci_Position length = SendMessage(SCI_GETLENGTH, UNSET, UNSET);
+	if (buffer == nullptr)
+		return 0;
+
+	int32 count = 0;
+	int32 lineNumber = 1;
+	const char* end = buffer + length;
+	const char* lineStart = buffer;
+	while (lineStart < end) {
+		const char* lineEnd = (const char*)memchr(lineStart, '\n', end - lineStart);
+		if (lineEnd == nullptr)
+			lineEnd = end;
+
+		if (_LineContains(lineStart, lineEnd, text, matchCase, wholeWord)) {
+			const char* textEnd = lineEnd;
+			if (textEnd > lineStart && textEnd[-1] == '\r')
+				textEnd--;
+			// "N:text", as grep -n reports it
+			BString lineText;
+			lineText << lineNumber << ":";
+			lineText.Append(lineStart, textEnd - lineStart);
+			BMessage lineMessage(B_REFS_RECEIVED);
+			lineMessage.AddString("text", lineText);
+			lineMessage.AddRef("refs", &fFileRef);
+			lineMessage.AddInt32("be:line", lineNumber);
+			result->AddMessage("line", &lineMessage);
+			count++;
+		}
+		lineStart = lineEnd + 1;
+		lineNumber++;
+	}
+	return count;
+}
+
+
 int
 Editor::FindInTarget(const BString& search, int flags, int startPosition, int endPosition)
 {
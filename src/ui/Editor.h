@@ -75,6 +75,8 @@ public:
 			int32				EndOfLine();
 		const BString			FilePath() const;
 			entry_ref *const	FileRef() { return &fFileRef; }
+			int32				FindInBuffer(const BString& text, bool matchCase,
+									bool wholeWord, BMessage* result);
 
 
 
@@ -0,0 +1,321 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "GenioWatchingFilter.h"
+
+#include <Autolock.h>
+#include <Directory.h>
+#include <Path.h>
+
+#include <sys/resource.h>
+
+#include "Log.h"
+
+
+// used when the node monitor limit can't be read
+static const int32 kDefaultBudget = 3072;
+
+
+GenioWatchingFilter::GenioWatchingFilter()
+	:
+	fLocker("GenioWatchingFilter"),
+	fLiveCount(0),
+	fBudget(kDefaultBudget),
+	fBudgetReported(false)
+{
+	// leave a quarter of the team limit to the editors, which watch
+	// their files, and to the rest of the application
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOVMON, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+		fBudget = limit.rlim_cur * 3 / 4;
+
+	fPoller.SetListener(this);
+}
+
+
+/* virtual */
+GenioWatchingFilter::~GenioWatchingFilter()
+{
+}
+
+
+void
+GenioWatchingFilter::SetTarget(const BMessenger& target)
+{
+	fPoller.SetTarget(target);
+}
+
+
+void
+GenioWatchingFilter::SetIgnoreList(const IgnoreList& ignoreList)
+{
+	BAutolock lock(fLocker);
+	RemoveIgnoreList(ignoreList.Root());
+	fIgnoreLists.push_back(ignoreList);
+	fPoller.SetIgnoreList(ignoreList);
+}
+
+
+void
+GenioWatchingFilter::RemoveIgnoreList(const BString& root)
+{
+	BAutolock lock(fLocker);
+	for (auto it = fIgnoreLists.begin(); it != fIgnoreLists.end(); it++) {
+		if (it->Root() == root) {
+			fIgnoreLists.erase(it);
+			break;
+		}
+	}
+	fPoller.RemoveIgnoreList(root);
+}
+
+
+// Called once BPathMonitor stopped watching a closed project: what is left
+// of it are the directories found by the poller and never promoted
+void
+GenioWatchingFilter::RemoveRoot(const BString& root)
+{
+	BAutolock lock(fLocker);
+	for (auto it = fNodes.begin(); it != fNodes.end();) {
+		watched_node& watched = it->second;
+		if (watched.root != root) {
+			it++;
+			continue;
+		}
+		if (watched.live) {
+			BPrivate::BPathMonitor::BWatchingInterface::WatchNode(&it->first, B_STOP_WATCHING,
+				watched.handler, watched.looper);
+			fLiveCount--;
+		}
+		it = fNodes.erase(it);
+	}
+	fPoller.RemoveRoot(root);
+}
+
+
+/* virtual */
+status_t
+GenioWatchingFilter::WatchNode(const node_ref* node, uint32 flags, const BHandler* handler,
+	const BLooper* looper)
+{
+	BAutolock lock(fLocker);
+	auto it = fNodes.find(*node);
+
+	if (flags == B_STOP_WATCHING) {
+		// files and ignored directories were never watched
+		if (it == fNodes.end())
+			return B_OK;
+		status_t status = B_OK;
+		if (it->second.live) {
+			status = BPrivate::BPathMonitor::BWatchingInterface::WatchNode(node, flags,
+				handler, looper);
+			fLiveCount--;
+		} else
+			fPoller.Remove(*node);
+		fNodes.erase(it);
+		return status;
+	}
+
+	if (it != fNodes.end()) {
+		it->second.flags = flags;
+		it->second.handler = handler;
+		it->second.looper = looper;
+		if (it->second.found) {
+			// a folder found by the poller, now watched by BPathMonitor too
+			it->second.found = false;
+			if (it->second.hot)
+				_MakeLive(it->first, it->second);
+			return B_OK;
+		}
+		if (!it->second.live)
+			return B_OK;
+		return BPrivate::BPathMonitor::BWatchingInterface::WatchNode(node, flags,
+			handler, looper);
+	}
+
+	status_t status;
+	BDirectory dir(node);
+	if ((status = dir.InitCheck()) != B_OK) {
+		// Typically the reason for this failure is "Not a directory".
+		// As we want to avoid to use a watch_node for every standard file,
+		// we quit here.
+		return B_OK;
+	}
+
+	BEntry entry;
+	dir.GetEntry(&entry);
+	BPath path;
+	entry.GetPath(&path);
+
+	watched_node watched = { flags, handler, looper, "", false, false, false };
+	if (_IsIgnored(path, watched.root))
+		return B_OK;
+
+	if (fLiveCount < fBudget) {
+		status = BPrivate::BPathMonitor::BWatchingInterface::WatchNode(node, flags, handler, looper);
+		if (status == B_OK) {
+			watched.live = true;
+			fLiveCount++;
+		} else {
+			LogErrorF("Can't watch_node for directory [%s](%d) (%s) handler (%p) looper (%p) %d",
+						path.Path(),
+						node->node,
+						strerror(status),
+						handler,
+						looper,
+						status == B_BAD_VALUE);
+			// the team limit is lower than expected
+			if (status == B_NO_MEMORY)
+				fBudget = fLiveCount;
+		}
+	}
+
+	if (!watched.live) {
+		if (!fBudgetReported) {
+			LogInfoF("Node monitor budget reached (%d live): polling [%s] and the next directories",
+				fLiveCount, path.Path());
+			fBudgetReported = true;
+		}
+		fPoller.Add(*node, watched.root);
+	}
+
+	fNodes[*node] = watched;
+	return B_OK;
+}
+
+
+// Called for the directories the user opens: they keep a live monitor.
+// Returns true for a directory found by the poller: BPathMonitor doesn't
+// know it, so the caller has to watch it with BPathMonitor, which makes
+// it live.
+bool
+GenioWatchingFilter::Promote(const node_ref& node)
+{
+	BAutolock lock(fLocker);
+	auto it = fNodes.find(node);
+	if (it == fNodes.end())
+		return false;
+
+	it->second.hot = true;
+	if (it->second.found)
+		return true;
+	_MakeLive(it->first, it->second);
+	return false;
+}
+
+
+void
+GenioWatchingFilter::GetMonitoringStatus(const BString& root, int32& live, int32& polled)
+{
+	BAutolock lock(fLocker);
+	live = 0;
+	for (const auto& node : fNodes) {
+		if (node.second.live && node.second.root == root)
+			live++;
+	}
+	polled = fPoller.CountDirectories(root);
+}
+
+
+// A directory created inside a polled one: it is polled as well, with the
+// handler of its parent
+/* virtual */
+void
+GenioWatchingFilter::DirectoryCreated(const node_ref& parent, const node_ref& node)
+{
+	BAutolock lock(fLocker);
+	auto it = fNodes.find(parent);
+	if (it == fNodes.end() || fNodes.find(node) != fNodes.end())
+		return;
+
+	watched_node watched = it->second;
+	watched.live = false;
+	watched.hot = false;
+	watched.found = true;
+	fNodes[node] = watched;
+	fPoller.Add(node, watched.root);
+}
+
+
+/* virtual */
+void
+GenioWatchingFilter::DirectoryRemoved(const node_ref& node)
+{
+	BAutolock lock(fLocker);
+	// the others are BPathMonitor's
+	auto it = fNodes.find(node);
+	if (it != fNodes.end() && it->second.found)
+		fNodes.erase(it);
+}
+
+
+// Also returns the root of the project the path belongs to
+bool
+GenioWatchingFilter::_IsIgnored(const BPath& path, BString& root) const
+{
+	if (path.InitCheck() != B_OK)
+		return false;
+
+	for (const IgnoreList& ignoreList : fIgnoreLists) {
+		const BString& projectRoot = ignoreList.Root();
+		if (strncmp(path.Path(), projectRoot.String(), projectRoot.Length()) != 0
+			|| (path.Path()[projectRoot.Length()] != '/'
+				&& path.Path()[projectRoot.Length()] != '\0')) {
+			continue;
+		}
+		root = projectRoot;
+
+		// the repository is ignored, but for its refs: the cached branches
+		// and tags depend on them
+		BString gitPath(projectRoot);
+		gitPath << "/.git";
+		if (gitPath == path.Path())
+			return false;
+		BString refsPath(gitPath);
+		refsPath << "/refs";
+		if (strncmp(path.Path(), refsPath.String(), refsPath.Length()) == 0
+			&& (path.Path()[refsPath.Length()] == '/' || path.Path()[refsPath.Length()] == '\0')) {
+			return false;
+		}
+		return ignoreList.IsIgnored(path.Path(), true);
+	}
+	return false;
+}
+
+
+void
+GenioWatchingFilter::_MakeLive(const node_ref& node, watched_node& watched)
+{
+	if (watched.live || (fLiveCount >= fBudget && !_Demote()))
+		return;
+
+	if (BPrivate::BPathMonitor::BWatchingInterface::WatchNode(&node, watched.flags,
+			watched.handler, watched.looper) != B_OK) {
+		return;
+	}
+	fPoller.Remove(node);
+	watched.live = true;
+	fLiveCount++;
+}
+
+
+// Hands a live directory nobody opened to the poller
+bool
+GenioWatchingFilter::_Demote()
+{
+	for (auto& node : fNodes) {
+		watched_node& watched = node.second;
+		if (!watched.live || watched.hot)
+			continue;
+		BPrivate::BPathMonitor::BWatchingInterface::WatchNode(&node.first, B_STOP_WATCHING,
+			watched.handler, watched.looper);
+		watched.live = false;
+		fLiveCount--;
+		fPoller.Add(node.first, watched.root);
+		return true;
+	}
+	return false;
+}
@@ -6,48 +6,77 @@
 #define GenioWatchingFilter_H
 
 
-#include <Directory.h>
-#include <Path.h>
+#include <Locker.h>
+#include <Messenger.h>
+#include <Node.h>
 #include <PathMonitor.h>
 
-#include "Log.h"
+#include <map>
+#include <vector>
+
+#include "DirectoryPoller.h"
+#include "IgnoreList.h"
+
+class BPath;
 
 // This is attached to the PathMonitor class to avoid watching too many (useless) files.
 // In the ProjectFolderBrowser we care only on directories and related files events.
 // We can't use the B_WATCH_DIRECTORIES_ONLY flag as PathMonitor won't notify for file related events.
+// Directories ignored by their project are not watched either, except the .git folder itself:
+// the cached branch depends on .git/HEAD and .git/index.
+//
+// Node monitors are limited: past a budget (or when watch_node() fails) directories are
+// handed to a DirectoryPoller, which reports their changes to the same target.
+// Directories expanded in the browser are "hot": Promote() gives them a live monitor,
+// taken from a cold directory if needed. The directories the poller finds are known here
+// as well and dropped with their project by RemoveRoot(); BPathMonitor has to be told to
+// watch those the user opens.
+// WatchNode() runs in the PathMonitor looper and the listener calls in the poller thread,
+// hence the lock.
 
-class GenioWatchingFilter : public BPrivate::BPathMonitor::BWatchingInterface {
+class GenioWatchingFilter : public BPrivate::BPathMonitor::BWatchingInterface,
+	private DirectoryPoller::Listener {
 public:
-	status_t WatchNode(const node_ref* node, uint32 flags, const BHandler* handler,
-							  		const BLooper* looper = NULL)
-
-	{
-		status_t status;
-		BDirectory dir(node);
-		if ((status = dir.InitCheck()) != B_OK) {
-			// Typically the reason for this failure is "Not a directory".
-			// As we want to avoid to use a watch_node for every standard file,
-			// we quit here.
-			return B_OK;
-		}
-
-		status = BPrivate::BPathMonitor::BWatchingInterface::WatchNode(node, flags, handler, looper);
-		if (status != B_OK /*&& flags != B_STOP_WATCHING*/) {
-			BEntry entry;
-			dir.GetEntry(&entry);
-			BPath path;
-			entry.GetPath(&path);
-			LogErrorF("Can't watch_node for directory [%s](%d) (%s) handler (%p) looper (%p) %d",
-						path.Path(),
-						node->node,
-						strerror(status),
-						handler,
-						looper,
-						status == B_BAD_VALUE);
-			//TODO: maybe we should notify the user that the PathMonitor is not working?
-		}
-		return status;
-	}
+								GenioWatchingFilter();
+	virtual						~GenioWatchingFilter();
+
+			void				SetTarget(const BMessenger& target);
+			void				SetIgnoreList(const IgnoreList& ignoreList);
+			void				RemoveIgnoreList(const BString& root);
+			void				RemoveRoot(const BString& root);
+
+	virtual	status_t			WatchNode(const node_ref* node, uint32 flags,
+									const BHandler* handler, const BLooper* looper = NULL);
+
+			bool				Promote(const node_ref& node);
+			void				GetMonitoringStatus(const BString& root, int32& live,
+									int32& polled);
+
+private:
+	struct watched_node {
+		uint32				flags;
+		const BHandler*		handler;
+		const BLooper*		looper;
+		BString				root;
+		bool				live;
+		bool				hot;
+		bool				found;		// by the poller: BPathMonitor doesn't know it
+	};
+
+	virtual	void				DirectoryCreated(const node_ref& parent, const node_ref& node);
+	virtual	void				DirectoryRemoved(const node_ref& node);
+
+			bool				_IsIgnored(const BPath& path, BString& root) const;
+			void				_MakeLive(const node_ref& node, watched_node& watched);
+			bool				_Demote();
+
+			BLocker				fLocker;
+			std::vector<IgnoreList>	fIgnoreLists;
+			std::map<node_ref, watched_node>	fNodes;
+			int32				fLiveCount;
+			int32				fBudget;
+			bool				fBudgetReported;
+			DirectoryPoller		fPoller;
 };
 
 #endif // GenioWatchingFilter_H
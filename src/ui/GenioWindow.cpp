@@ -7,6 +7,7 @@
 #include "GenioWindow.h"
 
 #include <cassert>
+#include <fnmatch.h>
 #include <string>
 
 #include <Alert.h>
@@ -34,6 +35,7 @@
 #include <Screen.h>
 #include <StringFormat.h>
 #include <StringItem.h>
+#include <StringList.h>
 #include <Clipboard.h>
 
 #include "ActionManager.h"
@@ -45,11 +47,13 @@
 #include "EditorMouseWheelMessageFilter.h"
 #include "EditorMessages.h"
 #include "EditorTabManager.h"
+#include "FileCatalog.h"
 #include "FSUtils.h"
 #include "GenioApp.h"
 #include "GenioNamespace.h"
 #include "GenioWindowMessages.h"
 #include "GitAlert.h"
+#include "GitOperation.h"
 #include "GitRepository.h"
 #include "GoToLineWindow.h"
 #include "GSettings.h"
@@ -60,6 +64,7 @@
 #include "ProjectFolder.h"
 #include "ProjectItem.h"
 #include "ProjectsFolderBrowser.h"
+#include "QuickOpenWindow.h"
 #include "QuitAlert.h"
 #include "RemoteProjectWindow.h"
 #include "SearchResultPanel.h"
@@ -109,6 +114,38 @@ AcceptsCopyPaste(BView* view)
 }
 
 
+static BString
+FormatSeconds(int64 duration)
+{
+	BString text;
+	text.SetToFormat("%.2f s", duration / 1000000.0);
+	return text;
+}
+
+
+// Like grep --exclude-dir: a folder of the path, relative to the project,
+// matches one of the comma separated globs
+static bool
+IsInExcludedFolder(const BString& relativePath, const BString& excludeDirs)
+{
+	if (excludeDirs.IsEmpty())
+		return false;
+
+	BStringList globs;
+	excludeDirs.Split(",", true, globs);
+	BStringList names;
+	relativePath.Split("/", true, names);
+	// the last name is the file itself
+	for (int32 i = 0; i < names.CountStrings() - 1; i++) {
+		for (int32 j = 0; j < globs.CountStrings(); j++) {
+			if (fnmatch(globs.StringAt(j).String(), names.StringAt(i).String(), 0) == 0)
+				return true;
+		}
+	}
+	return false;
+}
+
+
 GenioWindow::GenioWindow(BRect frame)
 	:
 	BWindow(frame, "Genio", B_TITLED_WINDOW, B_ASYNCHRONOUS_CONTROLS |
@@ -168,7 +205,9 @@ GenioWindow::GenioWindow(BRect frame)
 	, fProblemsPanel(nullptr)
 	, fBuildLogView(nullptr)
 	, fConsoleIOView(nullptr)
+	, fConsoleSessions(4, false)
 	, fGoToLineWindow(nullptr)
+	, fQuickOpenWindow(nullptr)
 	, fSearchResultPanel(nullptr)
 	, fScreenMode(kDefault)
 	, fDisableProjectNotifications(false)
@@ -313,7 +352,9 @@ GenioWindow::MessageReceived(BMessage* message)
 				_HandleConfigurationChanged(message);
 			} else if (code == kMsgProjectSettingsUpdated) {
 				BString key(message->GetString("key", ""));
-				if (key.IsEmpty())
+				// the build history is saved by the project built, which
+				// may not be the active one
+				if (key.IsEmpty() || key == "build_history")
 					break;
 				// Update debug/release
 				_UpdateProjectActivation(fActiveProject != nullptr);
@@ -328,6 +369,15 @@ GenioWindow::MessageReceived(BMessage* message)
 						}
 					}
 				}
+				if (fActiveProject == nullptr)
+					break;
+				if (key == "ignore_patterns") {
+					// read the project again, watching only what is not ignored
+					fProjectsFolderBrowser->ProjectFolderDepopulate(fActiveProject);
+					fActiveProject->UpdateIgnoreList();
+					fActiveProject->Snapshot().MakeEmpty();
+					fProjectsFolderBrowser->ProjectFolderPopulate(fActiveProject);
+				}
 				// Save project settings
 				fActiveProject->SaveSettings();
 			}
@@ -347,6 +397,15 @@ GenioWindow::MessageReceived(BMessage* message)
 			}
 			break;
 		}
+		case CONSOLEIOTHREAD_DIAGNOSTICS:
+			fProblemsPanel->AddBuildProblems(message);
+			break;
+		case CONSOLEIOTHREAD_BUILD_PROFILE:
+			_ReportBuildProfile(message);
+			break;
+		case MSG_CONSOLE_SESSION_CLOSE:
+			_CloseConsoleSession(message);
+			break;
 		case EDITOR_UPDATE_DIAGNOSTICS:
 		{
 			entry_ref ref;
@@ -425,7 +484,9 @@ GenioWindow::MessageReceived(BMessage* message)
 
 				fActiveProject->SetBuildingState(false);
 			}
-			_UpdateProjectActivation(fActiveProject != nullptr);
+			// other console sessions may still be building
+			_UpdateProjectActivation(fActiveProject != nullptr
+				&& !fActiveProject->IsBuilding());
 			break;
 		}
 		case EDITOR_FIND_SET_MARK:
@@ -750,31 +811,66 @@ GenioWindow::MessageReceived(BMessage* message)
 		}
 		case MSG_GIT_SWITCH_BRANCH:
 		{
-			try {
-				BString project_path = message->GetString("project_path", fActiveProject->Path().String());
-				Genio::Git::GitRepository repo(project_path.String());
-				BString new_branch = message->GetString("branch", nullptr);
-				if (new_branch != nullptr)
+			BString project_path = message->GetString("project_path", fActiveProject->Path().String());
+			BString new_branch = message->GetString("branch", nullptr);
+			if (new_branch.IsEmpty())
+				break;
+			status_t status = GitOperation::Run("git switch branch", project_path, BMessenger(this),
+				[new_branch](Genio::Git::GitRepository& repo, BMessage& result) {
 					repo.SwitchBranch(new_branch);
-			} catch (const Genio::Git::GitConflictException &ex) {
+				});
+			if (status != B_OK) {
 				BString message;
 				message << B_TRANSLATE("An error occurred while switching branch:")
 						<< " "
-						<< ex.Message();
-
+						<< (status == B_BUSY
+							? B_TRANSLATE("another git operation is running.") : strerror(status));
+				OKAlert("GitSwitchBranch", message, B_STOP_ALERT);
+			}
+			break;
+		}
+		case MSG_GIT_OPERATION_DONE:
+		{
+			ProjectFolder* project = fProjectsFolderBrowser->ProjectByPath(
+				message->GetString("path"));
+			if (project != nullptr && project->GetRepository() != nullptr)
+				project->GetRepository()->ForgetRefs();
+			// replaces the progress notification
+			const BString path = message->GetString("path");
+			int32 error;
+			if (message->FindInt32("error", &error) != B_OK) {
+				ShowNotification("Genio", path, path, B_TRANSLATE("Branch switched."));
+				break;
+			}
+			ShowNotification("Genio", path, path, B_TRANSLATE("Switching branch failed."),
+				B_ERROR_NOTIFICATION);
+			if (error == Genio::Git::CANCEL_CREDENTIALS)
+				break;
+			BString text;
+			text << B_TRANSLATE("An error occurred while switching branch:")
+					<< " "
+					<< message->GetString("message");
+			if (message->GetBool("conflict")) {
+				std::vector<BString> files;
+				BString file;
+				for (int32 i = 0; message->FindString("file", i, &file) == B_OK; i++)
+					files.push_back(file);
 				auto alert = new GitAlert(B_TRANSLATE("Conflicts"),
-											B_TRANSLATE(message), ex.GetFiles());
+											B_TRANSLATE(text), files);
 				alert->Go();
-			} catch (const Genio::Git::GitException &ex) {
-				BString message;
-				message << B_TRANSLATE("An error occurred while switching branch:")
-						<< " "
-						<< ex.Message();
-
-				OKAlert("GitSwitchBranch", message, B_STOP_ALERT);
+			} else {
+				OKAlert("GitSwitchBranch", text, B_STOP_ALERT);
 			}
 			break;
 		}
+		case MSG_GIT_OPERATION_PROGRESS:
+		{
+			const BString path = message->GetString("path");
+			const uint64 total = message->GetUInt64("total", 0);
+			ProgressNotification("Genio", path, path, message->GetString("stage"),
+				total > 0 ? (float)message->GetUInt64("current", 0) / total : 0.0f);
+			break;
+		}
 		case GTLW_GO:
 			_ForwardToSelectedEditor(message);
 			break;
@@ -784,6 +880,13 @@ GenioWindow::MessageReceived(BMessage* message)
 			}
 			fGoToLineWindow->ShowCentered(Frame());
 			break;
+		case MSG_QUICK_OPEN:
+			if (fQuickOpenWindow == nullptr) {
+				fQuickOpenWindow = new QuickOpenWindow(this,
+					fProjectsFolderBrowser->GetFileCatalog());
+			}
+			fQuickOpenWindow->ShowCentered(Frame());
+			break;
 		case MSG_WHITE_SPACES_TOGGLE:
 			gCFG["show_white_space"] = !gCFG["show_white_space"];
 			break;
@@ -1437,6 +1540,8 @@ GenioWindow::QuitRequested()
 			projects.AddString("project_to_reopen", project->Path());
 			if (project->Active())
 				projects.SetString("active_project", project->Path());
+			// saves the tree snapshot too, for a fast reopen
+			project->Close();
 			// Avoiding leaks
 			//TODO:---> _ProjectOutlineDepopulate(project);
 			delete project;
@@ -1449,6 +1554,11 @@ GenioWindow::QuitRequested()
 		fGoToLineWindow->Quit();
 	}
 
+	if (fQuickOpenWindow != nullptr) {
+		fQuickOpenWindow->LockLooper();
+		fQuickOpenWindow->Quit();
+	}
+
 	be_app->PostMessage(B_QUIT_REQUESTED);
 	return true;
 }
@@ -1512,6 +1622,7 @@ GenioWindow::_BuildProject()
 	_UpdateProjectActivation(false);
 
 	fBuildLogView->Clear();
+	fProblemsPanel->ClearBuildProblems();
 	_ShowLog(kBuildLog);
 
 	LogInfoF("Build started: [%s]", fActiveProject->Name().String());
@@ -1522,17 +1633,92 @@ GenioWindow::_BuildProject()
 	claim << (fActiveProject->GetBuildMode() == BuildMode::ReleaseMode ? B_TRANSLATE("Release") : B_TRANSLATE("Debug"));
 	claim << ")";
 
+	// the console thread injects the parallelism chosen for this project
+	// and build mode: measuring the idle cores takes a while
 	GMessage message = {{"cmd", command},
+						{"build_jobs", fActiveProject->GetBuildJobs()},
 						{"cmd_type", "build"},
+						{"cwd", fActiveProject->Path()},
+						{"parse_diagnostics", true},
+						{"profile_build", true},
+						{"project_path", fActiveProject->Path()},
 						{"banner_claim", claim }};
 
-	// Go to appropriate directory
-	chdir(fActiveProject->Path());
-
 	return fBuildLogView->RunCommand(&message);
 }
 
 
+// Appends the timing breakdown of the build to the build log, compared with
+// the previous build of the project, and stores it in the project history.
+// The project is the one built, which may no longer be the active one.
+void
+GenioWindow::_ReportBuildProfile(const BMessage* profile)
+{
+	ProjectFolder* project = fProjectsFolderBrowser->ProjectByPath(
+		profile->GetString("project_path", ""));
+	if (project == nullptr)
+		return;
+
+	const BMessage history = project->BuildHistory();
+	int32 count = 0;
+	history.GetInfo("build", nullptr, &count);
+	BMessage previous;
+	const bool hasPrevious = history.FindMessage("build", count - 1, &previous) == B_OK;
+	const bool succeeded = profile->GetBool("succeeded", false);
+
+	BString line;
+	const int64 duration = profile->GetInt64("duration", 0);
+	BString report("\n *** ");
+	if (hasPrevious) {
+		line.SetToFormat(B_TRANSLATE("Build time: %s (previous: %s)"),
+			FormatSeconds(duration).String(),
+			FormatSeconds(previous.GetInt64("duration", 0)).String());
+	} else
+		line.SetToFormat(B_TRANSLATE("Build time: %s"), FormatSeconds(duration).String());
+	report << line << "\n";
+	if (!succeeded) {
+		report << " *** "
+			<< B_TRANSLATE("The build did not succeed: it is not kept in the history.") << "\n";
+	}
+
+	// steps are timed from one announced step to the next: with parallel
+	// jobs that is not how long each compile or link takes
+	line.SetToFormat(B_TRANSLATE("Time between announced steps: compile %s in %d steps, "
+		"link %s in %d steps"),
+		FormatSeconds(profile->GetInt64("compile_time", 0)).String(),
+		(int)profile->GetInt32("compile_count", 0),
+		FormatSeconds(profile->GetInt64("link_time", 0)).String(),
+		(int)profile->GetInt32("link_count", 0));
+	report << " *** " << line << "\n";
+
+	BMessage step;
+	for (int32 i = 0; profile->FindMessage("step", i, &step) == B_OK; i++) {
+		const BString name = step.GetString("name", "");
+		const int64 stepDuration = step.GetInt64("duration", 0);
+		line.SetToFormat(" *** %10s  %-8s %s", FormatSeconds(stepDuration).String(),
+			step.GetString("kind", ""), name.String());
+
+		// the same step in the previous build, if it was among the slowest
+		BMessage previousStep;
+		for (int32 j = 0; previous.FindMessage("step", j, &previousStep) == B_OK; j++) {
+			if (name != previousStep.GetString("name", ""))
+				continue;
+			const int64 delta = stepDuration - previousStep.GetInt64("duration", 0);
+			line << "  (" << (delta >= 0 ? "+" : "-")
+				<< FormatSeconds(delta >= 0 ? delta : -delta) << ")";
+			break;
+		}
+		report << line << "\n";
+	}
+
+	fBuildLogView->ConsoleOutputReceived(1, report);
+	if (succeeded) {
+		project->AddBuildProfile(*profile);
+		project->SaveSettings();
+	}
+}
+
+
 status_t
 GenioWindow::_CleanProject()
 {
@@ -1556,6 +1742,7 @@ GenioWindow::_CleanProject()
 	_UpdateProjectActivation(false);
 
 	fBuildLogView->Clear();
+	fProblemsPanel->ClearBuildProblems();
 	_ShowLog(kBuildLog);
 
 	LogInfoF("Clean started: [%s]", fActiveProject->Name().String());
@@ -1574,11 +1761,10 @@ GenioWindow::_CleanProject()
 
 	GMessage message = {{"cmd", command},
 						{"cmd_type", "build"},
+						{"cwd", fActiveProject->Path()},
+						{"parse_diagnostics", true},
 						{"banner_claim", claim }};
 
-	// Go to appropriate directory
-	chdir(fActiveProject->Path());
-
 	return fBuildLogView->RunCommand(&message);
 }
 
@@ -1683,6 +1869,8 @@ GenioWindow::_FileOpen(BMessage* msg)
 		BEntry entry(&ref);
 		if (entry.Exists() == false)
 			continue;
+		// ranks it higher in the quick open window
+		fProjectsFolderBrowser->GetFileCatalog()->FileOpened(BPath(&ref).Path());
 		// first let's see if it's already opened.
 		const int32 openedIndex = _GetEditorIndex(&ref);
 		if (openedIndex != -1) {
@@ -2046,8 +2234,30 @@ GenioWindow::_FindInFiles()
 	grepCommand += " ";
 	grepCommand += EscapeQuotesWrap(fActiveProject->Path());
 
+	// Open editors are searched in memory, so unsaved changes are found
+	// at their current line numbers. They skip the folders grep skips.
+	BString projectPath(fActiveProject->Path());
+	if (!projectPath.EndsWith("/"))
+		projectPath.Append("/");
+
+	BMessage bufferResults;
+	for (int32 index = 0; index < fTabManager->CountTabs(); index++) {
+		Editor* editor = fTabManager->EditorAt(index);
+		if (editor == nullptr || !editor->FilePath().StartsWith(projectPath))
+			continue;
+		const BString relativePath(editor->FilePath().String() + projectPath.Length());
+		if (IsInExcludedFolder(relativePath, excludeDir))
+			continue;
+		BMessage result(MSG_REPORT_RESULT);
+		result.AddString("filename", editor->FilePath());
+		editor->FindInBuffer(fFindTextControl->Text(),
+			(bool)fFindCaseSensitiveCheck->Value(),
+			(bool)fFindWholeWordCheck->Value(), &result);
+		bufferResults.AddMessage("result", &result);
+	}
+
 	LogInfo("Find in file, executing: [%s]", grepCommand.String());
-	fSearchResultPanel->StartSearch(grepCommand, fActiveProject->Path());
+	fSearchResultPanel->StartSearch(grepCommand, fActiveProject->Path(), &bufferResults);
 
 	_ShowLog(kSearchResult);
 	_UpdateFindMenuItems(fFindTextControl->Text());
@@ -2099,11 +2309,9 @@ GenioWindow::_Git(const BString& git_command)
 	if (fActiveProject == nullptr)
 		return B_ERROR;
 
-	// Pretend building or running
-	_UpdateProjectActivation(false);
-
-	fConsoleIOView->Clear();
-	_ShowLog(kOutputLog);
+	ConsoleIOView* console = _ConsoleSession();
+	console->Clear();
+	_ShowLog(console);
 
 	BString command;
 	command	<< "git " << git_command;
@@ -2111,11 +2319,9 @@ GenioWindow::_Git(const BString& git_command)
 	BMessage message;
 	message.AddString("cmd", command);
 	message.AddString("cmd_type", command);
+	message.AddString("cwd", fActiveProject->Path());
 
-	// Go to appropriate directory
-	chdir(fActiveProject->Path());
-
-	return fConsoleIOView->RunCommand(&message);
+	return console->RunCommand(&message);
 }
 
 
@@ -2528,6 +2734,10 @@ GenioWindow::_InitActions()
 								   B_TRANSLATE("Open" B_UTF8_ELLIPSIS),
 								   "", "", 'O');
 
+	ActionManager::RegisterAction(MSG_QUICK_OPEN,
+								   B_TRANSLATE("Quick open" B_UTF8_ELLIPSIS),
+								   "", "", 'P');
+
 	ActionManager::RegisterAction(MSG_FILE_NEW,
 								   B_TRANSLATE("New"),
 								   "", "");
@@ -2806,6 +3016,7 @@ GenioWindow::_InitMenu()
 			TemplatesMenu::SHOW_ALL_VIEW_MODE,	true));
 
 	ActionManager::AddItem(MSG_FILE_OPEN,     fileMenu);
+	ActionManager::AddItem(MSG_QUICK_OPEN,    fileMenu);
 
 	fileMenu->AddItem(new BMenuItem(BRecentFilesList::NewFileListMenu(
 			B_TRANSLATE("Open recent" B_UTF8_ELLIPSIS), nullptr, nullptr, this,
@@ -3248,9 +3459,7 @@ GenioWindow::_MakeBindcatalogs()
 	BMessage message;
 	message.AddString("cmd", "make bindcatalogs");
 	message.AddString("cmd_type", "bindcatalogs");
-
-	// Go to appropriate directory
-	chdir(fActiveProject->Path());
+	message.AddString("cwd", fActiveProject->Path());
 
 	fBuildLogView->RunCommand(&message);
 }
@@ -3269,9 +3478,7 @@ GenioWindow::_MakeCatkeys()
 	BMessage message;
 	message.AddString("cmd", "make catkeys");
 	message.AddString("cmd_type", "catkeys");
-
-	// Go to appropriate directory
-	chdir(fActiveProject->Path());
+	message.AddString("cwd", fActiveProject->Path());
 
 	fBuildLogView->RunCommand(&message);
 }
@@ -3748,19 +3955,19 @@ GenioWindow::_ReplaceGroupShow(bool show)
 status_t
 GenioWindow::_RunInConsole(const BString& command)
 {
-	// If no active project go to projects directory
-	if (fActiveProject == nullptr)
-		chdir(gCFG["projects_directory"]);
-	else
-		chdir(fActiveProject->Path());
-
-	_ShowLog(kOutputLog);
+	ConsoleIOView* console = _ConsoleSession();
+	_ShowLog(console);
 
 	BMessage message;
 	message.AddString("cmd", command);
 	message.AddString("cmd_type", command);
+	// If no active project run in the projects directory
+	if (fActiveProject == nullptr)
+		message.AddString("cwd", (const char*)gCFG["projects_directory"]);
+	else
+		message.AddString("cwd", fActiveProject->Path());
 
-	return fConsoleIOView->RunCommand(&message);
+	return console->RunCommand(&message);
 }
 
 
@@ -3784,10 +3991,9 @@ GenioWindow::_RunTarget()
 	// Differentiate terminal projects from window ones
 	if (fActiveProject->RunInTerminal() == true) {
 		// Don't do that in graphical mode
-		_UpdateProjectActivation(false);
-
-		fConsoleIOView->Clear();
-		_ShowLog(kOutputLog);
+		ConsoleIOView* console = _ConsoleSession();
+		console->Clear();
+		_ShowLog(console);
 
 		BString command;
 		if ((bool)gCFG["run_without_buffering"]) {
@@ -3796,8 +4002,6 @@ GenioWindow::_RunTarget()
 		command << fActiveProject->GetTarget();
 		if (!args.IsEmpty())
 			command << " " << args;
-		// TODO: Go to appropriate directory
-		// chdir(...);
 
 		BString claim("Run ");
 		claim << fActiveProject->Name();
@@ -3806,12 +4010,13 @@ GenioWindow::_RunTarget()
 		claim << ")";
 
 		GMessage message = {{"cmd", command},
-							{"cmd_type", "build"},
+							{"cmd_type", "run"},
+							{"cwd", fActiveProject->Path()},
 							{"banner_claim", claim }};
 
-		fConsoleIOView->MakeFocus(true);
+		console->MakeFocus(true);
 
-		fConsoleIOView->RunCommand(&message);
+		console->RunCommand(&message);
 
 	} else {
 		argv_split parser(fActiveProject->GetTarget().String());
@@ -3841,6 +4046,72 @@ GenioWindow::_ShowLog(int32 index)
 }
 
 
+void
+GenioWindow::_ShowLog(BView* view)
+{
+	for (int32 index = 0; index < fOutputTabView->CountTabs(); index++) {
+		if (fOutputTabView->ViewForTab(index) == view) {
+			_ShowLog(index);
+			break;
+		}
+	}
+}
+
+
+// Returns an idle Console I/O view: the main one if it is free, otherwise
+// an idle extra session or a new session tab. Each session has its own
+// ConsoleIOThread, output buffer and Stop button, so commands run
+// independently of each other and of the build log.
+ConsoleIOView*
+GenioWindow::_ConsoleSession()
+{
+	if (!fConsoleIOView->IsRunning())
+		return fConsoleIOView;
+
+	for (int32 i = 0; i < fConsoleSessions.CountItems(); i++) {
+		ConsoleIOView* session = fConsoleSessions.ItemAt(i);
+		if (!session->IsRunning())
+			return session;
+	}
+
+	// the lowest number free since a session was closed
+	BString label;
+	for (int32 number = 2; ; number++) {
+		label.SetToFormat(B_TRANSLATE("Console I/O %d"), (int)number);
+		bool used = false;
+		for (int32 i = 0; i < fConsoleSessions.CountItems() && !used; i++)
+			used = label == fConsoleSessions.ItemAt(i)->Name();
+		if (!used)
+			break;
+	}
+	ConsoleIOView* session = new ConsoleIOView(label, BMessenger(this), true);
+	fConsoleSessions.AddItem(session);
+	fOutputTabView->AddTab(session);
+	return session;
+}
+
+
+// Extra sessions are closed from their Close button
+void
+GenioWindow::_CloseConsoleSession(BMessage* message)
+{
+	ConsoleIOView* session = nullptr;
+	if (message->FindPointer("view", (void**)&session) != B_OK
+		|| !fConsoleSessions.HasItem(session)) {
+		return;
+	}
+
+	for (int32 index = 0; index < fOutputTabView->CountTabs(); index++) {
+		if (fOutputTabView->ViewForTab(index) == session) {
+			fConsoleSessions.RemoveItem(session);
+			// the tab deletes its view
+			delete fOutputTabView->RemoveTab(index);
+			break;
+		}
+	}
+}
+
+
 void
 GenioWindow::_UpdateFindMenuItems(const BString& text)
 {
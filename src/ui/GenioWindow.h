@@ -47,6 +47,7 @@ class GoToLineWindow;
 class ProblemsPanel;
 class ProjectFolder;
 class ProjectsFolderBrowser;
+class QuickOpenWindow;
 class SearchResultPanel;
 class SourceControlPanel;
 class TemplatesMenu;
@@ -72,6 +73,7 @@ private:
 
 			status_t			_BuildProject();
 			status_t			_CleanProject();
+			void				_ReportBuildProfile(const BMessage* profile);
 
 			status_t			_DebugProject();
 			bool				_FileRequestClose(int32 index);
@@ -135,6 +137,9 @@ private:
 			void				_RunTarget();
 			void				_SetMakefileBuildMode();
 			void				_ShowLog(int32 index);
+			void				_ShowLog(BView* view);
+			ConsoleIOView*		_ConsoleSession();
+			void				_CloseConsoleSession(BMessage* message);
 			void				_UpdateFindMenuItems(const BString& text);
 			status_t			_UpdateLabel(int32 index, bool isModified);
 			void				_UpdateProjectActivation(bool active);
@@ -229,7 +234,10 @@ private:
 			ProblemsPanel*		fProblemsPanel;
 			ConsoleIOView*		fBuildLogView;
 			ConsoleIOView*		fConsoleIOView;
+			// extra Console I/O tabs, for commands run concurrently
+			BObjectList<ConsoleIOView>	fConsoleSessions;
 			GoToLineWindow*		fGoToLineWindow;
+			QuickOpenWindow*	fQuickOpenWindow;
 			SearchResultPanel*	fSearchResultPanel;
 
 			scree_mode			fScreenMode;
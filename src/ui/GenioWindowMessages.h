@@ -71,6 +71,7 @@ enum {
 	MSG_REPLACE_PREVIOUS		= 'repr',
 	MSG_REPLACE_ALL				= 'real',
 	MSG_GOTO_LINE				= 'goli',
+	MSG_QUICK_OPEN				= 'quop',
 	MSG_BOOKMARK_CLEAR_ALL		= 'bcal',
 	MSG_BOOKMARK_GOTO_NEXT		= 'bgne',
 	MSG_BOOKMARK_GOTO_PREVIOUS	= 'bgpr',
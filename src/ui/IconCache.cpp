@@ -7,9 +7,12 @@
 
 #include <Bitmap.h>
 #include <ControlLook.h>
+#include <MimeType.h>
 #include <MimeTypes.h>
 #include <NodeInfo.h>
 
+#include <cctype>
+
 #include "Log.h"
 
 
@@ -27,12 +30,13 @@ IconCache::GetIcon(const entry_ref *ref)
 	BNodeInfo nodeInfo(&node);
 	char mimeType[B_MIME_TYPE_LENGTH];
 	mimeType[0] = '\0';
-	if (nodeInfo.GetType(mimeType) != B_OK) {
+	bool typed = nodeInfo.GetType(mimeType) == B_OK;
+	if (!typed) {
 		LogDebug("Invalid mimeType for file [%s]", ref->name);
 		if (node.IsDirectory())
 			strncpy(mimeType, B_DIRECTORY_MIME_TYPE, B_MIME_TYPE_LENGTH - 1);
 		else
-			strncpy(mimeType, B_FILE_MIME_TYPE, B_MIME_TYPE_LENGTH - 1);
+			_TypeForName(ref->name, mimeType);
 	}
 
 	LogTrace("IconCache: [%s] - [%s]", mimeType, ref->name);
@@ -47,9 +51,13 @@ IconCache::GetIcon(const entry_ref *ref)
 		BRect rect(0, 0, composedSize.IntegerWidth() - 1, composedSize.IntegerHeight() - 1);
 		BBitmap *icon = new BBitmap(rect, B_RGBA32);
 		icon_size iconSize = (icon_size)(icon->Bounds().IntegerWidth() - 1);
-		status_t status = nodeInfo.GetTrackerIcon(icon, (icon_size)iconSize);
+		// a guessed type must not cache the generic icon of an untyped node
+		if (typed || node.IsDirectory()) {
+			status_t status = nodeInfo.GetTrackerIcon(icon, (icon_size)iconSize);
+			LogTrace("IconCache: GetTrackerIcon returned - %s", ::strerror(status));
+		} else
+			_GetTypeIcon(mimeType, icon, iconSize);
 		sInstance.fCache.emplace(mimeType, icon);
-		LogTrace("IconCache: GetTrackerIcon returned - %s", ::strerror(status));
 		return icon;
 	}
 	return nullptr;
@@ -66,6 +74,46 @@ IconCache::GetIcon(const BString& path)
 }
 
 
+// Files are typed by update_mime_info(), which may not have run yet:
+// guess the type from the name, once per extension (or per name, for
+// files like "Makefile" without one).
+/* static */
+void
+IconCache::_TypeForName(const char* name, char* mimeType)
+{
+	const char* dot = strrchr(name, '.');
+	std::string extension = dot != nullptr && dot != name ? dot : name;
+	for (char& c : extension)
+		c = tolower(c);
+
+	auto it = sInstance.fExtensionTypes.find(extension);
+	if (it == sInstance.fExtensionTypes.end()) {
+		BMimeType type;
+		if (BMimeType::GuessMimeType(name, &type) != B_OK || !type.IsValid())
+			type.SetTo(B_FILE_MIME_TYPE);
+		it = sInstance.fExtensionTypes.emplace(extension, type.Type()).first;
+	}
+	strlcpy(mimeType, it->second.c_str(), B_MIME_TYPE_LENGTH);
+}
+
+
+// The icon of the type, of its supertype or the generic file icon
+/* static */
+void
+IconCache::_GetTypeIcon(const char* mimeType, BBitmap* icon, icon_size iconSize)
+{
+	BMimeType type(mimeType);
+	if (type.GetIcon(icon, iconSize) == B_OK)
+		return;
+
+	BMimeType superType;
+	if (type.GetSupertype(&superType) == B_OK && superType.GetIcon(icon, iconSize) == B_OK)
+		return;
+
+	BMimeType(B_FILE_MIME_TYPE).GetIcon(icon, iconSize);
+}
+
+
 void
 IconCache::PrintToStream()
 {
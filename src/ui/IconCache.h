@@ -8,6 +8,7 @@
 #include <string>
 #include <unordered_map>
 
+#include <Mime.h>
 #include <String.h>
 
 struct entry_ref;
@@ -18,6 +19,7 @@ public:
 	IconCache(IconCache const&) = delete;
 	void operator=(IconCache const&) = delete;
 
+	// Opens the node to read its type: call once per item and keep the result
 	static const BBitmap* GetIcon(const entry_ref *ref);
 	static const BBitmap* GetIcon(const BString& path);
 	static void 	PrintToStream();
@@ -25,7 +27,14 @@ public:
 private:
 	IconCache();
 
+	static void		_TypeForName(const char* name, char* mimeType);
+	static void		_GetTypeIcon(const char* mimeType, BBitmap* icon,
+						icon_size iconSize);
+
+	// icons by MIME type
 	std::unordered_map<std::string, BBitmap*> fCache;
+	// MIME types guessed for untyped files, by extension
+	std::unordered_map<std::string, std::string> fExtensionTypes;
 
 	static IconCache sInstance;
 };
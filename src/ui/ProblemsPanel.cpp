@@ -30,10 +30,11 @@ enum {
 
 class RangeRow : public BRow {
 	public:
-		RangeRow(){};
+		RangeRow(bool build = false): fBuild(build) {};
 
 		BMessage	fRange;
-
+		// build diagnostics stay when the editor diagnostics change
+		bool		fBuild;
 };
 
 #define ProblemLabel B_TRANSLATE("Problems")
@@ -114,7 +115,7 @@ ProblemsPanel::MessageReceived(BMessage* msg)
 void
 ProblemsPanel::UpdateProblems(BMessage* msg)
 {
-	Clear();
+	_RemoveRows(false);
 	BMessage dia;
 	int32 index = 0;
 	entry_ref ref;
@@ -136,10 +137,49 @@ ProblemsPanel::UpdateProblems(BMessage* msg)
 void
 ProblemsPanel::ClearProblems()
 {
-	Clear();
+	_RemoveRows(false);
 	_UpdateTabLabel();
 }
 
+
+// Diagnostics parsed from the build output, added while the build runs
+void
+ProblemsPanel::AddBuildProblems(BMessage* msg)
+{
+	BMessage dia;
+	int32 index = 0;
+	while (msg->FindMessage("diagnostic", index++, &dia) == B_OK) {
+		RangeRow* row = new RangeRow(true);
+		row->fRange = dia;
+		row->SetField(new BStringField(dia.GetString("category","")), kCategoryColumn);
+		row->SetField(new BStringField(dia.GetString("message","")), kMessageColumn);
+		row->SetField(new BStringField(dia.GetString("source","")), kSourceColumn);
+		AddRow(row);
+	}
+	_UpdateTabLabel();
+}
+
+
+void
+ProblemsPanel::ClearBuildProblems()
+{
+	_RemoveRows(true);
+	_UpdateTabLabel();
+}
+
+
+void
+ProblemsPanel::_RemoveRows(bool build)
+{
+	for (int32 i = CountRows() - 1; i >= 0; i--) {
+		RangeRow* row = dynamic_cast<RangeRow*>(RowAt(i));
+		if (row != nullptr && row->fBuild == build) {
+			RemoveRow(row);
+			delete row;
+		}
+	}
+}
+
 void
 ProblemsPanel::_UpdateTabLabel()
 {
@@ -24,8 +24,12 @@ public:
 
 		void ClearProblems();
 
+		void AddBuildProblems(BMessage* msg);
+		void ClearBuildProblems();
+
 private:
 		void	_UpdateTabLabel();
+		void	_RemoveRows(bool build);
 		BTabView* fTabView;
 		BPopUpMenu* fPopUpMenu;
 		BMenuItem*  fQuickFixItem;
@@ -12,6 +12,10 @@
 #include "Log.h"
 #include "ProjectFolder.h"
 #include "ProjectItem.h"
+#include "FileCatalog.h"
+#include "GitStatusService.h"
+#include "MimeTypeUpdater.h"
+#include "ProjectScanner.h"
 #include "SwitchBranchMenu.h"
 #include "TemplateManager.h"
 #include "Utils.h"
@@ -25,22 +29,33 @@
 #include <MenuItem.h>
 #include <Mime.h>
 #include <NaturalCompare.h>
+#include <Node.h>
 #include <Path.h>
 #include <PopUpMenu.h>
 #include <Window.h>
 #include <MessageRunner.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "ProjectsFolderBrowser"
 
+// how long path monitor events are collected before being applied
+static const bigtime_t kPathEventsInterval = 100000; // 100 ms
+// an entry removed and created again, maybe as a folder instead of a file
+static const int32 kEntryReplaced = 'PEre';
+
 
 ProjectsFolderBrowser::ProjectsFolderBrowser()
 	: BOutlineListView("ProjectsFolderOutline", B_SINGLE_SELECTION_LIST)
+	, fScanners(4, true)
+	, fMimeTypeUpdaters(4, true)
+	, fPathEventsPending(false)
 {
 	fGenioWatchingFilter = new GenioWatchingFilter();
+	fFileCatalog = new FileCatalog();
 	SetInvocationMessage(new BMessage(MSG_PROJECT_MENU_OPEN_FILE));
 	BPrivate::BPathMonitor::SetWatchingInterface(fGenioWatchingFilter);
 }
@@ -50,227 +65,511 @@ ProjectsFolderBrowser::~ProjectsFolderBrowser()
 {
 	BPrivate::BPathMonitor::SetWatchingInterface(nullptr);
 	delete fGenioWatchingFilter;
+	delete fFileCatalog;
 }
 
 
-ProjectItem*
-ProjectsFolderBrowser::_CreateNewProjectItem(ProjectItem* parentItem, BPath path)
+// Path monitor events are not applied one by one: they are queued for
+// kPathEventsInterval and merged, so that creating and removing an entry
+// cancel out and a chain of moves becomes a single one. A merged event
+// happened when its last part did: it goes to the end of the queue, past
+// the events queued meanwhile, and may merge again there.
+void
+ProjectsFolderBrowser::_QueuePathEvent(BMessage* message)
 {
-	ProjectFolder *projectFolder = parentItem->GetSourceItem()->GetProjectFolder();
-	SourceItem *sourceItem = new SourceItem(path.Path());
-	sourceItem->SetProjectFolder(projectFolder);
-	return new ProjectItem(sourceItem);
-}
-
+	path_event event;
+	if (message->FindInt32("opcode", &event.opcode) != B_OK)
+		return;
 
-ProjectItem*
-ProjectsFolderBrowser::_CreatePath(BPath pathToCreate)
-{
-	LogTrace("Create path for %s", pathToCreate.Path());
-	ProjectItem *item = GetProjectItemByPath(pathToCreate.Path());
-
-	if (!item) {
-		LogTrace("Can't find path %s", pathToCreate.Path());
-		BPath parent;
-		if (pathToCreate.GetParent(&parent) == B_OK) {
-			ProjectItem* parentItem = _CreatePath(parent);
-			LogTrace("Creating path %s", pathToCreate.Path());
-			ProjectItem* newItem = _CreateNewProjectItem(parentItem, pathToCreate);
-
-			if (AddUnder(newItem,parentItem)) {
-				LogDebugF("AddUnder(%s,%s) (Parent %s)", newItem->Text(), parentItem->Text(), parent.Path());
-				SortItemsUnder(parentItem, true, ProjectsFolderBrowser::_CompareProjectItems);
-				Collapse(newItem);
+	switch (event.opcode) {
+		case B_ENTRY_CREATED:
+		case B_ENTRY_REMOVED:
+			if (message->FindString("path", &event.path) != B_OK)
+				return;
+			break;
+		case B_ENTRY_MOVED:
+			if (message->GetBool("removed", false)) {
+				// moved outside of the project folder
+				event.opcode = B_ENTRY_REMOVED;
+				if (message->FindString("from path", &event.path) != B_OK)
+					return;
+				event.message = *message;
+			} else if (message->GetBool("added", false)) {
+				// moved inside the project folder
+				event.opcode = B_ENTRY_CREATED;
+				if (message->FindString("path", &event.path) != B_OK)
+					return;
+			} else if (message->FindString("from path", &event.fromPath) != B_OK
+				|| message->FindString("path", &event.path) != B_OK) {
+				return;
 			}
-			return newItem;
-		}
+			break;
+		default:
+			return;
+	}
+
+	_QueueRepositoryChange(event.path);
+	if (!event.fromPath.IsEmpty())
+		_QueueRepositoryChange(event.fromPath);
+
+	for (;;) {
+		const std::string key = event.opcode == B_ENTRY_MOVED
+			? event.fromPath.String() : event.path.String();
+		auto last = fPathEventIndex.find(key);
+		if (last == fPathEventIndex.end())
+			break;
+		path_event& previous = fPathEvents[last->second];
+		fPathEventIndex.erase(last);
+		path_event merged = previous;
+		if (!_MergePathEvent(merged, event))
+			break;
+		previous.opcode = 0;
+		if (merged.opcode == 0)
+			return;
+		event = merged;
+	}
+
+	fPathEventIndex[event.path.String()] = fPathEvents.size();
+	fPathEvents.push_back(event);
+
+	if (!fPathEventsPending) {
+		fPathEventsPending = true;
+		BMessage flush(MSG_APPLY_PATH_EVENTS);
+		BMessageRunner::StartSending(BMessenger(this), &flush, kPathEventsInterval, 1);
 	}
-	LogTrace("Found path [%s]", pathToCreate.Path());
-	return item;
 }
 
 
+// git rewrites HEAD and the index through a lock file renamed over them:
+// that is the only time the cached branch and state may change.
+// Loose refs and packed-refs are watched too, for the cached branches and
+// tags of the repository.
 void
-ProjectsFolderBrowser::_UpdateNode(BMessage* message)
+ProjectsFolderBrowser::_QueueRepositoryChange(const BString& path)
 {
-	int32 opCode;
-	if (message->FindInt32("opcode", &opCode) != B_OK)
+	const int32 gitFolder = path.FindLast("/.git/");
+	if (gitFolder < 0)
 		return;
-	BString watchedPath;
-	if (message->FindString("watched_path", &watchedPath) != B_OK)
+
+	const BString gitPath(path.String(), gitFolder + 6);
+	const char* gitEntry = path.String() + gitFolder + 6;
+	const bool headOrIndex = strcmp(gitEntry, "HEAD") == 0 || strcmp(gitEntry, "index") == 0;
+	const bool refs = strcmp(gitEntry, "HEAD") == 0 || strcmp(gitEntry, "packed-refs") == 0
+		|| strncmp(gitEntry, "refs/", 5) == 0 || strcmp(gitEntry, "refs") == 0;
+	if (!headOrIndex && !refs)
 		return;
-	switch (opCode) {
+
+	for (int32 i = 0; i < fProjectList.CountItems(); i++) {
+		ProjectFolder* project = fProjectList.ItemAt(i);
+		BString projectGitPath(project->Path());
+		projectGitPath << "/.git/";
+		if (gitPath != projectGitPath)
+			continue;
+		if (refs && project->GetRepository() != nullptr)
+			project->GetRepository()->ForgetRefs();
+		if (headOrIndex)
+			fRepositoryChanges.insert(project);
+	}
+}
+
+
+// Folds event into previous, the last event touching the same path.
+// A merged event which cancels out gets opcode 0.
+/* static */
+bool
+ProjectsFolderBrowser::_MergePathEvent(path_event& previous, const path_event& event)
+{
+	switch (event.opcode) {
 		case B_ENTRY_CREATED:
-		{
-			BString spath;
-			if (message->FindString("path", &spath) == B_OK) {
-				BPath path(spath.String());
-				_CreatePath(path);
+			// removed and created again: the item may not fit the new entry
+			if (previous.opcode == B_ENTRY_REMOVED && previous.message.IsEmpty()) {
+				previous.opcode = kEntryReplaced;
+				return true;
 			}
 			break;
-		}
 		case B_ENTRY_REMOVED:
-		{
-			BString spath;
-			if (message->FindString("path", &spath) != B_OK)
-				break;
-
-			LogDebug("path %s", spath.String());
-			ProjectItem *item = GetProjectItemByPath(spath);
-			if (!item) {
-					LogError("Can't find an item to remove [%s]", spath.String());
-					return;
+			if (previous.opcode == B_ENTRY_CREATED) {
+				previous.opcode = 0;
+				return true;
 			}
-			if (item->GetSourceItem()->Type() == SourceItemType::ProjectFolderItem) {
-				if (LockLooper()) {
-					Select(IndexOf(item));
-					Window()->PostMessage(MSG_PROJECT_MENU_CLOSE);
-
-					// It seems not possible to track the project folder to the new
-					// location outside of the watched path. So we close the project
-					// and warn the user
-					auto alert = new BAlert("ProjectFolderChanged", B_TRANSLATE(
-						"The project folder has been deleted or moved to another location "
-						"and it will be closed and unloaded from the workspace."),
-						B_TRANSLATE("OK"), NULL, NULL,
-						B_WIDTH_AS_USUAL, B_OFFSET_SPACING, B_WARNING_ALERT);
-						alert->Go();
-
-					UnlockLooper();
-				}
-			} else {
-				RemoveItem(item);
-				SortItemsUnder(Superitem(item), true, ProjectsFolderBrowser::_CompareProjectItems);
+			if (previous.opcode == kEntryReplaced) {
+				previous.opcode = B_ENTRY_REMOVED;
+				previous.message = event.message;
+				return true;
+			}
+			if (previous.opcode == B_ENTRY_MOVED) {
+				previous.opcode = B_ENTRY_REMOVED;
+				previous.path = previous.fromPath;
+				previous.fromPath = "";
+				previous.message = event.message;
+				return true;
 			}
 			break;
-		}
 		case B_ENTRY_MOVED:
-		{
-			BString spath;
-			// An item moved outside of the project folder
-			if (message->GetBool("removed", false)) {
-				if (message->FindString("from path", &spath) == B_OK) {
-					LogDebug("from path %s",  spath.String());
-					ProjectItem *item = GetProjectItemByPath(spath);
-					if (!item) {
-						LogError("Can't find an item to move [%s]", spath.String());
-						return;
-					}
-					// the project folder is being renamed
-					if (item->GetSourceItem()->Type() == SourceItemType::ProjectFolderItem) {
-						if (LockLooper()) {
-							Select(IndexOf(item));
-							Window()->PostMessage(MSG_PROJECT_MENU_CLOSE);
-
-							auto alert = new BAlert("ProjectFolderChanged",
-							B_TRANSLATE("The project folder has been renamed. It will be closed and reopened automatically."),
-								B_TRANSLATE("OK"), NULL, NULL,
-								B_WIDTH_AS_USUAL, B_OFFSET_SPACING, B_WARNING_ALERT);
-							alert->Go();
-
-							// reopen project under the new name or location
-							entry_ref ref;
-							if (message->FindInt64("to directory", &ref.directory) == B_OK) {
-								const char *name;
-								message->FindInt32("device", &ref.device);
-								message->FindString("name", &name);
-								ref.set_name(name);
-								auto msg = new BMessage(MSG_PROJECT_FOLDER_OPEN);
-								msg->AddRef("refs", &ref);
-								Window()->PostMessage(msg);
-							}
-							UnlockLooper();
-						}
-					} else {
-						RemoveItem(item);
-						SortItemsUnder(Superitem(item), true, ProjectsFolderBrowser::_CompareProjectItems);
-					}
-				}
-			} else {
-				BString oldName, newName;
-				BString oldPath, newPath;
-				if (message->GetBool("added")) {
-					if (message->FindString("path", &newPath) == B_OK) {
-						if (message->FindString("name", &newName) == B_OK) {
-							const BPath destination(newPath);
-							BEntry newPathEntry(newPath);
-							if (newPathEntry.IsDirectory()) {
-								// a new folder moved inside the project.
-								//ensure we have a parent
-								BPath parent;
-								destination.GetParent(&parent);
-								ProjectItem *parentItem = _CreatePath(parent);
-								// recursive parsing!
-								entry_ref entryRef;
-								newPathEntry.GetRef(&entryRef);
-								_ProjectFolderScan(parentItem, &entryRef, parentItem->GetSourceItem()->GetProjectFolder());
-								SortItemsUnder(parentItem, false, ProjectsFolderBrowser::_CompareProjectItems);
-							} else {
-								//Plain file
-								_CreatePath(destination);
-							}
-						}
-					}
-				} else 	if (message->FindString("from name", &oldName) == B_OK) {
-					if (message->FindString("name", &newName) == B_OK) {
-						if (message->FindString("from path", &oldPath) == B_OK) {
-							if (message->FindString("path", &newPath) == B_OK) {
-								const BPath bp_oldPath(oldPath.String());
-								BPath bp_oldParent;
-								bp_oldPath.GetParent(&bp_oldParent);
-								const BPath bp_newPath(newPath.String());
-								BPath bp_newParent;
-								bp_newPath.GetParent(&bp_newParent);
-
-								// If the path remains the same except the leaf
-								// then the item is being RENAMED
-								// if the path changes then the item is being MOVED
-								if (bp_oldParent == bp_newParent) {
-									ProjectItem *item = GetProjectItemByPath(oldPath);
-									if (!item) {
-										LogError("Can't find an item to move oldPath[%s] -> newPath[%s]", oldPath.String(), newPath.String());
-										return;
-									}
-									entry_ref newRef;
-									if (get_ref_for_path(newPath, &newRef) == B_OK) {
-										item->SetText(newName);
-										item->GetSourceItem()->UpdateEntryRef(newRef);
-										SortItemsUnder(Superitem(item), true, ProjectsFolderBrowser::_CompareProjectItems);
-									} else {
-										LogError("Can't find ref for newPath[%s]", newPath.String());
-										return;
-									}
-								} else {
-									ProjectItem *item = GetProjectItemByPath(oldPath);
-									if (!item) {
-										LogError("Can't find an item to move oldPath [%s]", oldPath.String());
-										return;
-									}
-									ProjectItem *destinationItem = GetProjectItemByPath(bp_newParent.Path());
-									if (!item) {
-										LogError("Can't find an item to move newParent [%s]", bp_newParent.Path());
-										return;
-									}
-									bool status = RemoveItem(item);
-									if (status) {
-										SortItemsUnder(Superitem(item), true, ProjectsFolderBrowser::_CompareProjectItems);
-
-										ProjectItem *newItem = _CreateNewProjectItem(item, bp_newPath);
-										status = AddUnder(newItem, destinationItem);
-										if (status) {
-											SortItemsUnder(destinationItem, true, ProjectsFolderBrowser::_CompareProjectItems);
-										}
-									}
-								}
-							}
-						}
-					}
-				}
+			if (previous.opcode == B_ENTRY_CREATED) {
+				previous.path = event.path;
+				return true;
+			}
+			if (previous.opcode == B_ENTRY_MOVED) {
+				previous.path = event.path;
+				if (previous.path == previous.fromPath)
+					previous.opcode = 0;
+				return true;
 			}
 			break;
+	}
+	return false;
+}
+
+
+void
+ProjectsFolderBrowser::_ApplyPathEvents()
+{
+	fPathEventsPending = false;
+
+	// new items are inserted at the end, in one pass per parent
+	std::set<ProjectItem*> renamedParents;
+	for (const path_event& event : fPathEvents) {
+		switch (event.opcode) {
+			case B_ENTRY_CREATED:
+				fFileCatalog->PathCreated(event.path);
+				_RefreshGitStatus(event.path);
+				_MarkScanStale(event.path);
+				_PathCreated(event.path);
+				break;
+			case B_ENTRY_REMOVED:
+				fFileCatalog->PathRemoved(event.path);
+				_RefreshGitStatus(event.path);
+				_MarkScanStale(event.path);
+				_PathRemoved(event);
+				break;
+			case kEntryReplaced:
+				fFileCatalog->PathRemoved(event.path);
+				fFileCatalog->PathCreated(event.path);
+				_RefreshGitStatus(event.path);
+				_MarkScanStale(event.path);
+				_PathReplaced(event);
+				break;
+			case B_ENTRY_MOVED:
+				fFileCatalog->PathMoved(event.fromPath, event.path);
+				_RefreshGitStatus(event.fromPath);
+				_RefreshGitStatus(event.path);
+				_MarkScanStale(event.fromPath);
+				_MarkScanStale(event.path);
+				_PathMoved(event, renamedParents);
+				break;
+			default:
+				break;
 		}
-		default:
+	}
+	fPathEvents.clear();
+	fPathEventIndex.clear();
+
+	for (auto& insertion : fInsertions)
+		_InsertSorted(insertion.first, insertion.second);
+	fInsertions.clear();
+	fPendingItems.clear();
+
+	// a rename moves a single item among its siblings
+	for (ProjectItem* parent : renamedParents) {
+		if (GetProjectItemByRef(*parent->GetSourceItem()->EntryRef()) == parent)
+			SortItemsUnder(parent, true, ProjectsFolderBrowser::_CompareProjectItems);
+	}
+
+	for (ProjectFolder* project : fRepositoryChanges) {
+		if (!fProjectList.HasItem(project))
+			continue;
+		// staged, committed or checked out files
+		if (project->GitStatus() != nullptr)
+			project->GitStatus()->RefreshAll();
+		if (!project->UpdateRepositoryStatus())
+			continue;
+		ProjectItem* projectItem = GetProjectItemForProject(project);
+		if (projectItem != nullptr) {
+			projectItem->UpdateRepositoryStatus();
+			InvalidateItem(IndexOf(projectItem));
+		}
+	}
+	fRepositoryChanges.clear();
+
+	// folders created or removed change what is monitored
+	_UpdateMonitoringStatus();
+}
+
+
+void
+ProjectsFolderBrowser::_UpdateMonitoringStatus()
+{
+	for (int32 i = 0; i < fProjectProjectItemList.CountItems(); i++) {
+		ProjectItem* projectItem = fProjectProjectItemList.ItemAt(i);
+		int32 live;
+		int32 polled;
+		fGenioWatchingFilter->GetMonitoringStatus(
+			static_cast<ProjectFolder*>(projectItem->GetSourceItem())->Path(), live, polled);
+		if (projectItem->SetMonitoringStatus(live, polled)) {
+			const int32 index = IndexOf(projectItem);
+			if (index >= 0)
+				InvalidateItem(index);
+		}
+	}
+}
+
+
+void
+ProjectsFolderBrowser::_PathCreated(const BString& pathString)
+{
+	BPath path(pathString.String());
+	BPath parent;
+	if (path.GetParent(&parent) != B_OK)
+		return;
+
+	// folders not populated yet will read the entry when expanded,
+	// and so will folders created in this same batch
+	ProjectItem* parentItem = GetProjectItemByPath(parent.Path());
+	if (parentItem == nullptr || fPendingItems.count(parentItem) > 0
+		|| (fInsertions.count(parentItem) == 0 && !_IsPopulated(parentItem))) {
+		LogTrace("Skipping path %s", path.Path());
+		return;
+	}
+
+	entry_ref ref;
+	BEntry entry(path.Path());
+	if (entry.GetRef(&ref) != B_OK || !entry.Exists()
+		|| GetProjectFromItem(parentItem)->GetIgnoreList().IsIgnored(path.Path(),
+			entry.IsDirectory())) {
+		return;
+	}
+
+	// replaced by a new node (e.g. saved through a temporary file)
+	ProjectItem* existingItem = GetProjectItemByRef(ref);
+	if (existingItem != nullptr) {
+		if (fPendingItems.count(existingItem) == 0) {
+			existingItem->UpdateIcon();
+			const int32 index = IndexOf(existingItem);
+			if (index >= 0)
+				InvalidateItem(index);
+		}
+		return;
+	}
+
+	SourceItem* sourceItem = new SourceItem(ref, entry.IsDirectory()
+		? SourceItemType::FolderItem : SourceItemType::FileItem);
+	sourceItem->SetProjectFolder(GetProjectFromItem(parentItem));
+	ProjectItem* item = new ProjectItem(sourceItem);
+	item->SetExpanded(false);
+	_InheritGitStatus(item, parentItem);
+	_AddToIndex(item);
+	fInsertions[parentItem].push_back(item);
+	fPendingItems.insert(item);
+}
+
+
+void
+ProjectsFolderBrowser::_PathRemoved(const path_event& event)
+{
+	LogDebug("path %s", event.path.String());
+	ProjectItem *item = GetProjectItemByPath(event.path);
+	if (item == nullptr) {
+		// not populated, nothing to do
+		LogTrace("Can't find an item to remove [%s]", event.path.String());
+		return;
+	}
+
+	if (item->GetSourceItem()->Type() != SourceItemType::ProjectFolderItem) {
+		if (fPendingItems.count(item) > 0) {
+			_RemoveFromIndex(item, false);
+			_CancelInsertion(item);
+		} else {
+			_RemoveFromIndex(item);
+			RemoveItem(item);
+		}
+		return;
+	}
+
+	if (!LockLooper())
+		return;
+
+	Select(IndexOf(item));
+	Window()->PostMessage(MSG_PROJECT_MENU_CLOSE);
+
+	const BMessage& message = event.message;
+	if (message.IsEmpty()) {
+		// It seems not possible to track the project folder to the new
+		// location outside of the watched path. So we close the project
+		// and warn the user
+		auto alert = new BAlert("ProjectFolderChanged", B_TRANSLATE(
+			"The project folder has been deleted or moved to another location "
+			"and it will be closed and unloaded from the workspace."),
+			B_TRANSLATE("OK"), NULL, NULL,
+			B_WIDTH_AS_USUAL, B_OFFSET_SPACING, B_WARNING_ALERT);
+			alert->Go();
+	} else {
+		// the project folder is being renamed
+		auto alert = new BAlert("ProjectFolderChanged",
+		B_TRANSLATE("The project folder has been renamed. It will be closed and reopened automatically."),
+			B_TRANSLATE("OK"), NULL, NULL,
+			B_WIDTH_AS_USUAL, B_OFFSET_SPACING, B_WARNING_ALERT);
+		alert->Go();
+
+		// reopen project under the new name or location
+		entry_ref ref;
+		if (message.FindInt64("to directory", &ref.directory) == B_OK) {
+			const char *name;
+			message.FindInt32("device", &ref.device);
+			message.FindString("name", &name);
+			ref.set_name(name);
+			auto msg = new BMessage(MSG_PROJECT_FOLDER_OPEN);
+			msg->AddRef("refs", &ref);
+			Window()->PostMessage(msg);
+		}
+	}
+	UnlockLooper();
+}
+
+
+// The item is kept if the new entry is of the same kind: it only gets
+// its icon again, its git status is sent by the service
+void
+ProjectsFolderBrowser::_PathReplaced(const path_event& event)
+{
+	ProjectItem* item = GetProjectItemByPath(event.path);
+	if (item == nullptr) {
+		_PathCreated(event.path);
+		return;
+	}
+
+	BEntry entry(event.path.String());
+	const SourceItemType type = item->GetSourceItem()->Type();
+	if (type != SourceItemType::ProjectFolderItem
+		&& (!entry.Exists() || entry.IsDirectory() != (type == SourceItemType::FolderItem))) {
+		_PathRemoved(event);
+		_PathCreated(event.path);
+		return;
+	}
+
+	if (fPendingItems.count(item) > 0)
+		return;
+	item->UpdateIcon();
+	const int32 index = IndexOf(item);
+	if (index >= 0)
+		InvalidateItem(index);
+}
+
+
+void
+ProjectsFolderBrowser::_PathMoved(const path_event& event,
+	std::set<ProjectItem*>& renamedParents)
+{
+	const BPath oldPath(event.fromPath.String());
+	BPath oldParent;
+	oldPath.GetParent(&oldParent);
+	const BPath newPath(event.path.String());
+	BPath newParent;
+	newPath.GetParent(&newParent);
+
+	ProjectItem *item = GetProjectItemByPath(event.fromPath);
+	if (item == nullptr) {
+		// it was in a folder not populated yet
+		_PathCreated(event.path);
+		return;
+	}
+	if (fPendingItems.count(item) > 0) {
+		_RemoveFromIndex(item, false);
+		_CancelInsertion(item);
+		_PathCreated(event.path);
+		return;
+	}
+
+	// If the path remains the same except the leaf
+	// then the item is being RENAMED
+	// if the path changes then the item is being MOVED.
+	// Renamed to an ignored name, it goes away like a moved item.
+	const bool ignored = GetProjectFromItem(item)->GetIgnoreList().IsIgnored(newPath.Path(),
+		item->GetSourceItem()->Type() != SourceItemType::FileItem);
+	if (oldParent == newParent && !ignored) {
+		entry_ref newRef;
+		if (get_ref_for_path(newPath.Path(), &newRef) != B_OK) {
+			LogError("Can't find ref for newPath[%s]", newPath.Path());
+			return;
+		}
+		item->SetText(newRef.name);
+		// the children keep their entry_ref: only this key changes
+		_RemoveFromIndex(item, false);
+		item->GetSourceItem()->UpdateEntryRef(newRef);
+		_AddToIndex(item);
+		item->UpdateIcon();
+		if (Superitem(item) != nullptr)
+			renamedParents.insert((ProjectItem*)Superitem(item));
+	} else {
+		_RemoveFromIndex(item);
+		RemoveItem(item);
+		_PathCreated(event.path);
+	}
+}
+
+
+void
+ProjectsFolderBrowser::_CancelInsertion(ProjectItem* item)
+{
+	for (auto& insertion : fInsertions) {
+		std::vector<ProjectItem*>& items = insertion.second;
+		items.erase(std::remove(items.begin(), items.end(), item), items.end());
+	}
+	fPendingItems.erase(item);
+	delete item;
+}
+
+
+// Inserts the new children of parent with a binary search among the
+// existing ones, instead of sorting all the siblings again.
+void
+ProjectsFolderBrowser::_InsertSorted(ProjectItem* parent, std::vector<ProjectItem*>& items)
+{
+	if (items.empty())
+		return;
+
+	// the parent has been removed in the same batch
+	const int32 parentIndex = FullListIndexOf(parent);
+	if (parentIndex < 0) {
+		for (ProjectItem* item : items) {
+			_RemoveFromIndex(item, false);
+			delete item;
+		}
+		return;
+	}
+
+	std::sort(items.begin(), items.end(), [](ProjectItem* a, ProjectItem* b) {
+		return _CompareProjectItems(a, b) < 0;
+	});
+
+	// the current children, and the index past the last one's subitems
+	const uint32 level = parent->OutlineLevel() + 1;
+	std::vector<int32> children;
+	int32 end = parentIndex + 1;
+	for (; end < FullListCountItems(); end++) {
+		const uint32 itemLevel = FullListItemAt(end)->OutlineLevel();
+		if (itemLevel < level)
 			break;
+		if (itemLevel == level)
+			children.push_back(end);
+	}
+
+	// last to first: the indexes before an insertion point stay valid
+	auto bound = children.end();
+	for (auto it = items.rbegin(); it != items.rend(); it++) {
+		ProjectItem* item = *it;
+		bound = std::lower_bound(children.begin(), bound, item,
+			[this](int32 index, ProjectItem* newItem) {
+				return _CompareProjectItems(FullListItemAt(index), newItem) < 0;
+			});
+		const int32 index = bound != children.end() ? *bound : end;
+
+		item->SetOutlineLevel(level);
+		AddItem(item, index);
+		if (item->GetSourceItem()->Type() == SourceItemType::FolderItem
+			&& ProjectScanner::HasChildren(*item->GetSourceItem()->EntryRef())) {
+			AddUnder(_CreatePlaceholder(GetProjectFromItem(item)), item);
+		}
 	}
 }
 
@@ -280,11 +579,23 @@ void
 ProjectsFolderBrowser::MessageReceived(BMessage* message)
 {
 	switch (message->what) {
+		case MSG_PROJECT_SCAN_BATCH:
+			_ScanBatchReceived(message);
+			break;
+		case MSG_PROJECT_MIME_TYPES_UPDATED:
+			_MimeTypesUpdated(message);
+			break;
+		case MSG_GIT_STATUS_CHANGED:
+			_GitStatusChanged(message);
+			break;
+		case MSG_APPLY_PATH_EVENTS:
+			_ApplyPathEvents();
+			break;
 		case B_PATH_MONITOR:
 		{
 			if (Logger::IsDebugEnabled())
 				message->PrintToStream();
-			_UpdateNode(message);
+			_QueuePathEvent(message);
 			SendNotices(B_PATH_MONITOR, message);
 			break;
 		}
@@ -300,8 +611,13 @@ ProjectsFolderBrowser::MessageReceived(BMessage* message)
 				LogError("(MSG_PROJECT_MENU_OPEN_FILE) Can't find item at index %d", index);
 				return;
 			}
+			if (_IsPlaceholder(item))
+				return;
 			if (item->GetSourceItem()->Type() != SourceItemType::FileItem) {
-				ExpandOrCollapse(item, !item->IsExpanded());
+				if (item->IsExpanded())
+					Collapse(item);
+				else
+					Expand(item);
 				LogDebug("(MSG_PROJECT_MENU_OPEN_FILE) ExpandOrCollapse(%s)", item->GetSourceItem()->Name().String());
 				return;
 			}
@@ -354,6 +670,9 @@ ProjectsFolderBrowser::MessageReceived(BMessage* message)
 						item->SetNeedsSave(needsSave);
 						Invalidate();
 					}
+					// files written in place don't send path monitor events
+					if (!needsSave)
+						_RefreshGitStatus(fileName);
 					break;
 				}
 				case MSG_NOTIFY_BUILDING_PHASE:
@@ -376,14 +695,10 @@ ProjectsFolderBrowser::MessageReceived(BMessage* message)
 			ProjectItem* item = (ProjectItem*)message->GetPointer("parent_item", nullptr);
 
 			if (item != nullptr && message->FindRef("ref", &ref) == B_OK) {
-				int32 howMany = BOutlineListView::CountItemsUnder(item, true);
-				for(int32 i=0; i<howMany;i++) {
-					ProjectItem* subItem = (ProjectItem*)BOutlineListView::ItemUnderAt(item, true, i);
-					if (*subItem->GetSourceItem()->EntryRef() == ref) {
-							Select(IndexOf(subItem));
-							ScrollToSelection();
-							break;
-					}
+				ProjectItem* subItem = GetProjectItemByRef(ref);
+				if (subItem != nullptr && Superitem(subItem) == item) {
+					Select(IndexOf(subItem));
+					ScrollToSelection();
 				}
 			}
 			break;
@@ -485,9 +800,6 @@ ProjectsFolderBrowser::_ShowProjectItemPopupMenu(BPoint where)
 	projectMenu->Go(ConvertToScreen(where), true);
 }
 
-// TODO:
-// Optimize the search under a specific ProjectItem, tipically a
-// superitem (ProjectFolder)
 ProjectItem*
 ProjectsFolderBrowser::GetProjectItemByPath(BString const& path) const
 {
@@ -498,14 +810,48 @@ ProjectsFolderBrowser::GetProjectItemByPath(BString const& path) const
 		return nullptr;
 	}
 
-	const int32 countItems = FullListCountItems();
-	for (int32 i = 0; i < countItems; i++) {
-		ProjectItem *item = dynamic_cast<ProjectItem*>(FullListItemAt(i));
-		if (item != nullptr && *item->GetSourceItem()->EntryRef() == ref)
-			return item;
-	}
+	return GetProjectItemByRef(ref);
+}
 
-	return nullptr;
+
+ProjectItem*
+ProjectsFolderBrowser::GetProjectItemByRef(const entry_ref& ref) const
+{
+	auto it = fItemIndex.find(ref);
+	return it != fItemIndex.end() ? it->second : nullptr;
+}
+
+
+void
+ProjectsFolderBrowser::_AddToIndex(ProjectItem* item)
+{
+	fItemIndex[*item->GetSourceItem()->EntryRef()] = item;
+}
+
+
+// Items are removed from the list together with their subitems:
+// unless told otherwise, the subitems leave the index too.
+void
+ProjectsFolderBrowser::_RemoveFromIndex(ProjectItem* item, bool subItems)
+{
+	auto it = fItemIndex.find(*item->GetSourceItem()->EntryRef());
+	if (it != fItemIndex.end() && it->second == item)
+		fItemIndex.erase(it);
+
+	const int32 index = subItems ? FullListIndexOf(item) : -1;
+	if (index < 0)
+		return;
+
+	const uint32 level = item->OutlineLevel();
+	const int32 count = FullListCountItems();
+	for (int32 i = index + 1; i < count; i++) {
+		ProjectItem* subItem = dynamic_cast<ProjectItem*>(FullListItemAt(i));
+		if (subItem == nullptr || subItem->OutlineLevel() <= level)
+			break;
+		it = fItemIndex.find(*subItem->GetSourceItem()->EntryRef());
+		if (it != fItemIndex.end() && it->second == subItem)
+			fItemIndex.erase(it);
+	}
 }
 
 
@@ -584,6 +930,7 @@ ProjectsFolderBrowser::AttachedToWindow()
 {
 	BOutlineListView::AttachedToWindow();
 	BOutlineListView::SetTarget((BHandler*)this, Window());
+	fGenioWatchingFilter->SetTarget(BMessenger(this));
 
 	if (Window()->LockLooper()) {
 		Window()->StartWatching(this, MSG_NOTIFY_EDITOR_FILE_OPENED);
@@ -637,7 +984,7 @@ ProjectsFolderBrowser::MouseDown(BPoint where)
 		BOutlineListView::MouseDown(where);
 	} else 	if ( buttons == B_MOUSE_BUTTON(2)) {
 		int32 index = IndexOf(where);
-		if (index >= 0) {
+		if (index >= 0 && !_IsPlaceholder(dynamic_cast<ProjectItem*>(ItemAt(index)))) {
 			Select(index);
 			_ShowProjectItemPopupMenu(where);
 		}
@@ -666,94 +1013,525 @@ ProjectsFolderBrowser::MouseMoved(BPoint point, uint32 transit, const BMessage*
 void
 ProjectsFolderBrowser::ProjectFolderDepopulate(ProjectFolder* project)
 {
+	_StopScans(project);
+	_StopMimeTypeUpdate(project);
+	fFileCatalog->RemoveProject(project);
+	project->StopGitStatus();
+
 	const BString projectPath = project->Path();
 	status_t status = BPrivate::BPathMonitor::StopWatching(projectPath, BMessenger(this));
 	if (status != B_OK) {
 		LogErrorF("Can't StopWatching! path [%s] error[%s]", projectPath.String(), strerror(status));
 	}
+	auto watches = fFoundFolderWatches.equal_range(projectPath);
+	for (auto it = watches.first; it != watches.second; it++)
+		BPrivate::BPathMonitor::StopWatching(it->second, BMessenger(this));
+	fFoundFolderWatches.erase(projectPath);
+	fGenioWatchingFilter->RemoveIgnoreList(projectPath);
+	fGenioWatchingFilter->RemoveRoot(projectPath);
 	ProjectItem* listItem = GetProjectItemForProject(project);
-	if (listItem)
+	if (listItem) {
+		_RemoveFromIndex(listItem);
 		RemoveItem(listItem);
+	}
 	else
 		LogErrorF("Can't find ProjectItem for path [%s]", projectPath.String());
 
 	fProjectProjectItemList.RemoveItem(listItem);
 	fProjectList.RemoveItem(project);
+	fRepositoryChanges.erase(project);
 
 
 	Invalidate();
 }
 
 
+// Only the top level of the project is read here, in background, or taken
+// from the project snapshot. Folders are populated when expanded (see Expand()).
 void
 ProjectsFolderBrowser::ProjectFolderPopulate(ProjectFolder* project)
 {
-	ProjectItem *projectItem = _ProjectFolderScan(nullptr, project->EntryRef(), project);
-	//NOTE: here we are ordering ALL the elements (maybe and option could prevent ordering the projects)
-	SortItemsUnder(nullptr, false, ProjectsFolderBrowser::_CompareProjectItems);
+	// the items take their git status from it, as it gets known
+	project->StartGitStatus(BMessenger(this));
 
-	const BString projectPath = project->Path();
-	update_mime_info(projectPath, true, false, B_UPDATE_MIME_INFO_NO_FORCE);
+	ProjectItem *projectItem = new ProjectItem(project);
+	AddItem(projectItem);
+	_AddToIndex(projectItem);
+	SortItemsUnder(nullptr, true, ProjectsFolderBrowser::_CompareProjectItems);
 
 	assert(projectItem && project);
 
 	fProjectList.AddItem(project);
 	fProjectProjectItemList.AddItem(projectItem);
 
-	Invalidate();
+	// watched before it is read: nothing changed meanwhile is missed
+	const BString projectPath = project->Path();
+
+	fGenioWatchingFilter->SetIgnoreList(project->GetIgnoreList());
 	status_t status = BPrivate::BPathMonitor::StartWatching(projectPath,
 			B_WATCH_RECURSIVELY, BMessenger(this));
 	if (status != B_OK ) {
 		LogErrorF("Can't StartWatching! path [%s] error[%s]", projectPath.String(), ::strerror(status));
 	}
+
+	node_ref projectNode;
+	if (BNode(project->EntryRef()).GetNodeRef(&projectNode) == B_OK)
+		fGenioWatchingFilter->Promote(projectNode);
+	_UpdateMonitoringStatus();
+
+	// shown at once when the project has been read before
+	AddUnder(_CreatePlaceholder(project), projectItem);
+	if (!_PopulateFromSnapshot(projectItem, project))
+		_StartScan(projectItem, *project->EntryRef(), project);
+
+	Invalidate();
+
+	// files without a type show the icon guessed from their name until then
+	_StartMimeTypeUpdate(project);
+	fFileCatalog->AddProject(project);
+}
+
+
+// With a known state, the scan only validates a folder populated
+// from the snapshot
+void
+ProjectsFolderBrowser::_StartScan(ProjectItem* folderItem, const entry_ref& ref,
+	ProjectFolder* projectFolder, ino_t knownNode, bigtime_t knownModified)
+{
+	ProjectScanner* scanner = new ProjectScanner(ref, folderItem, projectFolder,
+		BMessenger(this));
+	scanner->SetKnownState(knownNode, knownModified);
+	fScanners.AddItem(scanner);
+	status_t status = scanner->Start();
+	if (status != B_OK) {
+		LogErrorF("Can't scan [%s] error[%s]", ref.name, ::strerror(status));
+		fScanners.RemoveItem(scanner);
+	}
+}
+
+
+void
+ProjectsFolderBrowser::_StopScans(ProjectFolder* projectFolder)
+{
+	for (int32 i = fScanners.CountItems() - 1; i >= 0; i--) {
+		if (fScanners.ItemAt(i)->Project() == projectFolder)
+			delete fScanners.RemoveItemAt(i);
+	}
+}
+
+
+void
+ProjectsFolderBrowser::_StartMimeTypeUpdate(ProjectFolder* projectFolder)
+{
+	MimeTypeUpdater* updater = new MimeTypeUpdater(projectFolder, BMessenger(this));
+	fMimeTypeUpdaters.AddItem(updater);
+	status_t status = updater->Start();
+	if (status != B_OK) {
+		LogErrorF("Can't update the MIME types of [%s] error[%s]",
+			projectFolder->Path().String(), ::strerror(status));
+		fMimeTypeUpdaters.RemoveItem(updater);
+	}
+}
+
+
+void
+ProjectsFolderBrowser::_StopMimeTypeUpdate(ProjectFolder* projectFolder)
+{
+	for (int32 i = fMimeTypeUpdaters.CountItems() - 1; i >= 0; i--) {
+		if (fMimeTypeUpdaters.ItemAt(i)->Project() == projectFolder)
+			delete fMimeTypeUpdaters.RemoveItemAt(i);
+	}
+}
+
+
+// The files not shown yet get the right icon when their item is created
+void
+ProjectsFolderBrowser::_MimeTypesUpdated(BMessage* message)
+{
+	entry_ref ref;
+	for (int32 i = 0; message->FindRef("ref", i, &ref) == B_OK; i++) {
+		ProjectItem* item = GetProjectItemByRef(ref);
+		if (item == nullptr)
+			continue;
+		item->UpdateIcon();
+		const int32 index = IndexOf(item);
+		if (index >= 0)
+			InvalidateItem(index);
+	}
+
+	// the whole project has been walked
+	if (!message->GetBool("done", false))
+		return;
+	const int32 updaterID = message->GetInt32("updater_id", -1);
+	for (int32 i = 0; i < fMimeTypeUpdaters.CountItems(); i++) {
+		if (fMimeTypeUpdaters.ItemAt(i)->ID() == updaterID) {
+			delete fMimeTypeUpdaters.RemoveItemAt(i);
+			break;
+		}
+	}
+}
+
+
+void
+ProjectsFolderBrowser::_RefreshGitStatus(const BString& path)
+{
+	for (int32 i = 0; i < fProjectList.CountItems(); i++) {
+		GitStatusService* gitStatus = fProjectList.ItemAt(i)->GitStatus();
+		if (gitStatus != nullptr)
+			gitStatus->Refresh(path);
+	}
+}
+
+
+void
+ProjectsFolderBrowser::_GitStatusChanged(BMessage* message)
+{
+	ProjectFolder* project = ProjectByPath(message->GetString("root", ""));
+	if (project == nullptr || project->GitStatus() == nullptr)
+		return;
+	GitStatusService* gitStatus = project->GitStatus();
+
+	BString path;
+	for (int32 i = 0; message->FindString("path", i, &path) == B_OK; i++) {
+		ProjectItem* item = GetProjectItemByPath(path);
+		if (item == nullptr)
+			continue;
+		const uint32 oldStatus = item->GitStatus();
+		if (!_SetGitStatus(item, gitStatus->StatusFor(path)))
+			continue;
+
+		// the files of an untracked or ignored folder share its status
+		if (((oldStatus ^ item->GitStatus()) & ~kGitStatusContainsChanges) != 0)
+			_UpdateGitStatusUnder(item, path, gitStatus);
+	}
+}
+
+
+// The paths are made from the item names: no need to ask the file system
+void
+ProjectsFolderBrowser::_UpdateGitStatusUnder(ProjectItem* folderItem, const BString& folderPath,
+	GitStatusService* gitStatus)
+{
+	const int32 count = CountItemsUnder(folderItem, true);
+	for (int32 i = 0; i < count; i++) {
+		ProjectItem* item = static_cast<ProjectItem*>(ItemUnderAt(folderItem, true, i));
+		if (_IsPlaceholder(item))
+			continue;
+		BString path(folderPath);
+		path << "/" << item->GetSourceItem()->EntryRef()->name;
+		_SetGitStatus(item, gitStatus->StatusFor(path));
+		if (item->GetSourceItem()->Type() == SourceItemType::FolderItem)
+			_UpdateGitStatusUnder(item, path, gitStatus);
+	}
+}
+
+
+bool
+ProjectsFolderBrowser::_SetGitStatus(ProjectItem* item, uint32 status)
+{
+	if (!item->SetGitStatus(status))
+		return false;
+	const int32 index = IndexOf(item);
+	if (index >= 0)
+		InvalidateItem(index);
+	return true;
+}
+
+
+// New items start with the status of an untracked or ignored parent, which
+// is that of all its files; the others are announced by the git status
+void
+ProjectsFolderBrowser::_InheritGitStatus(ProjectItem* item, ProjectItem* parentItem)
+{
+	const uint32 status = parentItem->GitStatus() & ~kGitStatusContainsChanges;
+	if ((status & (GIT_STATUS_WT_NEW | GIT_STATUS_IGNORED)) != 0)
+		item->SetGitStatus(status);
+}
+
+
+// Asks for the status of the items just added to a folder
+void
+ProjectsFolderBrowser::_AnnounceGitStatus(ProjectItem* folderItem, ProjectFolder* projectFolder)
+{
+	if (projectFolder == nullptr || projectFolder->GitStatus() == nullptr)
+		return;
+	projectFolder->GitStatus()->Announce(BPath(folderItem->GetSourceItem()->EntryRef()).Path());
+}
+
+
+// The events of a folder being read are dropped, or undone by the batch:
+// its scan is done again
+void
+ProjectsFolderBrowser::_MarkScanStale(const BString& path)
+{
+	if (fScanners.IsEmpty())
+		return;
+
+	BPath parent;
+	if (BPath(path.String()).GetParent(&parent) != B_OK)
+		return;
+	ProjectItem* parentItem = GetProjectItemByPath(parent.Path());
+	if (parentItem == nullptr)
+		return;
+	for (int32 i = 0; i < fScanners.CountItems(); i++) {
+		if (fScanners.ItemAt(i)->FolderItem() == parentItem)
+			fScanners.ItemAt(i)->SetStale();
+	}
 }
 
 
+bool
+ProjectsFolderBrowser::_IsScanning(ProjectItem* folderItem) const
+{
+	for (int32 i = 0; i < fScanners.CountItems(); i++) {
+		if (fScanners.ItemAt(i)->FolderItem() == folderItem)
+			return true;
+	}
+	return false;
+}
+
+
+// The placeholder is the only child of a folder not populated yet:
+// it makes the outline view show the expander. It has no entry_ref.
 ProjectItem*
-ProjectsFolderBrowser::_ProjectFolderScan(ProjectItem* item, const entry_ref* ref, ProjectFolder *projectFolder)
+ProjectsFolderBrowser::_CreatePlaceholder(ProjectFolder* projectFolder) const
 {
-	ProjectItem *newItem;
-	if (item != nullptr) {
-		SourceItem *sourceItem = new SourceItem(*ref);
-		sourceItem->SetProjectFolder(projectFolder);
-		newItem = new ProjectItem(sourceItem);
-		AddUnder(newItem, item);
-		Collapse(newItem);
-	} else {
-		newItem = new ProjectItem(projectFolder);
-		AddItem(newItem);
-	}
-
-	BEntry entry(ref);
-	BEntry parent;
-	BPath parentPath;
-	// Check if there's a Jamfile or makefile in the root path
-	// of the project
-	if (entry.IsFile() && entry.GetParent(&parent) == B_OK
-		&& parent.GetPath(&parentPath) == B_OK
-		&& projectFolder->Path().Compare(parentPath.Path()) == 0) {
-		// guess builder type
-		// TODO: do it for real: set a flag or setting in project
-		// TODO: move this away from here, into a specialized class
-		// and maybe into plugins
-		if (strcasecmp(entry.Name(), "makefile") == 0) {
-			// builder: make
-			projectFolder->SetGuessedBuilder("make");
-			LogInfo("Guessed builder: make");
-		} else if (strcasecmp(entry.Name(), "jamfile") == 0) {
-			// builder: jam
-			projectFolder->SetGuessedBuilder("jam");
-			LogInfo("Guessed builder: jam");
+	SourceItem* sourceItem = new SourceItem(entry_ref(), SourceItemType::FileItem);
+	sourceItem->SetProjectFolder(projectFolder);
+	ProjectItem* item = new ProjectItem(sourceItem);
+	item->SetText(B_TRANSLATE("Loading" B_UTF8_ELLIPSIS));
+	return item;
+}
+
+
+/* static */
+bool
+ProjectsFolderBrowser::_IsPlaceholder(const ProjectItem* item)
+{
+	return item != nullptr && item->GetSourceItem()->EntryRef()->name == nullptr;
+}
+
+
+bool
+ProjectsFolderBrowser::_IsPopulated(ProjectItem* folderItem)
+{
+	return !_IsPlaceholder(dynamic_cast<ProjectItem*>(ItemUnderAt(folderItem, true, 0)));
+}
+
+
+/* virtual */
+void
+ProjectsFolderBrowser::Expand(BListItem* item)
+{
+	// folders are read the first time they are expanded
+	ProjectItem* folderItem = dynamic_cast<ProjectItem*>(item);
+	if (folderItem != nullptr && !_IsPopulated(folderItem) && !_IsScanning(folderItem)) {
+		// opened folders keep a live node monitor
+		node_ref folderNode;
+		ProjectFolder* projectFolder = GetProjectFromItem(folderItem);
+		if (BNode(folderItem->GetSourceItem()->EntryRef()).GetNodeRef(&folderNode) == B_OK) {
+			if (fGenioWatchingFilter->Promote(folderNode) && projectFolder != nullptr) {
+				const BString folderPath = BPath(folderItem->GetSourceItem()->EntryRef()).Path();
+				if (BPrivate::BPathMonitor::StartWatching(folderPath, B_WATCH_RECURSIVELY,
+						BMessenger(this)) == B_OK) {
+					fFoundFolderWatches.insert({ projectFolder->Path(), folderPath });
+				}
+			}
+			_UpdateMonitoringStatus();
+		}
+		if (!_PopulateFromSnapshot(folderItem, projectFolder)) {
+			_StartScan(folderItem, *folderItem->GetSourceItem()->EntryRef(),
+				projectFolder);
 		}
-	} else if (entry.IsDirectory()) {
-		BDirectory dir(&entry);
-		entry_ref nextRef;
-		while (dir.GetNextRef(&nextRef) != B_ENTRY_NOT_FOUND) {
-			_ProjectFolderScan(newItem, &nextRef, projectFolder);
+	}
+	BOutlineListView::Expand(item);
+}
+
+
+static void
+GuessBuilder(ProjectFolder* projectFolder, const char* fileName)
+{
+	// guess builder type
+	// TODO: do it for real: set a flag or setting in project
+	// TODO: move this away from here, into a specialized class
+	// and maybe into plugins
+	if (strcasecmp(fileName, "makefile") == 0) {
+		// builder: make
+		projectFolder->SetGuessedBuilder("make");
+		LogInfo("Guessed builder: make");
+	} else if (strcasecmp(fileName, "jamfile") == 0) {
+		// builder: jam
+		projectFolder->SetGuessedBuilder("jam");
+		LogInfo("Guessed builder: jam");
+	}
+}
+
+
+void
+ProjectsFolderBrowser::_ScanBatchReceived(BMessage* message)
+{
+	ProjectScanner* scanner = nullptr;
+	const int32 scanID = message->GetInt32("scan_id", -1);
+	for (int32 i = 0; i < fScanners.CountItems(); i++) {
+		if (fScanners.ItemAt(i)->ID() == scanID)
+			scanner = fScanners.ItemAt(i);
+	}
+	// the project has been closed meanwhile
+	if (scanner == nullptr)
+		return;
+
+	ProjectFolder* projectFolder = scanner->Project();
+	ProjectItem* folderItem = scanner->FolderItem();
+	const bool stale = scanner->IsStale();
+	fScanners.RemoveItem(scanner);
+
+	// the folder may have been removed while being read
+	const entry_ref folderRef = *folderItem->GetSourceItem()->EntryRef();
+	if (GetProjectItemByRef(folderRef) != folderItem)
+		return;
+
+	// unless the snapshot was right
+	if (!message->GetBool("unchanged", false)) {
+		projectFolder->Snapshot().SetFolder(_RelativePath(projectFolder, folderRef), *message);
+
+		ProjectItem* placeholder = dynamic_cast<ProjectItem*>(ItemUnderAt(folderItem, true, 0));
+		if (!_IsPlaceholder(placeholder)) {
+			// populated from the snapshot, which is out of date
+			_ReconcileFolder(folderItem, *message, projectFolder);
+		} else {
+			RemoveItem(placeholder);
+			delete placeholder;
+			_PopulateFolder(folderItem, *message, projectFolder);
 		}
 	}
 
-	return newItem;
+	// changed after it was read: the events are applied to it from now on,
+	// what happened before is caught by reading it again
+	if (stale)
+		_StartScan(folderItem, folderRef, projectFolder);
+}
+
+
+void
+ProjectsFolderBrowser::_PopulateFolder(ProjectItem* folderItem, const BMessage& batch,
+	ProjectFolder* projectFolder)
+{
+	const bool projectRoot = folderItem->GetSourceItem()->Type()
+		== SourceItemType::ProjectFolderItem;
+
+	int32 count = 0;
+	batch.GetInfo("ref", nullptr, &count);
+
+	// AddUnder() inserts right below the parent: the sorted entries
+	// are added last to first
+	for (int32 i = count - 1; i >= 0; i--) {
+		entry_ref ref;
+		if (batch.FindRef("ref", i, &ref) != B_OK)
+			continue;
+		const bool folder = batch.GetBool("folder", i, false);
+		SourceItem* sourceItem = new SourceItem(ref,
+			folder ? SourceItemType::FolderItem : SourceItemType::FileItem);
+		sourceItem->SetProjectFolder(projectFolder);
+		ProjectItem* item = new ProjectItem(sourceItem);
+		item->SetExpanded(false);
+		_InheritGitStatus(item, folderItem);
+		AddUnder(item, folderItem);
+		_AddToIndex(item);
+
+		if (folder && batch.GetBool("has_children", i, false))
+			AddUnder(_CreatePlaceholder(projectFolder), item);
+		else if (!folder && projectRoot)
+			GuessBuilder(projectFolder, ref.name);
+	}
+	if (count > 0)
+		_AnnounceGitStatus(folderItem, projectFolder);
+}
+
+
+// Shows the folder content as it was the last time it was read, and
+// checks it in background: only a folder modified since is read again.
+bool
+ProjectsFolderBrowser::_PopulateFromSnapshot(ProjectItem* folderItem,
+	ProjectFolder* projectFolder)
+{
+	const entry_ref& folderRef = *folderItem->GetSourceItem()->EntryRef();
+	BMessage batch;
+	ino_t node;
+	bigtime_t modified;
+	if (!projectFolder->Snapshot().GetFolder(_RelativePath(projectFolder, folderRef),
+			projectFolder->EntryRef()->device, batch, node, modified)) {
+		return false;
+	}
+
+	ProjectItem* placeholder = dynamic_cast<ProjectItem*>(ItemUnderAt(folderItem, true, 0));
+	if (_IsPlaceholder(placeholder)) {
+		RemoveItem(placeholder);
+		delete placeholder;
+	}
+	_PopulateFolder(folderItem, batch, projectFolder);
+	_StartScan(folderItem, folderRef, projectFolder, node, modified);
+	return true;
+}
+
+
+// Brings a folder populated from an old snapshot up to date: the items
+// still there are kept, with their expanded subfolders.
+void
+ProjectsFolderBrowser::_ReconcileFolder(ProjectItem* folderItem, const BMessage& batch,
+	ProjectFolder* projectFolder)
+{
+	std::unordered_map<entry_ref, int32, EntryRefHash> entries;
+	int32 count = 0;
+	batch.GetInfo("ref", nullptr, &count);
+	for (int32 i = 0; i < count; i++) {
+		entry_ref ref;
+		if (batch.FindRef("ref", i, &ref) == B_OK)
+			entries[ref] = i;
+	}
+
+	std::vector<ProjectItem*> staleItems;
+	for (int32 i = 0; i < CountItemsUnder(folderItem, true); i++) {
+		ProjectItem* item = dynamic_cast<ProjectItem*>(ItemUnderAt(folderItem, true, i));
+		if (item == nullptr || _IsPlaceholder(item))
+			continue;
+		auto it = entries.find(*item->GetSourceItem()->EntryRef());
+		const bool folder = item->GetSourceItem()->Type() == SourceItemType::FolderItem;
+		if (it == entries.end() || batch.GetBool("folder", it->second, false) != folder)
+			staleItems.push_back(item);
+		else
+			entries.erase(it);
+	}
+
+	for (ProjectItem* item : staleItems) {
+		_RemoveFromIndex(item);
+		RemoveItem(item);
+	}
+
+	std::vector<ProjectItem*> newItems;
+	for (const auto& entry : entries) {
+		const bool folder = batch.GetBool("folder", entry.second, false);
+		SourceItem* sourceItem = new SourceItem(entry.first,
+			folder ? SourceItemType::FolderItem : SourceItemType::FileItem);
+		sourceItem->SetProjectFolder(projectFolder);
+		ProjectItem* item = new ProjectItem(sourceItem);
+		item->SetExpanded(false);
+		_InheritGitStatus(item, folderItem);
+		_AddToIndex(item);
+		newItems.push_back(item);
+	}
+	_InsertSorted(folderItem, newItems);
+	if (!newItems.empty())
+		_AnnounceGitStatus(folderItem, projectFolder);
+}
+
+
+/* static */
+BString
+ProjectsFolderBrowser::_RelativePath(ProjectFolder* projectFolder, const entry_ref& ref)
+{
+	BString path(BPath(&ref).Path());
+	path.Remove(0, std::min(path.Length(), projectFolder->Path().Length() + 1));
+	return path;
 }
 
 
@@ -6,8 +6,19 @@
 #define ProjectsFolderBrowser_H
 
 
+#include <Entry.h>
+#include <Message.h>
 #include <OutlineListView.h>
 #include <ObjectList.h>
+#include <String.h>
+
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include "TemplatesMenu.h"
 
@@ -22,12 +33,28 @@ enum {
 	MSG_PROJECT_MENU_RENAME_FILE		= 'pmrf',
 	MSG_PROJECT_MENU_DO_RENAME_FILE		= 'pmdr',
 
-	MSG_BROWSER_SELECT_ITEM				= 'sele'
+	MSG_BROWSER_SELECT_ITEM				= 'sele',
+	MSG_APPLY_PATH_EVENTS				= 'apev'
 };
 
 class ProjectFolder;
 class ProjectItem;
+class FileCatalog;
+class MimeTypeUpdater;
+class ProjectScanner;
 class GenioWatchingFilter;
+class GitStatusService;
+
+struct EntryRefHash {
+	size_t operator()(const entry_ref& ref) const
+	{
+		size_t hash = std::hash<dev_t>()(ref.device);
+		hash = hash * 31 + std::hash<ino_t>()(ref.directory);
+		if (ref.name != nullptr)
+			hash = hash * 31 + std::hash<std::string_view>()(ref.name);
+		return hash;
+	}
+};
 
 class ProjectsFolderBrowser : public BOutlineListView {
 public:
@@ -40,6 +67,7 @@ public:
 	virtual void	AttachedToWindow();
 	virtual void	DetachedFromWindow();
 	virtual void	MessageReceived(BMessage* message);
+	virtual void	Expand(BListItem* item);
 
 	ProjectItem*	GetSelectedProjectItem() const;
 	ProjectItem*	GetProjectItemForProject(ProjectFolder*);
@@ -66,33 +94,96 @@ public:
 
 	void			SelectNewItemAndScrollDelayed(ProjectItem* parent, const entry_ref ref); //ugly name..
 
+	FileCatalog*	GetFileCatalog() const { return fFileCatalog; }
+
 private:
 
 	ProjectItem*	GetProjectItemByPath(const BString& path) const;
-
-	ProjectItem*	_CreatePath(BPath pathToCreate);
-
-	ProjectItem*	_ProjectFolderScan(ProjectItem* item, const entry_ref* ref, ProjectFolder *projectFolder = NULL);
+	ProjectItem*	GetProjectItemByRef(const entry_ref& ref) const;
+
+	void			_AddToIndex(ProjectItem* item);
+	void			_RemoveFromIndex(ProjectItem* item, bool subItems = true);
+
+	void			_StartScan(ProjectItem* folderItem, const entry_ref& ref, ProjectFolder* projectFolder,
+						ino_t knownNode = -1, bigtime_t knownModified = -1);
+	void			_ScanBatchReceived(BMessage* message);
+	void			_PopulateFolder(ProjectItem* folderItem, const BMessage& batch,
+						ProjectFolder* projectFolder);
+	bool			_PopulateFromSnapshot(ProjectItem* folderItem, ProjectFolder* projectFolder);
+	void			_ReconcileFolder(ProjectItem* folderItem, const BMessage& batch,
+						ProjectFolder* projectFolder);
+	static	BString	_RelativePath(ProjectFolder* projectFolder, const entry_ref& ref);
+	void			_StopScans(ProjectFolder* projectFolder);
+	void			_MarkScanStale(const BString& path);
+	bool			_IsScanning(ProjectItem* folderItem) const;
+	void			_StartMimeTypeUpdate(ProjectFolder* projectFolder);
+	void			_StopMimeTypeUpdate(ProjectFolder* projectFolder);
+	void			_MimeTypesUpdated(BMessage* message);
+	void			_RefreshGitStatus(const BString& path);
+	void			_GitStatusChanged(BMessage* message);
+	void			_UpdateGitStatusUnder(ProjectItem* folderItem, const BString& folderPath,
+						GitStatusService* gitStatus);
+	bool			_SetGitStatus(ProjectItem* item, uint32 status);
+	void			_InheritGitStatus(ProjectItem* item, ProjectItem* parentItem);
+	void			_AnnounceGitStatus(ProjectItem* folderItem, ProjectFolder* projectFolder);
+
+	ProjectItem*	_CreatePlaceholder(ProjectFolder* projectFolder) const;
+	static	bool	_IsPlaceholder(const ProjectItem* item);
+	bool			_IsPopulated(ProjectItem* folderItem);
 
 	void			_ShowProjectItemPopupMenu(BPoint where);
 
 	static	int		_CompareProjectItems(const BListItem* a, const BListItem* b);
 
-	void			_UpdateNode(BMessage *message);
+	struct path_event {
+		int32		opcode;		// 0 when merged away, or kEntryReplaced
+		BString		path;
+		BString		fromPath;	// B_ENTRY_MOVED only
+		BMessage	message;	// project folder moved away
+	};
+
+	void			_QueuePathEvent(BMessage* message);
+	void			_QueueRepositoryChange(const BString& path);
+	void			_UpdateMonitoringStatus();
+	static	bool	_MergePathEvent(path_event& previous, const path_event& event);
+	void			_ApplyPathEvents();
+	void			_PathCreated(const BString& path);
+	void			_PathRemoved(const path_event& event);
+	void			_PathReplaced(const path_event& event);
+	void			_PathMoved(const path_event& event, std::set<ProjectItem*>& renamedParents);
+	void			_CancelInsertion(ProjectItem* item);
+	void			_InsertSorted(ProjectItem* parent, std::vector<ProjectItem*>& items);
 
 	status_t		_RenameCurrentSelectedFile(const BString& newName);
 
-	ProjectItem*	_CreateNewProjectItem(ProjectItem* parentItem, BPath path);
-
 private:
 	TemplatesMenu*		fFileNewProjectMenuItem;
 
 	bool				fIsBuilding = false;
 	GenioWatchingFilter* fGenioWatchingFilter;
+	FileCatalog*		fFileCatalog;
 
 	//TODO: remove this and use a std::vector<std::pair or similar.
 	BObjectList<ProjectFolder>	fProjectList;
 	BObjectList<ProjectItem>	fProjectProjectItemList;
+	BObjectList<ProjectScanner>	fScanners;
+	BObjectList<MimeTypeUpdater>	fMimeTypeUpdaters;
+
+	// entry_ref -> item, for every item in the list but placeholders
+	std::unordered_map<entry_ref, ProjectItem*, EntryRefHash>	fItemIndex;
+
+	// queued path monitor events, and the last one for each path
+	std::vector<path_event>		fPathEvents;
+	std::unordered_map<std::string, size_t>	fPathEventIndex;
+	bool						fPathEventsPending;
+	// items created by the events being applied, not in the list yet
+	std::map<ProjectItem*, std::vector<ProjectItem*>>	fInsertions;
+	std::set<ProjectItem*>		fPendingItems;
+	// projects whose .git/HEAD or .git/index changed
+	std::set<ProjectFolder*>	fRepositoryChanges;
+	// project path -> folders found by the poller, then opened: BPathMonitor
+	// watches them on their own
+	std::multimap<BString, BString>	fFoundFolderWatches;
 };
 
 
@@ -0,0 +1,333 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+
+
+#include "QuickOpenWindow.h"
+
+#include <Autolock.h>
+#include <Catalog.h>
+#include <Entry.h>
+#include <GroupLayout.h>
+#include <LayoutBuilder.h>
+#include <ListView.h>
+#include <MessageFilter.h>
+#include <MessageRunner.h>
+#include <ScrollView.h>
+#include <TextControl.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "FileCatalog.h"
+#include "StyledItem.h"
+#include "Utils.h"
+
+
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "QuickOpenWindow"
+
+
+static const int32 kMaxResults = 50;
+// how often the results are searched again while the catalog changes
+static const bigtime_t kPulseInterval = 500000; // 500 ms
+// how long a send may block before checking if the window is quitting
+static const bigtime_t kSendTimeout = 100000; // 100 ms
+
+
+class QuickOpenItem : public StyledItem {
+public:
+	QuickOpenItem(const BString& path, const BString& relativePath, const BString& project)
+		:
+		StyledItem(relativePath.String() + relativePath.FindLast('/') + 1),
+		fPath(path)
+	{
+		BString extraText("  ");
+		const int32 nameStart = relativePath.FindLast('/');
+		if (nameStart > 0)
+			extraText.Append(relativePath, nameStart).Append(" ");
+		extraText << "(" << project << ")";
+		SetExtraText(extraText);
+	}
+
+	const BString&	Path() const { return fPath; }
+
+private:
+	BString	fPath;
+};
+
+
+// The results are chosen without leaving the query
+class ResultsKeyFilter : public BMessageFilter {
+public:
+	ResultsKeyFilter(BListView* results)
+		:
+		BMessageFilter(B_KEY_DOWN),
+		fResults(results)
+	{
+	}
+
+	virtual filter_result Filter(BMessage* message, BHandler** target)
+	{
+		const char* bytes;
+		if (message->FindString("bytes", &bytes) != B_OK)
+			return B_DISPATCH_MESSAGE;
+
+		const int32 count = fResults->CountItems();
+		int32 selection = fResults->CurrentSelection();
+		switch (bytes[0]) {
+			case B_UP_ARROW:
+				selection = std::max(selection - 1, (int32)0);
+				break;
+			case B_DOWN_ARROW:
+				selection = std::min(selection + 1, count - 1);
+				break;
+			case B_ENTER:
+				Looper()->PostMessage(QOW_OPEN);
+				return B_SKIP_MESSAGE;
+			default:
+				return B_DISPATCH_MESSAGE;
+		}
+		if (count > 0) {
+			fResults->Select(selection);
+			fResults->ScrollToSelection();
+		}
+		return B_SKIP_MESSAGE;
+	}
+
+private:
+	BListView*	fResults;
+};
+
+
+QuickOpenWindow::QuickOpenWindow(BWindow* owner, FileCatalog* catalog)
+	:
+	BWindow(BRect(0, 0, 0, 0), B_TRANSLATE("Quick open"), B_MODAL_WINDOW_LOOK,
+		B_MODAL_SUBSET_WINDOW_FEEL,
+		B_NOT_RESIZABLE | B_NOT_MOVABLE | B_AUTO_UPDATE_SIZE_LIMITS),
+	fPulse(nullptr),
+	fOwner(owner),
+	fCatalog(catalog),
+	fQueriedGeneration(0),
+	fQueryLocker("QuickOpenWindow"),
+	fQueryID(0),
+	fSearchSem(-1),
+	fSearchThread(-1),
+	fQuit(false)
+{
+	fQuery = new BTextControl("QuickOpenTC", nullptr, "", nullptr);
+	fQuery->SetModificationMessage(new BMessage(QOW_QUERY_CHANGED));
+	fResults = new BListView("QuickOpenResults");
+	fResults->SetInvocationMessage(new BMessage(QOW_OPEN));
+	fQuery->TextView()->AddFilter(new ResultsKeyFilter(fResults));
+	BScrollView* scrollView = new BScrollView("QuickOpenScroll", fResults, 0, false, true);
+	font_height height;
+	be_plain_font->GetHeight(&height);
+	scrollView->SetExplicitMinSize(BSize(be_plain_font->StringWidth("M") * 50,
+		(height.ascent + height.descent + height.leading) * 16));
+
+	AddCommonFilter(new KeyDownMessageFilter(QOW_CANCEL, B_ESCAPE));
+
+	AddToSubset(fOwner);
+
+	BGroupLayout* layout = new BGroupLayout(B_VERTICAL, 5);
+	layout->SetInsets(5, 5, 5, 5);
+	SetLayout(layout);
+	layout->View()->SetViewColor(ui_color(B_PANEL_BACKGROUND_COLOR));
+	BLayoutBuilder::Group<>(layout)
+		.Add(fQuery)
+		.Add(scrollView);
+
+	fSearchSem = create_sem(0, "quick open query");
+	fSearchThread = spawn_thread(&QuickOpenWindow::_SearchThread, "quick open search",
+		B_NORMAL_PRIORITY, this);
+	if (fSearchThread >= 0)
+		resume_thread(fSearchThread);
+
+	BMessage pulse(QOW_PULSE);
+	fPulse = new BMessageRunner(BMessenger(this), &pulse, kPulseInterval);
+}
+
+
+/* virtual */
+QuickOpenWindow::~QuickOpenWindow()
+{
+	delete fPulse;
+
+	fQuit = true;
+	delete_sem(fSearchSem);
+	if (fSearchThread >= 0) {
+		status_t exitValue;
+		wait_for_thread(fSearchThread, &exitValue);
+	}
+
+	for (int32 i = fResults->CountItems() - 1; i >= 0; i--)
+		delete fResults->RemoveItem(i);
+}
+
+
+/* virtual */
+void
+QuickOpenWindow::MessageReceived(BMessage* message)
+{
+	switch (message->what) {
+		case QOW_QUERY_CHANGED:
+			_Query();
+			break;
+		case QOW_RESULTS:
+			_ShowResults(message);
+			break;
+		case QOW_PULSE:
+			// the catalog is still being read, or files changed
+			if (!IsHidden() && fCatalog->Generation() != fQueriedGeneration)
+				_Query();
+			break;
+		case QOW_OPEN:
+			_Open();
+			break;
+		case QOW_CANCEL:
+			Hide();
+			break;
+		default:
+			BWindow::MessageReceived(message);
+			break;
+	}
+}
+
+
+void
+QuickOpenWindow::ShowCentered(BRect ownerRect)
+{
+	// recently opened files may have changed
+	PostMessage(QOW_QUERY_CHANGED);
+	CenterIn(ownerRect);
+	Show();
+}
+
+
+/* virtual */
+void
+QuickOpenWindow::WindowActivated(bool active)
+{
+	fQuery->MakeFocus();
+	fQuery->TextView()->SelectAll();
+}
+
+
+void
+QuickOpenWindow::_Query()
+{
+	fQueriedGeneration = fCatalog->Generation();
+
+	BAutolock lock(fQueryLocker);
+	fPendingQuery = fQuery->Text();
+	fQueryID++;
+	release_sem(fSearchSem);
+}
+
+
+// Results of an older query are dropped
+void
+QuickOpenWindow::_ShowResults(BMessage* message)
+{
+	if (message->GetInt32("query_id", -1) != fQueryID)
+		return;
+
+	// the same file stays selected when the results are refreshed
+	BString selectedPath;
+	QuickOpenItem* selected = dynamic_cast<QuickOpenItem*>(
+		fResults->ItemAt(fResults->CurrentSelection()));
+	if (selected != nullptr)
+		selectedPath = selected->Path();
+
+	for (int32 i = fResults->CountItems() - 1; i >= 0; i--)
+		delete fResults->RemoveItem(i);
+
+	int32 selection = 0;
+	BString path;
+	for (int32 i = 0; message->FindString("path", i, &path) == B_OK; i++) {
+		fResults->AddItem(new QuickOpenItem(path, message->GetString("relative_path", i, ""),
+			message->GetString("project", i, "")));
+		if (path == selectedPath)
+			selection = i;
+	}
+	if (!fResults->IsEmpty()) {
+		fResults->Select(selection);
+		fResults->ScrollToSelection();
+	}
+}
+
+
+void
+QuickOpenWindow::_Open()
+{
+	QuickOpenItem* item = dynamic_cast<QuickOpenItem*>(
+		fResults->ItemAt(fResults->CurrentSelection()));
+	if (item == nullptr)
+		return;
+
+	entry_ref ref;
+	if (get_ref_for_path(item->Path(), &ref) == B_OK) {
+		BMessage message(B_REFS_RECEIVED);
+		message.AddRef("refs", &ref);
+		message.AddBool("openWithPreferred", true);
+		fOwner->PostMessage(&message);
+	}
+	Hide();
+}
+
+
+/* static */
+status_t
+QuickOpenWindow::_SearchThread(void* self)
+{
+	static_cast<QuickOpenWindow*>(self)->_SearchLoop();
+	return B_OK;
+}
+
+
+void
+QuickOpenWindow::_SearchLoop()
+{
+	const BMessenger target(this);
+	int32 searchedID = 0;
+	while (!fQuit) {
+		status_t status;
+		do {
+			status = acquire_sem(fSearchSem);
+		} while (status == B_INTERRUPTED);
+		// deleted when quitting
+		if (status != B_OK)
+			break;
+
+		BString query;
+		int32 queryID;
+		{
+			BAutolock lock(fQueryLocker);
+			query = fPendingQuery;
+			queryID = fQueryID;
+		}
+		// several keys were typed while searching: only the last query counts
+		if (queryID == searchedID)
+			continue;
+		searchedID = queryID;
+
+		std::vector<catalog_match> matches;
+		fCatalog->Find(query, kMaxResults, matches);
+		if (queryID != fQueryID)
+			continue;
+
+		BMessage results(QOW_RESULTS);
+		results.AddInt32("query_id", queryID);
+		for (const catalog_match& match : matches) {
+			results.AddString("path", match.path);
+			results.AddString("relative_path", match.relativePath);
+			results.AddString("project", match.project);
+		}
+		while (!fQuit) {
+			if (target.SendMessage(&results, (BHandler*)nullptr, kSendTimeout) != B_TIMED_OUT)
+				break;
+		}
+	}
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2023, Andrea Anzani <andrea.anzani@gmail.com>
+ * All rights reserved. Distributed under the terms of the MIT license.
+ */
+#ifndef QuickOpenWindow_H
+#define QuickOpenWindow_H
+
+
+#include <Locker.h>
+#include <String.h>
+#include <Window.h>
+
+#include <atomic>
+
+
+class BListView;
+class BMessageRunner;
+class BTextControl;
+class FileCatalog;
+
+
+enum {
+	QOW_QUERY_CHANGED		= 'qoqc',
+	QOW_RESULTS				= 'qore',
+	QOW_OPEN				= 'qoop',
+	QOW_CANCEL				= 'qoca',
+	QOW_PULSE				= 'qopu'
+};
+
+
+/*
+ * QuickOpenWindow finds the project files whose path matches what is typed,
+ * in the FileCatalog. Queries run on a thread of the window, so typing is
+ * never held up: a query is dropped when a newer one comes, and the results
+ * are searched again while the catalog is still filling up.
+ */
+class QuickOpenWindow : public BWindow {
+public:
+								QuickOpenWindow(BWindow* owner, FileCatalog* catalog);
+	virtual						~QuickOpenWindow();
+
+	virtual	void				MessageReceived(BMessage* message);
+			void				ShowCentered(BRect ownerRect);
+	virtual	void				WindowActivated(bool active);
+
+private:
+			void				_Query();
+			void				_ShowResults(BMessage* message);
+			void				_Open();
+
+	static	status_t			_SearchThread(void* self);
+			void				_SearchLoop();
+
+			BTextControl*		fQuery;
+			BListView*			fResults;
+			BMessageRunner*		fPulse;
+
+			BWindow*			fOwner;
+			FileCatalog*		fCatalog;
+			uint32				fQueriedGeneration;
+
+			// the query for the search thread
+			BLocker				fQueryLocker;
+			BString				fPendingQuery;
+			std::atomic<int32>	fQueryID;
+			sem_id				fSearchSem;
+			thread_id			fSearchThread;
+			std::atomic<bool>	fQuit;
+};
+
+
+#endif // QuickOpenWindow_H
@@ -94,8 +94,11 @@ SearchResultPanel::SetTabLabel(BString label)
 }
 
 
+// bufferResults holds one MSG_REPORT_RESULT "result" per open editor already
+// searched in memory: those files are left out of the grep output.
 void
-SearchResultPanel::StartSearch(BString command, BString projectPath)
+SearchResultPanel::StartSearch(BString command, BString projectPath,
+	const BMessage* bufferResults)
 {
 	if (fGrepThread)
 		return;
@@ -109,6 +112,15 @@ SearchResultPanel::StartSearch(BString command, BString projectPath)
 	BMessage message;
 	message.AddString("cmd", command);
 
+	if (bufferResults != nullptr) {
+		BMessage result;
+		for (int32 i = 0; bufferResults->FindMessage("result", i, &result) == B_OK; i++) {
+			message.AddString("skip_file", result.GetString("filename", ""));
+			if (result.HasMessage("line"))
+				UpdateSearch(&result);
+		}
+	}
+
 	ActionManager::SetEnabled(MSG_FIND_IN_FILES, false);
 
 	_UpdateTabLabel("\xe2\x8c\x9b");//U+231x
@@ -17,7 +17,8 @@ class SearchResultPanel : public BColumnListView {
 public:
 		SearchResultPanel(BTabView*);
 
-		void StartSearch(BString command, BString projectPath);
+		void StartSearch(BString command, BString projectPath,
+					const BMessage* bufferResults = nullptr);
 
 		virtual void MessageReceived(BMessage* msg);
 		virtual void	AttachedToWindow();